@@ -0,0 +1,262 @@
+/*file: BUSnode.h
+ *----------------------------------------------------------------------------
+ *
+ * One simulated node for host/BUSsim.cpp. Include it inside a namespace, it
+ *  builds a private copy of the event handling and all it calls, src/EVENT.cpp
+ *  with the engine, event cache, scenes, sync, programs, profiler and log.
+ *  It stands in for CBUS2515 in front of them, and is given as a nodeApi_t.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * As host/SYNCnode.h, the headers are taken again in each namespace. HAL.h
+ *  stays global, the HAL picks the node by simNode. No include guard, on
+ *  purpose.
+ *
+ * The CBUS2515 stand-in, as the library does it...
+ *  rx()    a frame off the bus into the setNumBuffers() rxBuf, or dropped.
+ *  pass()  loop(). CBUS.process() takes up to BUS_PROCESS frames, each to
+ *          frameHandler(), and learned events to eventHandler(). Short
+ *          events are looked up with NN 0. Then the other loop() tasks that
+ *          send frames or log, as CANlights.ino.
+*/
+#undef CHAN_H__
+#undef GAMMA_H__
+#undef EASE_H__
+#undef MODE_H__
+#undef EFFECT_H__
+#undef SEQ_H__
+#undef CACHE_H__
+#undef SCENE_H__
+#undef SYNC_H__
+#undef PROF_H__
+#undef LOG_H__
+#undef EVENT_H__
+#undef DEFAULTNV_H__
+#undef CRC_H__
+
+#include "CHAN.cpp"
+#include "CACHE.cpp"
+#include "SCENE.cpp"
+#include "SYNC.cpp"
+#include "PROF.cpp"
+#include "LOG.cpp"
+#include "EVENT.cpp"
+#include "SEQ.cpp"
+#include "DEFAULTNV.h"
+
+
+static uint16_t    nodeNum;
+static busStat_t   stats;
+static busFrame_t  rxBuf[BUS_RXBUFS];  /* CBUS.setNumBuffers( 4 )            */
+static uint8_t     rxHead;
+static uint8_t     rxQty;
+static double      evAt;              /* bus arrival of the event profiled   */
+static double      serialFree;        /* Serial has room from, us            */
+static uint16_t    dropSeen;          /* logDropped at the last pass         */
+
+
+bool calibrate()                      /* no Power here, never starts         */
+{
+  return false;
+}
+
+
+/*------------------------------- boot() --------------------------------------
+ *
+ * as setupEEPROM() and setup(). Factory NVs, the events taught, then the
+ *  chans. EEPROM is the map setupEEPROM() makes, less cal & snapshot.
+*/
+
+static void boot( uint16_t nn, bool master, const ::evIdx_t * ev, uint8_t qty )
+{
+  const cacheMap_t map { 6, 10, 10 + QTY_NV, 5 };
+  uint16_t ee = map.evStart;
+
+  nodeNum = nn;
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    halWriteEE( map.nvStart + nv - 1, defaultNV( nv ) );
+  }
+  for( uint8_t i = 0; i < QTY_EVENT; i++, ee += map.evBytes )
+  {
+    evIdx_t e { 0xFFFF, 0xFFFF, 0xFF };                /* slot free       */
+
+    if( i < qty )
+    {
+      e = { ev[i].nn, ev[i].en, ev[i].ev };
+    }
+
+    halWriteEE( ee + 0, e.nn >> 8 );
+    halWriteEE( ee + 1, e.nn & 0xFF );
+    halWriteEE( ee + 2, e.en >> 8 );
+    halWriteEE( ee + 3, e.en & 0xFF );
+    halWriteEE( ee + 4, e.ev );
+  }
+  cacheBegin( map );
+  sceneBegin( ee );
+  syncBegin( ee + QTY_SCENE * SCENE_BYTES );
+  syncSetMaster( master );
+  seqBegin( ee + QTY_SCENE * SCENE_BYTES + 1 );
+  nightSw = NIGHTSW_DAY;
+  initChannels();
+  setupChannels();
+
+  uint8_t data[8];                     /* canStart(), PowerOn event           */
+  stats.tx += busSend( evPack( data, OPC_ACON_, nodeNum, BUS_ENPOWERON ), data );
+}
+
+
+static void tick()                     /* the 1 ms ISR, as foreground()      */
+{
+  for( uint8_t n = syncTicks(); n != 0; n-- )
+  {
+    processChannels();
+  }
+}
+
+
+static bool rx( const busFrame_t & f ) /* MCP2515 INT, ACAN2515 buffers it   */
+{
+  stats.seen++;
+  if( rxQty == BUS_RXBUFS )
+  {
+    stats.dropped++;
+    return false;
+  }
+  rxBuf[( rxHead + rxQty ) % BUS_RXBUFS] = f;
+  rxQty++;
+  stats.maxDepth = ( rxQty > stats.maxDepth ? rxQty : stats.maxDepth );
+  return true;
+}
+
+
+/*------------------------------- process() -----------------------------------
+ *
+ * CBUS.process(), then cacheSync() as taskCBUS(). Returns frames handled
+*/
+
+static uint8_t process()
+{
+  uint8_t n { 0 };
+
+  for( ; n < BUS_PROCESS && rxQty != 0; n++ )
+  {
+    const busFrame_t & f = rxBuf[rxHead];
+    uint8_t opc = f.data[0];
+
+    rxHead = ( rxHead + 1 ) % BUS_RXBUFS;
+    rxQty--;
+    stats.handled++;
+    stats.waitSum += simUs - f.at;
+    stats.waitMax = ( simUs - f.at > stats.waitMax ? simUs - f.at : stats.waitMax );
+
+    evFrame( f.data, f.len, nodeNum );           /* frameHandler()       */
+    if( ( opc & 0x96 ) == 0x90 && f.len >= EV_LEN )  /* ACONn ... ASOFn  */
+    {
+      uint16_t nn = ( opc & 0x08 ? 0 : ( f.data[1] << 8 ) | f.data[2] );
+      uint16_t en = ( f.data[3] << 8 ) | f.data[4];
+      evIdx_t  e;
+
+      for( uint8_t i = 0; i < QTY_EVENT; i++ )
+      {
+        if( cacheEvent( i, e ) == true && e.nn == nn && e.en == en )
+        {
+          if( profEvPending == false )
+          {
+            evAt = f.at;              /* as profEventMark(), oldest is timed */
+          }
+          stats.events++;
+          evEvent( i, f.data, f.len );           /* eventHandler()       */
+          break;
+        }
+      }
+    }
+  }
+  cacheSync();
+  return n;
+}
+
+
+/*------------------------------- pass() --------------------------------------
+ *
+ * a loop() pass. Tasks in setupTasks() order, each as often as it is due
+ *  here is close enough, 1 ms & up tasks run each pass. Returns frames
+ *  handled.
+*/
+
+static uint8_t pass()
+{
+  uint8_t n = process();               /* taskCBUS()                         */
+
+  if( swChange == true )               /* taskPhase()                        */
+  {
+    swChange = false;
+    syncPhase();
+  }
+
+  bool     start;                      /* taskSync()                         */
+  uint16_t tk;
+  uint8_t  data[8];
+
+  syncRun();
+  if( syncTx( start, tk ) == true )
+  {
+    uint8_t len = evPack( data, ( start ? OPC_ACOF2_ : OPC_ACON2_ ), nodeNum,
+                          BUS_ENSYNC ) + 2;
+    data[5] = tk >> 8;
+    data[6] = tk & 0xFF;
+    stats.tx += busSend( len, data );
+  }
+
+  uint8_t len = evDiag( data, nodeNum ); /* sendDiag()                      */
+  if( len != 0 && busSend( len, data ) == true )
+  {
+    stats.tx++;
+    dgnCode++;
+    dgnLeft--;
+  }
+
+  logRec_t rec;                        /* drainLog(), if Serial has room     */
+  if( simUs >= serialFree && logPop( rec ) == true )
+  {
+    char line[LOG_LINE];
+
+    serialFree = simUs + ( logFormat( rec, line, LOG_LINE ) + 2 ) * BUS_SERIALUS;
+    stats.lines++;
+  }
+  stats.logDrop += (uint16_t) ( logDropped - dropSeen );  /* it wraps      */
+  dropSeen = logDropped;
+  return n;
+}
+
+
+static void pwm()                      /* halWritePWM(), as HAL.cpp          */
+{
+  if( profEvPending == true )
+  {
+    profEventDone();
+    stats.latSum += simUs - evAt;
+    stats.latMax = ( simUs - evAt > stats.latMax ? simUs - evAt : stats.latMax );
+    stats.latN++;
+  }
+}
+
+
+static void setDebug( bool on )        /* Serial Monitor '/'                 */
+{
+  debug = on;
+}
+
+
+static const busStat_t & stat()
+{
+  return stats;
+}
+
+
+const nodeApi_t api { boot, tick, rx, pass, pwm, cacheNV, setDebug, stat };
+
+
+/*-------------------------------BUSnode.h EoF ------------------------------*/
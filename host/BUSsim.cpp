@@ -0,0 +1,582 @@
+/*file: BUSsim.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) virtual CBUS. Several CANlights nodes on one bus, src/EVENT.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Each node has its own copy of the event handling, engine, event cache,
+ *  scenes, sync and log, see BUSnode.h, behind a CBUS2515 stand-in with 4
+ *  rx buffers, as setNumBuffers( 4 ). Node 1 is the sync master. Each node
+ *  has its own boot time and loop() timing, and sends its own frames, PowerOn,
+ *  sync and DGN replies, as the sketch does.
+ *
+ * The bus is 125 kbit/s, a frame is on it 47 + 8 x len bits, plus 10 %
+ *  stuffing. One frame at a time, first come first sent. A frame reaches
+ *  all other nodes as it ends. A node that cannot take it into its rx
+ *  buffers drops it, as an MCP2515 overrun.
+ *
+ * The layout (source 0) sends, unless -r...
+ *  - NightSw ACON / ACOF NN 100 EN 1 each -p minutes.
+ *  - TestCh1 ACON NN 100 EN 2 each 10 s, TestEnd EN 3 5 s after.
+ *  - RDGN NN 0 code 0 each 30 s, each node answers with 9 DGNs.
+ *  - -s n, an event storm, n frames back to back each second, events the
+ *    nodes have not learned, as a start of day.
+ * A fault, -f, holds node 2's loop() each 10 s as a storm starts, as the
+ *  EEPROM writes of a snapshot or a calibration would.
+ *
+ * Trace file, -w writes all bus frames, -r replays one...
+ *   "CBT1", then per frame: us since the last frame (LEB128, 7 bits a byte,
+ *   low first), source << 4 | len, data[len]. An event frame is 8 bytes.
+ *  Replay sends the layout's frames, and those of nodes not simulated, at
+ *  -x times the speed. The simulated nodes send their own again. So a
+ *  capture plays back faster than real time, as fast as the bus takes it.
+ *
+ * loop() cost model, us. Pass, as SYNCsim.cpp, plus each frame handled.
+ *  Event to PWM is from the bus, the frame ends, to the next PWM write, as
+ *  PROF_EVENT. Exit 1 if a node drops a frame.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/BUSsim.cpp -o BUSsim
+ *   ./BUSsim -h 1 -n 4
+ *
+ *  -h n   simulated hours, or to the trace end         (default 1)
+ *  -n n   nodes, 1 - 8                                 (default 4)
+ *  -p n   minutes between NightSw changes              (default 1)
+ *  -s n   storm frames each second                     (default 0)
+ *  -d 1   debug on, all nodes log every frame rx       (default 0)
+ *  -f n   node 2 loop() held n ms each 10 s            (default 0)
+ *  -w f   write the bus trace to file f
+ *  -r f   replay trace file f, not the layout above
+ *  -x n   replay speed                                 (default 1)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "CACHE.h"                     /* evIdx_t. Each node takes its own too */
+#define HOST_PWM                      /* each node its own, see host HAL     */
+#define HOST_NV
+#define HOST_EE
+#define HOST_CLOCK
+#include "HALhost.h"
+
+
+const uint8_t  BUS_RXBUFS   { 4 };     /* CBUS.setNumBuffers( 4 )            */
+const uint8_t  BUS_TXBUFS   { 2 };     /* tx frames a node has waiting       */
+const uint8_t  BUS_PROCESS  { 3 };     /* frames each CBUS.process()         */
+const double   BUS_BITUS    { 8.0 };   /* 125 kbit/s                         */
+const double   BUS_SERIALUS { 86.8 };  /* a char at 115200 baud              */
+const uint16_t BUS_ENPOWERON { 1 };    /* as EN_t in CANlights.h             */
+const uint16_t BUS_ENSYNC   { 4 };
+
+const uint8_t  QTY_NODE     { 8 };
+const uint16_t EE_SIZE      { 4096 };  /* MEGA EEPROM                        */
+
+const double   LOOP_MIN     { 300.0 }; /* loop() pass, us, as SYNCsim.cpp    */
+const double   LOOP_MAX     { 1500.0 };
+const double   COST_FRAME   { 150.0 }; /* per frame handled, SPI & handlers  */
+const double   COST_DEBUG   { 20.0 };  /*  plus logPutN() with debug on      */
+
+
+struct busFrame_t
+{
+  double   at;                        /* us it ends on the bus, or is queued */
+  uint8_t  src;                       /* 0 layout, node 1 - 15               */
+  uint8_t  len;
+  uint8_t  data[8];
+};
+
+struct busStat_t                      /* a node, kept by BUSnode.h           */
+{
+  uint32_t seen;                      /* frames off the bus                  */
+  uint32_t handled;                   /* frames through CBUS.process()       */
+  uint32_t dropped;                   /* rx buffers full                     */
+  uint32_t events;                    /* learned, to eventHandler()          */
+  uint32_t tx;
+  uint32_t lines;                     /* log lines to Serial                 */
+  uint32_t logDrop;                   /* log records dropped, ring full      */
+  uint8_t  maxDepth;                  /* rx buffers used, most               */
+  double   waitSum, waitMax;          /* bus to CBUS.process(), us           */
+  double   latSum, latMax;            /* bus to PWM write, us                */
+  uint32_t latN;
+};
+
+struct nodeApi_t                      /* a node, see BUSnode.h               */
+{
+  void    ( * boot )( uint16_t nn, bool master, const evIdx_t * ev, uint8_t qty );
+  void    ( * tick )();
+  bool    ( * rx )( const busFrame_t & f );
+  uint8_t ( * pass )();
+  void    ( * pwm )();
+  uint8_t ( * nv )( uint8_t nv );
+  void    ( * setDebug )( bool on );
+  const busStat_t & ( * stat )();
+};
+
+static double simUs;                  /* now                                 */
+
+static bool busSend( uint8_t len, const uint8_t * data ); /* CBUS.sendMessage() */
+
+namespace n1 {
+#include "BUSnode.h"
+}
+namespace n2 {
+#include "BUSnode.h"
+}
+namespace n3 {
+#include "BUSnode.h"
+}
+namespace n4 {
+#include "BUSnode.h"
+}
+namespace n5 {
+#include "BUSnode.h"
+}
+namespace n6 {
+#include "BUSnode.h"
+}
+namespace n7 {
+#include "BUSnode.h"
+}
+namespace n8 {
+#include "BUSnode.h"
+}
+
+
+struct node_t
+{
+  const nodeApi_t * api;
+  double   bootUs;
+  double   nextTick;
+  double   nextLoop;
+  uint8_t  txWait;                    /* frames queued for the bus           */
+  uint32_t txFull;                    /* CBUS.sendMessage() false            */
+  uint8_t  ee[EE_SIZE];
+};
+
+static node_t  node[QTY_NODE];
+static uint8_t qtyNode { 4 };
+static uint8_t simNode;               /* node the HAL is for                 */
+
+static std::deque<busFrame_t> busQ;   /* waiting for the bus                 */
+static double  busEnd { -1.0 };       /* us the frame on the bus ends, or -1 */
+static FILE *  trace;                 /* -w                                  */
+static double  traceAt;               /* us of the last frame written        */
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+void    halWritePWM( uint8_t, uint16_t ) { node[simNode].api->pwm(); }
+uint8_t halReadNV( uint8_t nv )        { return node[simNode].api->nv( nv ); }
+uint8_t halReadEE( uint16_t adr )      { return node[simNode].ee[adr % EE_SIZE]; }
+void    halWriteEE( uint16_t adr, uint8_t val ) { node[simNode].ee[adr % EE_SIZE] = val; }
+uint32_t halMillis()   { return ( simUs - node[simNode].bootUs ) / 1000.0; }
+uint32_t halMicros()   { return simUs - node[simNode].bootUs; }
+
+
+static uint32_t lcg { 2021 };
+
+static double rnd( double lo, double hi )
+{
+  lcg = lcg * 1103515245UL + 12345;
+  return lo + ( hi - lo ) * ( ( lcg >> 8 ) & 0xFFFF ) / 65536.0;
+}
+
+
+static double frameUs( uint8_t len )  /* on the bus                          */
+{
+  return ( 47 + 8 * len ) * 1.1 * BUS_BITUS;
+}
+
+
+/*------------------------------- busSend() -----------------------------------
+ *
+ * CBUS.sendMessage() of node simNode. False if its tx buffers are full
+*/
+
+static bool busSend( uint8_t len, const uint8_t * data )
+{
+  node_t & d = node[simNode];
+
+  if( d.txWait == BUS_TXBUFS )
+  {
+    d.txFull++;
+    return false;
+  }
+  busFrame_t f { simUs, (uint8_t) ( simNode + 1 ), len, { } };
+
+  memcpy( f.data, data, len );
+  busQ.push_back( f );
+  d.txWait++;
+  return true;
+}
+
+
+/*------------------------------- traceWrite() --------------------------------
+*/
+
+static void traceWrite( const busFrame_t & f )
+{
+  uint32_t dt = f.at - traceAt;
+
+  traceAt += dt;
+  do
+  {
+    fputc( ( dt & 0x7F ) | ( dt > 0x7F ? 0x80 : 0 ), trace );
+    dt >>= 7;
+  }
+  while( dt != 0 );
+  fputc( ( f.src << 4 ) | f.len, trace );
+  fwrite( f.data, 1, f.len, trace );
+}
+
+
+/*------------------------------- traceRead() ---------------------------------
+ *
+ * frames for the bus from a trace, at x times the speed. Nodes simulated
+ *  make their own. Returns false if the file is not a trace.
+*/
+
+static bool traceRead( const char * name, double x, std::vector<busFrame_t> & v )
+{
+  FILE * fp = fopen( name, "rb" );
+  char   magic[4];
+
+  if( fp == NULL || fread( magic, 1, 4, fp ) != 4 || memcmp( magic, "CBT1", 4 ) )
+  {
+    return false;
+  }
+  double at { 0.0 };
+  int    c;
+
+  while( ( c = fgetc( fp ) ) != EOF )
+  {
+    uint32_t dt { 0 };
+
+    for( uint8_t shift = 0; ; shift += 7, c = fgetc( fp ) )
+    {
+      dt |= (uint32_t) ( c & 0x7F ) << shift;
+      if( ( c & 0x80 ) == 0 )
+      {
+        break;
+      }
+    }
+    busFrame_t f { };
+
+    at += dt;
+    c = fgetc( fp );
+    f.at = at / x;
+    f.src = c >> 4;
+    f.len = ( c & 0x0F ) > 8 ? 8 : c & 0x0F;
+    if( fread( f.data, 1, f.len, fp ) != f.len )
+    {
+      break;
+    }
+    if( f.src == 0 || f.src > qtyNode )
+    {
+      f.src = 0;
+      v.push_back( f );
+    }
+  }
+  fclose( fp );
+  return true;
+}
+
+
+/*------------------------------- layout() ------------------------------------
+ *
+ * the layout's frames for the run, in time order
+*/
+
+static void layout( double endUs, double perMin, uint16_t storm,
+                    std::vector<busFrame_t> & v )
+{
+  double nextNight = perMin * 60e6;
+  bool   on { false };
+
+  for( double t = 1e6; t < endUs; t += 1e6 )
+  {
+    uint32_t s = t / 1e6;
+
+    if( t >= nextNight )
+    {
+      on = ! on;
+      v.push_back( { t, 0, 5, { uint8_t( on ? 0x90 : 0x91 ), 0, 100, 0, 1 } } );
+      nextNight += perMin * 60e6;
+    }
+    if( s % 10 == 3 )
+    {
+      v.push_back( { t, 0, 5, { 0x90, 0, 100, 0, 2 } } );
+    }
+    if( s % 10 == 8 )
+    {
+      v.push_back( { t, 0, 5, { 0x90, 0, 100, 0, 3 } } );
+    }
+    if( s % 30 == 15 )
+    {
+      v.push_back( { t, 0, 5, { 0x87, 0, 0, 0, 0 } } );
+    }
+    for( uint16_t i = 0; i < storm; i++ )
+    {
+      v.push_back( { t + 500e3, 0, 5, { 0x90, 0, 200, uint8_t( i >> 8 ),
+                                        uint8_t( i ) } } );
+    }
+  }
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  const nodeApi_t * const API[QTY_NODE]
+    { &n1::api, &n2::api, &n3::api, &n4::api,
+      &n5::api, &n6::api, &n7::api, &n8::api };
+  double hours { 1.0 }, perMin { 1.0 }, stallMs { 0.0 }, speed { 1.0 };
+  uint16_t storm { 0 };
+  bool   dbg { false };
+  const char * wName { NULL };
+  const char * rName { NULL };
+
+  for( int i = 1; i + 1 < argc; i += 2 )
+  {
+    double v = atof( argv[i + 1] );
+
+    switch( argv[i][1] )
+    {
+      case 'h' : hours = v;                break;
+      case 'n' : qtyNode = v;              break;
+      case 'p' : perMin = v;               break;
+      case 's' : storm = v;                break;
+      case 'd' : dbg = ( v != 0.0 );       break;
+      case 'f' : stallMs = v;              break;
+      case 'x' : speed = ( v > 0 ? v : 1 ); break;
+      case 'w' : wName = argv[i + 1];      break;
+      case 'r' : rName = argv[i + 1];      break;
+    }
+  }
+  qtyNode = ( qtyNode < 1 ? 1 : qtyNode > QTY_NODE ? QTY_NODE : qtyNode );
+
+  double endUs = hours * 3600e6;
+  std::vector<busFrame_t> lay;
+
+  if( rName != NULL )
+  {
+    if( traceRead( rName, speed, lay ) == false )
+    {
+      printf( " %s is not a trace\n", rName );
+      return 1;
+    }
+    if( lay.size() != 0 && lay.back().at + 1e6 < endUs )
+    {
+      endUs = lay.back().at + 1e6;    /* to the trace end                    */
+    }
+  }
+  else
+  {
+    layout( endUs, perMin, storm, lay );
+  }
+  if( wName != NULL && ( trace = fopen( wName, "wb" ) ) != NULL )
+  {
+    fwrite( "CBT1", 1, 4, trace );
+  }
+
+  const uint16_t NN1 { 257 };          /* node n is NN 256 + n               */
+  const evIdx_t  EV[] {
+    { 100, 1, 0 },                     /* NightSw                            */
+    { 100, 2, 1 },                     /* TestCh1                            */
+    { 100, 3, 11 },                    /* TestEnd                            */
+    { NN1, BUS_ENSYNC, 22 } };         /* node 1's sync frames               */
+
+  for( uint8_t n = 0; n < qtyNode; n++ )
+  {
+    node_t & d = node[n];
+
+    d.api = API[n];
+    d.bootUs = n * 75e3;
+    d.nextTick = d.bootUs + 1000.0;
+    d.nextLoop = d.bootUs + 1.0;
+    memset( d.ee, 0xFF, EE_SIZE );
+  }
+
+  size_t   li { 0 };                   /* next layout frame                   */
+  uint8_t  booted { 0 };
+  uint64_t busFrames { 0 }, busBytes { 0 };
+  uint32_t perSec { 0 }, peakSec { 0 }, sec { 0 };
+  double   busyUs { 0.0 };
+  double   nextStall { 10.5e6 };       /* -f, with a storm burst             */
+  auto     t0 = std::chrono::steady_clock::now();
+
+  for( ;; )
+  {
+    double now = ( li < lay.size() ? lay[li].at : endUs + 1.0 );
+    int8_t who { -1 };                 /* -1 layout, -2 bus, else a node     */
+    bool   isTick { false };
+
+    if( busEnd >= 0.0 && busEnd < now )
+    {
+      now = busEnd;
+      who = -2;
+    }
+    for( uint8_t n = 0; n < qtyNode; n++ )
+    {
+      double boot = node[n].bootUs;
+
+      if( n == booted && boot < now )
+      {
+        now = boot;
+        who = n;
+      }
+      if( n < booted && node[n].nextTick < now )
+      {
+        now = node[n].nextTick;
+        who = n;
+        isTick = true;
+      }
+      if( n < booted && node[n].nextLoop < now )
+      {
+        now = node[n].nextLoop;
+        who = n;
+        isTick = false;
+      }
+    }
+    if( now > endUs )
+    {
+      break;
+    }
+    simUs = now;
+
+    if( who == -1 )                    /* the layout sends                   */
+    {
+      busQ.push_back( lay[li++] );
+      busQ.back().at = now;
+    }
+    else if( who == -2 )               /* a frame ends, to all others        */
+    {
+      busFrame_t f = busQ.front();
+
+      busQ.pop_front();
+      busEnd = -1.0;
+      f.at = now;
+      if( f.src != 0 )
+      {
+        node[f.src - 1].txWait--;
+      }
+      for( uint8_t n = 0; n < booted; n++ )
+      {
+        if( n + 1 != f.src )
+        {
+          simNode = n;
+          node[n].api->rx( f );
+        }
+      }
+      if( trace != NULL )
+      {
+        traceWrite( f );
+      }
+      busFrames++;
+      busBytes += f.len;
+      if( (uint32_t) ( now / 1e6 ) != sec )
+      {
+        sec = now / 1e6;
+        perSec = 0;
+      }
+      perSec++;
+      peakSec = ( perSec > peakSec ? perSec : peakSec );
+    }
+    else if( who == booted )           /* power on                           */
+    {
+      simNode = who;
+      node[who].api->boot( NN1 + who, who == 0, EV, 4 );
+      node[who].api->setDebug( dbg );
+      booted++;
+    }
+    else
+    {
+      node_t & d = node[who];
+
+      simNode = who;
+      if( isTick == true )
+      {
+        d.api->tick();
+        d.nextTick += 1000.0;
+      }
+      else
+      {
+        uint8_t n = d.api->pass();
+        double  stall { 0.0 };
+
+        if( who == 1 && now >= nextStall )   /* node 2 held up           */
+        {
+          stall = stallMs * 1000.0;
+          nextStall += 10e6;
+        }
+        d.nextLoop = now + rnd( LOOP_MIN, LOOP_MAX ) + stall
+                   + n * ( COST_FRAME + ( dbg ? COST_DEBUG : 0.0 ) );
+      }
+    }
+    if( busEnd < 0.0 && busQ.empty() == false )  /* next frame on the bus  */
+    {
+      busEnd = simUs + frameUs( busQ.front().len );
+      busyUs += busEnd - simUs;
+    }
+  }
+  double wall = std::chrono::duration< double >(
+                  std::chrono::steady_clock::now() - t0 ).count();
+  double secs = endUs / 1e6;
+  uint64_t handled { 0 };
+  bool   ok { true };
+
+  if( trace != NULL )
+  {
+    fclose( trace );
+  }
+  printf( " %.2f h, %u nodes, %s, debug %s\n", secs / 3600.0, qtyNode,
+          ( rName ? rName : "layout" ), ( dbg ? "on" : "off" ) );
+  printf( " bus     %llu frames, %.1f /s, peak %u /s, load %.1f %%\n",
+          (unsigned long long) busFrames, busFrames / secs, peakSec,
+          100.0 * busyUs / endUs );
+  printf( " node  handled /s  rx bufs  dropped  tx full  wait ms mean   max"
+          "  ev>PWM ms mean   max  log lines  dropped\n" );
+  for( uint8_t n = 0; n < qtyNode; n++ )
+  {
+    simNode = n;
+    const busStat_t & s = node[n].api->stat();
+
+    printf( "  %u    %10.1f  %3u of %u  %7u  %7u  %12.2f %6.2f  %14.2f %6.2f"
+            "  %9u  %7u\n", n + 1, s.handled / secs, s.maxDepth, BUS_RXBUFS,
+            s.dropped, node[n].txFull,
+            ( s.handled ? s.waitSum / s.handled / 1000.0 : 0.0 ),
+            s.waitMax / 1000.0, ( s.latN ? s.latSum / s.latN / 1000.0 : 0.0 ),
+            s.latMax / 1000.0, s.lines, s.logDrop );
+    handled += s.handled;
+    ok &= ( s.dropped == 0 );
+  }
+  printf( " host    %.3f s, %.0fx real time, %.0f frames handled /s\n",
+          wall, secs / wall, handled / wall );
+  if( wName != NULL )
+  {
+    std::vector<busFrame_t> back;
+    uint8_t keep = qtyNode;
+
+    qtyNode = 0;                      /* read back every frame               */
+    bool same = traceRead( wName, 1.0, back ) && back.size() == busFrames;
+    qtyNode = keep;
+    printf( " trace   %s, %zu frames, %s\n", wName, back.size(),
+            ( same ? "read back ok" : "read back FAIL" ) );
+    ok &= same;
+  }
+  printf( " BUSsim %s\n", ( ok ? "PASS" : "FAIL, frames dropped" ) );
+  return ( ok ? 0 : 1 );
+}
+
+/*-------------------------------BUSsim.cpp EoF ------------------------------*/
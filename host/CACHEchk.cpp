@@ -0,0 +1,322 @@
+/*file: CACHEchk.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) check of the NV & event RAM cache, src/CACHE.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * A byte array stands in for the EEPROM. The reference lookups read it the
+ *  way CBUSConfig readNV() and getEventEVval() do. After each random change
+ *  every cache answer must match them. The changes are made the ways the
+ *  module sees them... cacheSetNV(), an FCU NVSET frame, an FCU teach frame.
+ * Then the NV blob. A reboot must find the crc good, a batch write must only
+ *  write changed bytes, a bad byte must give DEFAULTNV, the 60 NVs & events
+ *  of an image from before the blob must be kept less a bad chan, and NVs &
+ *  events of more chans and of less must be moved to this layout. A move
+ *  cut before its header is written must keep the moved NVs, and one cut
+ *  in the events must not run again.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/CACHEchk.cpp src/CACHE.cpp -o CACHEchk
+ *   ./CACHEchk [rounds]        exit 1 if any answer differs
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CACHE.h"
+#include "CRC.h"
+#include "DEFAULTNV.h"
+#define HOST_EE                       /* counts reads, power lost mid write */
+#include "HALhost.h"
+
+
+const uint16_t HDR_START { 6 };                 /* as setupEEPROM()          */
+const uint16_t NVS_START { 10 };
+const uint16_t EVS_START { NVS_START + QTY_NV };
+const uint8_t  EV_BYTES  { 5 };
+const uint16_t MYNODE    { 257 };
+
+static uint8_t  ee[4096];                       /* the EEPROM                */
+static uint32_t eeReads;
+static uint32_t eeWrites;
+static uint32_t eeLimit { 0xFFFFFFFF };         /* writes before power lost */
+
+
+uint8_t halReadEE( uint16_t adr )
+{
+  eeReads++;
+  return ee[adr];
+}
+
+void halWriteEE( uint16_t adr, uint8_t val )
+{
+  if( eeWrites++ < eeLimit )
+  {
+    ee[adr] = val;
+  }
+}
+
+
+/*------------------------ EEPROM backed lookups -----------------------------*/
+
+static uint8_t refNV( uint8_t nv )
+{
+  return ee[NVS_START + nv - 1];
+}
+
+static uint8_t refEV( uint8_t idx )
+{
+  return ee[EVS_START + idx * EV_BYTES + 4];
+}
+
+static bool refUsed( uint8_t idx )
+{
+  const uint8_t * e = &ee[EVS_START + idx * EV_BYTES];
+  return ! ( e[0] == 0xFF && e[1] == 0xFF && e[2] == 0xFF && e[3] == 0xFF );
+}
+
+
+static uint32_t compare()          /* qty of cache answers that differ       */
+{
+  uint32_t bad { 0 };
+
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    bad += ( cacheNV( nv ) != refNV( nv ) );
+  }
+  for( uint8_t idx = 0; idx < QTY_EVENT; idx++ )
+  {
+    evIdx_t ev;
+    bool used = cacheEvent( idx, ev );
+    const uint8_t * e = &ee[EVS_START + idx * EV_BYTES];
+
+    bad += ( used != refUsed( idx ) );
+    bad += ( cacheEV( idx ) != refEV( idx ) );
+    bad += ( ev.nn != ( ( e[0] << 8 ) | e[1] ) || ev.en != ( ( e[2] << 8 ) | e[3] ) );
+  }
+  return bad;
+}
+
+
+/*------------------------------- blobCheck() ---------------------------------
+ *
+ * the NV blob, after the random rounds. Returns the checks failed
+*/
+
+static uint32_t blobCheck()
+{
+  const cacheMap_t MAP { HDR_START, NVS_START, EVS_START, EV_BYTES };
+  uint32_t bad { 0 };
+  uint8_t  nvs[QTY_NV];
+  ADRNV    NV;
+
+  bad += ( cacheBegin( MAP ) != NVBLOB_OK ) + compare();       /* reboot     */
+
+  for( uint8_t i = 0; i < QTY_NV; i++ )
+  {
+    nvs[i] = cacheNV( i + 1 );
+  }
+  eeWrites = 0;
+  bad += ( cacheSetNVs( nvs ) != 0 || eeWrites != 0 );         /* no change  */
+  nvs[0]++;
+  nvs[QTY_NV / 2]++;
+  nvs[QTY_NV - 1]++;
+  bad += ( cacheSetNVs( nvs ) != 3 || eeWrites > 4 );          /* 3 & crc    */
+  bad += ( cacheBegin( MAP ) != NVBLOB_OK ) + compare();
+  printf( " blob batch of 3 changed NVs, %u EEPROM writes\n", eeWrites );
+
+  ee[NVS_START + 5] ^= 0x01;                                   /* bit error  */
+  bad += ( cacheBegin( MAP ) != NVBLOB_DEFAULT ) + compare();
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    bad += ( cacheNV( nv ) != defaultNV( nv ) );
+  }
+
+  {                                         /* image from before the blob    */
+    const uint8_t  BASE_NV { NVBASE_CHANS * NVBASE_ROWS };
+    const uint16_t evBase = NVS_START + BASE_NV;
+    uint8_t evs[QTY_EVENT * EV_BYTES];
+    uint32_t was = bad;
+
+    for( uint8_t i = 0; i < BASE_NV; i++ )  /* row p, chan ch. Modes 0 - 6   */
+    {
+      uint8_t p = i / NVBASE_CHANS, ch = i % NVBASE_CHANS;
+
+      ee[NVS_START + i] = ( p == NVBASE_ROWS - 1 ? ch % 7 : p * 32 + ch );
+    }
+    ee[NVS_START + 5 * NVBASE_CHANS + 1] = 0x0F;  /* bad mode, chan 2 reset */
+    for( uint8_t b = 0; b < QTY_EVENT * EV_BYTES; b++ )
+    {
+      evs[b] = ee[evBase + b] = ( b % EV_BYTES < 4 && b / EV_BYTES % 4 == 0
+                                  ? 0xFF : rand() );
+    }
+    ee[HDR_START] = ee[HDR_START + 1] = ee[HDR_START + 2] = 0xFF;
+    bad += ( cacheBegin( MAP ) != NVBLOB_MIGRATED ) + compare();
+    for( uint8_t p = 0; p < NV_PER_CHAN; p++ )
+    {
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        uint8_t nv = 1 + p * QTY_CHAN + ch;
+        bool    kept = ( p < NVBASE_ROWS && ch < NVBASE_CHANS && ch != 1 );
+        uint8_t want = ( p == NVBASE_ROWS - 1 ? ch % 7 : p * 32 + ch );
+
+        bad += ( cacheNV( nv ) != ( kept ? want : defaultNV( nv ) ) );
+      }
+    }
+    for( uint8_t b = 0; b < QTY_EVENT * EV_BYTES; b++ )
+    {
+      bad += ( ee[EVS_START + b] != evs[b] );
+    }
+    bad += ( cacheBegin( MAP ) != NVBLOB_OK );
+    printf( " blob from before, %u NVs & events, %s\n", BASE_NV,
+            ( bad == was ? "ok" : "differs" ) );
+  }
+
+  const uint8_t OLD[2] { ( QTY_CHAN < 24 ? QTY_CHAN + 2 : 16 ), QTY_CHAN - 2 };
+  for( uint8_t o = 0; o < 2; o++ )          /* layouts of other CHANS        */
+  {
+    uint8_t  chans = OLD[o];
+    uint16_t evOld = NVS_START + chans * NV_PER_CHAN;
+    uint8_t  head[2] { NVBLOB_VER, chans };
+    uint8_t  crc = crc8( head, 2 );
+    uint8_t  evs[QTY_EVENT * EV_BYTES];
+
+    for( uint8_t i = 0; i < chans * NV_PER_CHAN; i++ )
+    {
+      ee[NVS_START + i] = i / chans * 32 + i % chans; /* row p, chan ch    */
+      crc = crc8( &ee[NVS_START + i], 1, crc );
+    }
+    for( uint8_t b = 0; b < QTY_EVENT * EV_BYTES; b++ )
+    {
+      evs[b] = ee[evOld + b] = ( b % EV_BYTES < 4 && b / EV_BYTES % 4 == 0
+                                 ? 0xFF : rand() );
+    }
+    ee[HDR_START] = NVBLOB_VER;
+    ee[HDR_START + 1] = chans;
+    ee[HDR_START + 2] = crc;
+    if( o == 0 )                            /* power lost before chans & ver */
+    {
+      static uint8_t was[sizeof( ee )], moved[sizeof( ee )];
+
+      memcpy( was, ee, sizeof( ee ) );
+      eeWrites = 0;
+      cacheBegin( MAP );
+      memcpy( moved, ee, sizeof( ee ) );
+      memcpy( ee, was, sizeof( ee ) );
+      eeLimit = eeWrites - 2;
+      eeWrites = 0;
+      cacheBegin( MAP );
+      eeLimit = 0xFFFFFFFF;
+      bool kept = ( memcmp( &ee[NVS_START], &moved[NVS_START], QTY_NV ) == 0 );
+      NVBLOB_t redo = cacheBegin( MAP );
+      bad += ! kept + ( redo != NVBLOB_MIGRATED ) + compare();
+      printf( " blob move cut before its header, NVs %s, boot %s\n",
+              ( kept ? "kept" : "lost" ),
+              ( redo == NVBLOB_MIGRATED ? "keeps them" : "DEFAULTNV" ) );
+      memcpy( ee, was, sizeof( ee ) );
+      eeLimit = 1 + QTY_EVENT * EV_BYTES / 2; /* power lost mid event move */
+      eeWrites = 0;
+      cacheBegin( MAP );
+      eeLimit = 0xFFFFFFFF;
+      bool cut = ( ee[HDR_START] == NVBLOB_CUT );
+      bad += ! cut;
+      printf( " blob move cut in the events, header %s\n",
+              ( cut ? "NVBLOB_CUT, not moved again" : "valid, moves again" ) );
+      memcpy( ee, was, sizeof( ee ) );
+    }
+    bad += ( cacheBegin( MAP ) != NVBLOB_MIGRATED ) + compare();
+    for( uint8_t p = 0; p < NV_PER_CHAN; p++ )
+    {
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        uint8_t nv = 1 + p * QTY_CHAN + ch;
+        bad += ( cacheNV( nv ) != ( ch < chans ? p * 32 + ch : defaultNV( nv ) ) );
+      }
+    }
+    for( uint8_t b = 0; b < QTY_EVENT * EV_BYTES; b++ )
+    {
+      bad += ( ee[EVS_START + b] != evs[b] );
+    }
+    bad += ( cacheBegin( MAP ) != NVBLOB_OK );
+    printf( " blob moved from %u chans to %u, %s\n", chans, QTY_CHAN,
+            ( bad == 0 ? "ok" : "differs" ) );
+  }
+  return bad;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  uint32_t rounds = ( argc > 1 ? atoi( argv[1] ) : 10000 );
+  uint32_t bad { 0 };
+
+  srand( 2021 );
+  for( uint16_t a = 0; a < sizeof( ee ); a++ )
+  {
+    ee[a] = rand();
+  }
+  ee[HDR_START] = 0xFF;                         /* from before the blob  */
+  for( uint8_t idx = 0; idx < QTY_EVENT; idx += 3 )  /* some free slots       */
+  {
+    for( uint8_t b = 0; b < EV_BYTES; b++ )
+    {
+      ee[NVS_START + NVBASE_CHANS * NVBASE_ROWS + idx * EV_BYTES + b] = 0xFF;
+    }
+  }
+  cacheBegin( { HDR_START, NVS_START, EVS_START, EV_BYTES } );
+  bad += compare();
+  uint32_t loadReads = eeReads;
+
+  for( uint32_t r = 0; r < rounds; r++ )
+  {
+    uint8_t nv  = 1 + rand() % QTY_NV;
+    uint8_t val = rand();
+    uint8_t idx = rand() % QTY_EVENT;
+
+    switch( rand() % 4 )
+    {
+      case 0 :                                  /* module writes an NV       */
+        cacheSetNV( nv, val );
+        break;
+      case 1 :                                  /* FCU NVSET to this node    */
+      {
+        uint8_t f[5] { 0x96, MYNODE >> 8, MYNODE & 0xFF, nv, val };
+        cacheFrame( f, 5, MYNODE );
+        ee[NVS_START + nv - 1] = val;           /* CBUS library writes it    */
+        cacheSync();                            /* as loop()                 */
+        break;
+      }
+      case 2 :                                  /* NVSET to another node     */
+      {
+        uint8_t f[5] { 0x96, 0, 99, nv, val };
+        cacheFrame( f, 5, MYNODE );
+        break;
+      }
+      case 3 :                                  /* FCU teaches or unlearns   */
+      {
+        uint8_t f[7] { 0xD2, 0, 1, 0, idx, 1, val };
+        cacheFrame( f, 7, MYNODE );
+        for( uint8_t b = 0; b < EV_BYTES; b++ ) /* CBUS library writes slot  */
+        {
+          ee[EVS_START + idx * EV_BYTES + b] = ( val & 1 ? 0xFF : rand() );
+        }
+        cacheSync();                            /* as loop()                 */
+        break;
+      }
+    }
+    bad += compare();
+  }
+  bad += blobCheck();
+  printf( " CACHEchk %u rounds, load %u EEPROM reads, %u differ, %s\n",
+          rounds, loadReads, bad, ( bad == 0 ? "PASS" : "FAIL" ) );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------CACHEchk.cpp EoF ------------------------------*/
@@ -0,0 +1,245 @@
+/*file: CALchk.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) check of chan current calibration, src/CAL.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Each chan is a string with a known mA at PWM_TOP, a little bowed. Chan 4
+ *  is open, chan 8 is shorted. The Amp reading is their sum plus a base,
+ *  in 22 mA ADC steps with 1 step of noise, as the MEGA sees it.
+ * Calibration must find each curve, chan 4 OPEN and chan 8 SHORT, and store
+ *  them. Then, all chans lit and steady, chan 5 opens. The live check must
+ *  name chan 5, and clear it when the string is back. An abort part way
+ *  must not store anything, nor an event restore the PWM. Last, a soft
+ *  limit change in SHUTDOWN must not light the chans.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/CALchk.cpp src/CAL.cpp \
+ *       src/LIMIT.cpp src/CHAN.cpp src/LOG.cpp -o CALchk
+ *   ./CALchk                   exit 1 if any check fails
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "CAL.h"
+#include "LOG.h"
+#define HOST_PWM
+#include "HALhost.h"
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+static uint16_t pwmOut[QTY_CHAN];
+
+void    halWritePWM( uint8_t ch, uint16_t pwm ) { pwmOut[ch] = pwm; }
+
+
+const uint16_t EE_CAL  { 500 };       /* any free EEPROM address             */
+const uint16_t BASEMA  { 40 };        /* module, all chans off               */
+const uint16_t ADCMA   { 22 };        /* AMPCALIBRATE, mA per ADC count      */
+
+const uint16_t FULLMA[QTY_CHAN]       /* string mA at PWM_TOP                */
+{
+  120, 150, 180, 0, 240, 270, 300, 1900, 360, 390
+};
+
+static bool open5 { false };          /* chan 5 string comes off, live test  */
+
+
+static uint16_t chanMA( uint8_t ch )  /* true mA, bowed 1/8 at half PWM      */
+{
+  if( ch == 4 && open5 == true )
+  {
+    return 0;
+  }
+  double x = (double) pwmOut[ch] / PWM_TOP;
+
+  return FULLMA[ch] * x * ( 1.0 + 0.25 * ( 1.0 - x ) );
+}
+
+
+static uint16_t ampReading()          /* as Power::getmA(), ADC steps + noise */
+{
+  static uint32_t lcg { 12345 };
+  uint32_t mA = BASEMA;
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    mA += chanMA( ch );
+  }
+  lcg = lcg * 1103515245UL + 12345;
+  int32_t counts = ( mA + ADCMA / 2 ) / ADCMA + (int32_t) ( ( lcg >> 16 ) % 3 ) - 1;
+
+  return ( counts < 0 ? 0 : counts ) * ADCMA;
+}
+
+
+static void drainLog()
+{
+  logRec_t rec;
+  char line[LOG_LINE];
+
+  while( logPop( rec ) == true )
+  {
+    logFormat( rec, line, LOG_LINE );
+    printf( "   log %s\n", line );
+  }
+}
+
+
+static void tick( bool live )         /* 1 ms, ISR then a loop() pass        */
+{
+  simMs++;
+  processChannels();
+  if( calBusy() == true )
+  {
+    calRun( ampReading() );
+  }
+  else if( live == true )
+  {
+    calCheck( ampReading() );
+  }
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main()
+{
+  ADRNV NV;
+  uint8_t bad { 0 };
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.tran( ch )]   = 1;
+    nvs[NV.dc( ch, 0 )]  = 20;
+    nvs[NV.dc( ch, 1 )]  = 200;
+    nvs[NV.mode( ch )]   = MODE_DAYNIGHT;
+    nvs[NV.gamma( ch )]  = 1;           /* linear, so chans draw at dc 20  */
+  }
+  memset( ee, 0xFF, sizeof( ee ) );
+  calBegin( EE_CAL );
+  nightSw = NIGHTSW_NIGHT;
+  initChannels();
+  setupChannels();
+  for( uint16_t i = 0; i < 3000; i++ )  /* fade up to DC1, steady          */
+  {
+    tick( false );
+  }
+
+  /* calibration */
+  uint32_t ms = simMs;
+  calStart();
+  while( calBusy() == true && simMs - ms < 10000 )
+  {
+    tick( false );
+  }
+  printf( " calibration %u ms, base %u mA\n", simMs - ms, calBaseMA() );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    CALST_t want = ( ch == 3 ? CALST_OPEN : ch == 7 ? CALST_SHORT : CALST_OK );
+    bool ok = ( calState( ch ) == want );
+
+    printf( " ch%-2u", ch + 1 );
+    for( uint8_t p = 0; p < LIM_POINTS; p++ )
+    {
+      uint16_t pwm = ( p < LIM_POINTS - 1 ? ( p + 1 ) << LIM_PTSHIFT : PWM_TOP );
+      uint16_t got = limPwmMA( ch, pwm );
+
+      uint16_t now = pwmOut[ch];
+      pwmOut[ch] = pwm;
+      uint16_t real = chanMA( ch );
+      pwmOut[ch] = now;
+      if( want == CALST_OK && abs( got - real ) > LIM_UNITMA + real / 20 )
+      {
+        ok = false;
+      }
+      printf( "  %4u/%-4u", got, real );
+    }
+    printf( "  %u %s\n", calState( ch ), ( ok ? "ok" : "FAIL" ) );
+    bad += ! ok;
+  }
+  bool stored = ( ee[EE_CAL] == CAL_VALID && pwmHold == false );
+  printf( " stored %s, PWM back to engine %s\n", ( stored ? "ok" : "FAIL" ),
+          ( pwmHold == false ? "ok" : "FAIL" ) );
+  bad += ! stored;
+  drainLog();
+
+  /* live open string check */
+  for( uint16_t i = 0; i < 3000; i++ )
+  {
+    tick( true );
+  }
+  bool quiet = ( calState( 4 ) == CALST_OK );
+  open5 = true;
+  for( uint16_t i = 0; i < 5000; i++ )
+  {
+    tick( true );
+  }
+  bool found = ( calState( 4 ) == CALST_OPEN );
+  open5 = false;
+  for( uint16_t i = 0; i < 3000; i++ )
+  {
+    tick( true );
+  }
+  bool back = ( calState( 4 ) == CALST_OK );
+  printf( " live check, steady %s, ch5 open found %s, cleared %s\n",
+          ( quiet ? "ok" : "FAIL" ), ( found ? "ok" : "FAIL" ),
+          ( back ? "ok" : "FAIL" ) );
+  bad += ! quiet + ! found + ! back;
+  drainLog();
+
+  /* abort part way, as a Power fault */
+  uint8_t was[CAL_BYTES];
+  memcpy( was, &ee[EE_CAL], CAL_BYTES );
+  calStart();
+  for( uint16_t i = 0; i < 1000; i++ )
+  {
+    tick( false );
+  }
+  uint16_t pwmWas[QTY_CHAN];            /* ShutDown off, TestEnd, as events */
+  memcpy( pwmWas, pwmOut, sizeof( pwmOut ) );
+  setAllPWM( PWM_RESTORE );
+  restorePWM( 0 );
+  bool held = ( memcmp( pwmWas, pwmOut, sizeof( pwmOut ) ) == 0 );
+  printf( " restore while calibrating, PWM held %s\n", ( held ? "ok" : "FAIL" ) );
+  bad += ! held;
+  calAbort();
+  pwmHold = false;                      /* as Power RECOVER -> OK          */
+  setAllPWM( PWM_RESTORE );
+  bool kept = ( memcmp( was, &ee[EE_CAL], CAL_BYTES ) == 0 && ! calBusy() );
+  printf( " abort, EEPROM kept %s\n", ( kept ? "ok" : "FAIL" ) );
+  bad += ! kept;
+  drainLog();
+
+  /* SHUTDOWN, then the soft limit moves. The PWM must stay off */
+  uint16_t full = pwmOut[0];            /* chan 1 steady at dc 200         */
+  evCmd = EVAL_SHUTDOWN;                /* as eventHandler()               */
+  setAllPWM( PWM_OFF );
+  pwmScale = 120;
+  tick( false );
+  uint8_t lit { 0 };
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    lit += ( pwmOut[ch] != 0 );
+  }
+  evCmd = EVAL_NIGHTSW;
+  setAllPWM( PWM_RESTORE );
+  bool scaled = ( pwmOut[0] == ( ( (uint32_t) full * 120 ) >> 7 ) );
+  pwmScale = PWM_SCALE1;
+  tick( false );
+  printf( " shutdown, limit change lit %u %s, restored to scale %s\n", lit,
+          ( lit == 0 ? "ok" : "FAIL" ), ( scaled ? "ok" : "FAIL" ) );
+  bad += ( lit != 0 ) + ! scaled;
+
+  printf( " CALchk %s\n", ( bad == 0 ? "PASS" : "FAIL" ) );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------CALchk.cpp EoF ------------------------------*/
@@ -0,0 +1,318 @@
+/*file: CANsim.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) simulator for the CANlights channel engine.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Builds src/CHAN.cpp natively with a host HAL and drives the 1 ms tick for
+ *  simulated hours of day/night switching. Reports work done per tick and
+ *  an estimated ISR time, so ISR regressions show up without a scope on D31.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -DCHAN_STATS -Isrc host/CANsim.cpp \
+ *       src/CHAN.cpp src/SCENE.cpp src/PROF.cpp src/LIMIT.cpp -o CANsim
+ *   ./CANsim -h 24 -p 30 -t timeline.csv
+ *
+ *  -h n   simulated hours                              (default 24)
+ *  -p n   minutes between NightSw changes              (default 30)
+ *  -b n   ISR budget in us, exit 1 if estimate is over (default 87)
+ *  -n n   minutes between NV reloads, as 'N' command   (default 0, never)
+ *  -t f   write timeline CSV of every PWM write to file f
+ *  -m 1   print the chan to timer compare register map, see PWM.h
+ *  -g n   print gamma table n, DC to PWM 0 - PWM_TOP, see GAMMA.h
+ *  -s n   minutes between scene recalls, scenes 1 - 8 in turn (default 0)
+ *  -e m   all chans in mode m, EG. 9 - 12 for the effects, DC1 = 255
+ *  -a mA  each chan draws mA at full PWM, models the Amp sense (default 0)
+ *  -l 0   soft current limiter off, see LIMIT.h                (default 1)
+ *
+ * The ISR estimate of each tick goes to the profiler, PROF_ISR, as the MEGA
+ *  adds TCNT1. Its histogram is printed as 'P' does.
+ *
+ * With -a, the total mA of the PWM written each tick is the Amp reading fed
+ *  to limUpdate(), as loop() does. Peak mA is printed with and without the
+ *  limiter, and exit is 1 if the limited peak tops LIM_BUDGETMA.
+ *
+ * PWM.h static_asserts check PWMPIN[] against the timer table when this
+ *  builds, the same checks as the MEGA build.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "CHAN.h"
+#include "PWM.h"
+#include "GAMMA.h"
+#include "DEFAULTNV.h"
+#include "SCENE.h"
+#include "PROF.h"
+#include "LIMIT.h"
+#define HOST_PWM                      /* halWritePWM() below, logs the write */
+#include "HALhost.h"
+
+
+/* ISR cost model, us on 16 MHz MEGA.
+ * Rough figures that reproduced the scope readings on PINTP_D31 of
+ *  21 us (10 chans idle) and 87 us (10 chans stepping) with analogWrite().
+ * PWM writes are now a store to OCRnx, see PWM.h
+*/
+const double COST_BASE   { 5.0 };   /* ISR entry/exit, LED_BUILTIN write    */
+const double COST_TOUCH  { 1.2 };   /* per channel processed                */
+const double COST_BRANCH { 0.2 };   /* per decision                         */
+const double COST_PWM    { 0.5 };   /* per OCRnx store, dirty chan flush    */
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+static uint16_t pwmOut[QTY_CHAN];     /* latest PWM value, 0 - PWM_TOP       */
+static uint32_t pwmWrites;            /* PWM writes this tick                */
+static uint32_t pwmTotal[QTY_CHAN];   /* PWM writes per channel              */
+static FILE   * timeline;             /* CSV output, or NULL                 */
+
+
+void halWritePWM( uint8_t ch, uint16_t pwm )
+{
+  pwmOut[ch] = pwm;
+  pwmWrites++;
+  pwmTotal[ch]++;
+  if( timeline != NULL )
+  {
+    fprintf( timeline, "%u,%u,%u,%u,%u,%u\n", simMs, ch + 1, var[ch].dcCur,
+             pwm, var[ch].state, var[ch].phase );
+  }
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  uint32_t hours  { 24 };
+  uint32_t period { 30 };
+  uint32_t reload { 0 };
+  uint32_t scene  { 0 };
+  int      mode   { -1 };
+  uint16_t fullMA { 0 };
+  bool     limOn  { true };
+  double   budget { 87.0 };
+
+  for( int a = 1; a < argc - 1; a += 2 )
+  {
+    if( strcmp( argv[a], "-h" ) == 0 )      hours  = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-p" ) == 0 ) period = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-b" ) == 0 ) budget = atof( argv[a + 1] );
+    else if( strcmp( argv[a], "-n" ) == 0 ) reload = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-s" ) == 0 ) scene  = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-e" ) == 0 ) mode   = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-a" ) == 0 ) fullMA = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-l" ) == 0 ) limOn  = atoi( argv[a + 1] );
+    else if( strcmp( argv[a], "-m" ) == 0 )
+    {
+      printf( " ch  pin  timer  OCR   addr   TCCRnA  COM\n" );
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        printf( " %2u  %3u  %5u  %u%c  0x%03X  0x%03X   0x%02X %s\n", ch + 1,
+          PWMPIN[ch], pwmTimer( PWMPIN[ch] ), pwmTimer( PWMPIN[ch] ),
+          'A' + pwmComp( PWMPIN[ch] ), OCR[ch].adr, OCR[ch].tccr, OCR[ch].com,
+          ( OCR[ch].wide ? "16 bit" : "8 bit dither" ) );
+      }
+    }
+    else if( strcmp( argv[a], "-g" ) == 0 )
+    {
+      uint8_t g = atoi( argv[a + 1] ) % QTY_GAMMA;
+
+      printf( " gamma %u, exponent %u/8", g, GAMMA8TH[g] );
+      for( uint16_t dc = 0; dc < 256; dc++ )
+      {
+        printf( "%s%4u", ( dc % 16 == 0 ? "\n " : " " ), gammaLook( g, dc ) );
+      }
+      printf( "\n" );
+    }
+    else if( strcmp( argv[a], "-t" ) == 0 )
+    {
+      timeline = fopen( argv[a + 1], "w" );
+      if( timeline == NULL )
+      {
+        perror( argv[a + 1] );
+        return 2;
+      }
+      fprintf( timeline, "ms,ch,dcCur,pwm,state,phase\n" );
+    }
+  }
+  if( period == 0 )
+  {
+    period = 1;
+  }
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    nvs[nv] = defaultNV( nv );
+  }
+  if( mode >= 0 )
+  {
+    ADRNV NV;
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      nvs[NV.mode( ch )] = mode;
+      nvs[NV.dc( ch, 1 )] = DC_MAX;
+    }
+  }
+  memset( ee, 0xFF, sizeof( ee ) );
+  sceneBegin( 0 );
+  for( uint8_t n = 0; n < QTY_SCENE - 1; n++ )  /* scene 8 is left empty      */
+  {
+    sceneChan_t sc[QTY_CHAN];
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      sc[ch] = { (uint8_t) ( ( n * 37 + ch * 23 ) & 0xFF ),
+                 (uint8_t) ( ( n + ch ) % 4 ), (uint8_t) ( ch % 2 ) };
+    }
+    sceneSave( n, sc );
+  }
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    limSetFull( ch, fullMA );
+  }
+  nightSw = NIGHTSW_DAY;
+  initChannels();
+  setupChannels();
+
+  const uint32_t endMs { (uint32_t) ( hours * 3600000UL ) };
+  const uint32_t swMs  { (uint32_t) ( period * 60000UL ) };
+  const uint32_t nvMs  { (uint32_t) ( reload * 60000UL ) };
+  const uint32_t scMs  { (uint32_t) ( scene * 60000UL ) };
+  uint32_t scenes { 0 }, scenesEmpty { 0 };
+
+  uint32_t maxTouch { 0 }, maxBranch { 0 }, maxPwm { 0 }, overBudget { 0 };
+  uint64_t sumTouch { 0 }, sumBranch { 0 }, sumPwm { 0 };
+  double   maxUs { 0 }, sumUs { 0 };
+  uint32_t maxUsAt { 0 };
+  uint32_t mA { 0 }, peakMA { 0 }, peakFree { 0 }, peakAt { 0 }, msLimited { 0 };
+
+  for( simMs = 1; simMs <= endMs; simMs++ )
+  {
+    if( simMs % swMs == 0 )                 /* as loop() on NightSw change   */
+    {
+      nightSw = (NIGHTSW_t) ! nightSw;
+      startNewPhase();
+    }
+    if( nvMs != 0 && simMs % nvMs == 0 )    /* as 'N' command in loop()      */
+    {
+      setupChannels();
+    }
+    if( scMs != 0 && simMs % scMs == 0 )    /* as a Scene event              */
+    {
+      if( sceneRecall( scenes++ % QTY_SCENE ) == false )
+      {
+        scenesEmpty++;
+      }
+    }
+    if( limOn == true && fullMA != 0 )      /* as loop(), Amp sense in mA    */
+    {
+      limUpdate( mA );
+    }
+    chanStat.touched = 0;
+    chanStat.branches = 0;
+    pwmWrites = 0;
+
+    processChannels();                      /* as Timer1 ISR                 */
+    checkTicks();                           /* as loop()                     */
+
+    double us = COST_BASE + COST_TOUCH * chanStat.touched
+              + COST_BRANCH * chanStat.branches + COST_PWM * pwmWrites;
+
+    sumTouch  += chanStat.touched;
+    sumBranch += chanStat.branches;
+    sumPwm    += pwmWrites;
+    sumUs     += us;
+    if( chanStat.touched > maxTouch )   maxTouch  = chanStat.touched;
+    if( chanStat.branches > maxBranch ) maxBranch = chanStat.branches;
+    if( pwmWrites > maxPwm )            maxPwm    = pwmWrites;
+    if( us > maxUs )
+    {
+      maxUs = us;
+      maxUsAt = simMs;
+    }
+    if( us > budget )
+    {
+      overBudget++;
+    }
+    profAdd( PROF_ISR, us * PROF_ISRDIV );  /* as halIsrEnd() adds TCNT1     */
+
+    if( fullMA != 0 )                       /* model mA, written and unscaled */
+    {
+      uint32_t free { 0 };
+
+      mA = 0;
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        mA += ( (uint32_t) fullMA * pwmOut[ch] ) >> PWM_BITS;
+        free += limChanMA( ch, var[ch].dcCur );
+      }
+      if( mA > peakMA )
+      {
+        peakMA = mA;
+        peakAt = simMs;
+      }
+      peakFree = ( free > peakFree ? free : peakFree );
+      msLimited += ( pwmScale != PWM_SCALE1 );
+    }
+  }
+  if( timeline != NULL )
+  {
+    fclose( timeline );
+  }
+
+  printf( "CANsim %u h, NightSw change every %u min, %u ticks\n",
+          hours, period, endMs );
+  printf( "           mean     max\n" );
+  printf( " touched %7.2f %7u\n", (double) sumTouch / endMs, maxTouch );
+  printf( " branches%7.2f %7u\n", (double) sumBranch / endMs, maxBranch );
+  printf( " pwm     %7.3f %7u\n", (double) sumPwm / endMs, maxPwm );
+  printf( " ISR us  %7.2f %7.2f  (at %u ms)\n", sumUs / endMs, maxUs, maxUsAt );
+  printf( " ticks over %.1f us budget = %u\n", budget, overBudget );
+  printf( " ticks lost = %d, config swaps = %u\n", ticksLost, cfgSwaps );
+  printf( " scene recalls = %u, empty = %u\n", scenes, scenesEmpty );
+
+  profStat_t isr;
+  profGet( PROF_ISR, isr );
+  printf( " PROF_ISR min %.1f mean %.1f max %.1f us, DGN 1-3 = %u %u %u\n  hist",
+          (double) isr.min / PROF_ISRDIV, (double) isr.sum / isr.n / PROF_ISRDIV,
+          (double) isr.max / PROF_ISRDIV, profDiag( PROFDGN_ISRMIN ),
+          profDiag( PROFDGN_ISRMEAN ), profDiag( PROFDGN_ISRMAX ) );
+  for( uint8_t b = 0; b < PROF_BUCKETS; b++ )
+  {
+    if( isr.hist[b] != 0 )
+    {
+      printf( " %u:%u", b, isr.hist[b] );
+    }
+  }
+  printf( "\n" );
+  bool overMA { false };
+  if( fullMA != 0 )
+  {
+    limStat_t ls;
+    limGet( ls );
+    overMA = ( limOn == true && peakMA > LIM_BUDGETMA );
+    printf( " current %u mA/chan, limiter %s. peak %u mA (at %u ms), "
+            "unlimited %u mA\n", fullMA, ( limOn ? "on" : "off" ), peakMA,
+            peakAt, peakFree );
+    printf( " budget %u mA, limited %u ms, %u times, last scale %u/128 %s\n",
+            LIM_BUDGETMA, msLimited, ls.limits, ls.scale,
+            ( overMA ? "OVER" : "ok" ) );
+  }
+  printf( " ch  pwmWrites  dcCur  state  phase\n" );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    printf( " %2u  %9u  %5u  %5u  %5u\n", ch + 1, pwmTotal[ch], var[ch].dcCur,
+            var[ch].state, var[ch].phase );
+  }
+  return ( overBudget == 0 && overMA == false ? 0 : 1 );
+}
+
+
+/*-------------------------------CANsim.cpp EoF ------------------------------*/
@@ -0,0 +1,233 @@
+/*file: CHANbench.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) benchmark of ISR cost at 10, 16 and 24 chans, src/BAM.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The engine is built 3 times, CHANS 10, 16 and 24, see CHANnode.h. Each
+ *  runs the factory NVs, chans 11 up repeat chans 1 - 10, with a NightSw
+ *  change each -p minutes. Per tick work is costed with the CANsim.cpp
+ *  model, plus a BAM table write for each chan 11 up that changed.
+ *
+ * The BAM slot ISRs are costed apart, per ms. They are the same for any
+ *  chan count. Against them, a plain software PWM, 1 ISR a unit with a
+ *  compare per chan, grows with the chans.
+ *
+ * Checks, exit 1 if any fails...
+ *  - a BAM frame shows each chan on for its level in units, 0 - 255.
+ *  - engine worst tick is within -b us, the bit 6 slot it runs in.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -DCHAN_STATS -Isrc host/CHANbench.cpp -o CHANbench
+ *   ./CHANbench -h 1
+ *
+ *  -h n   simulated hours                              (default 1)
+ *  -p n   minutes between NightSw changes              (default 1)
+ *  -b n   engine tick budget, us                       (default 500)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "CHAN.h"              /* QTY_PWMCHAN. Each count takes its own too   */
+#include "PIN.h"               /* BAMPIN[]                                    */
+#define HOST_PWM               /* chans 11 up to the BAM of the count running */
+#include "HALhost.h"
+
+
+struct benchApi_t                     /* a chan count, see CHANnode.h        */
+{
+  uint8_t   chans;
+  void    ( * boot )();
+  void    ( * night )( bool on );
+  void    ( * tick )( uint8_t & touched, uint8_t & branches );
+  void    ( * bamWrite )( uint8_t i, uint16_t pwm );
+  const uint8_t * ( * bamSlot )( uint8_t s );
+};
+
+namespace c10 {
+#undef CHANS
+#define CHANS 10
+#include "CHANnode.h"
+}
+namespace c16 {
+#undef CHANS
+#define CHANS 16
+#include "CHANnode.h"
+}
+namespace c24 {
+#undef CHANS
+#define CHANS 24
+#include "CHANnode.h"
+}
+
+
+/* ISR cost model, us on 16 MHz MEGA. The engine figures are CANsim.cpp's */
+const double COST_BASE   { 5.0 };   /* ISR entry/exit, LED_BUILTIN write    */
+const double COST_TOUCH  { 1.2 };   /* per channel processed                */
+const double COST_BRANCH { 0.2 };   /* per decision                         */
+const double COST_PWM    { 0.5 };   /* per OCRnx store, dirty chan flush    */
+const double COST_BAMW   { 3.0 };   /* per bamWrite(), 8 row bit updates    */
+const double COST_SLOT   { 4.0 };   /* BAM slot ISR, OCR1A and 3 port RMW   */
+const double COST_SWAP   { 2.0 };   /* frame start takes bamNext[], 24 B    */
+const double COST_SOFT   { 3.0 };   /* plain soft PWM, ISR each unit        */
+const double COST_SOFTCH { 0.5 };   /*  plus a compare per chan             */
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+static const benchApi_t * bench;     /* chan count running                  */
+static uint16_t timerWrites;          /* this tick                           */
+static uint16_t bamWrites;
+
+void halWritePWM( uint8_t ch, uint16_t pwm )
+{
+  if( ch >= QTY_PWMCHAN )             /* as HAL.cpp                          */
+  {
+    bench->bamWrite( ch - QTY_PWMCHAN, pwm );
+    bamWrites++;
+    return;
+  }
+  timerWrites++;
+}
+
+
+static uint8_t bad { 0 };
+
+static void check( const char * what, bool ok )
+{
+  printf( " %-48s %s\n", what, ( ok ? "ok" : "FAIL" ) );
+  bad += ! ok;
+}
+
+
+/*------------------------------- bamDuty() -----------------------------------
+ *
+ * each level on each BAM chan, a frame at a time, units on must equal it
+*/
+
+static bool bamDuty( const benchApi_t & b )
+{
+  uint8_t qty = b.chans - QTY_PWMCHAN;
+
+  for( uint16_t round = 0; round < 256; round++ )
+  {
+    for( uint8_t i = 0; i < qty; i++ )
+    {
+      b.bamWrite( i, ( ( round + i * 17 ) & 0xFF ) << ( PWM_BITS - 8 ) );
+    }
+    uint16_t on[QTY_BAMMAX] { };
+
+    for( uint8_t s = 0; s < c24::BAM_SLOTS; s++ )
+    {
+      const uint8_t * row = b.bamSlot( s );
+
+      for( uint8_t i = 0; i < qty; i++ )
+      {
+        if( row[BAMPIN[i].port] & ( 1U << BAMPIN[i].bit ) )
+        {
+          on[i] += c24::bamUnits( s );
+        }
+      }
+    }
+    for( uint8_t i = 0; i < qty; i++ )
+    {
+      if( on[i] != ( ( round + i * 17 ) & 0xFF ) )
+      {
+        printf( "  chan %u level %u on %u units\n", QTY_PWMCHAN + i + 1,
+                ( round + i * 17 ) & 0xFF, on[i] );
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  const benchApi_t * const API[] { &c10::api, &c16::api, &c24::api };
+  double hours { 1.0 }, perMin { 1.0 }, budget { 500.0 };
+
+  for( int i = 1; i + 1 < argc; i += 2 )
+  {
+    double v = atof( argv[i + 1] );
+
+    switch( argv[i][1] )
+    {
+      case 'h' : hours = v;  break;
+      case 'p' : perMin = v; break;
+      case 'b' : budget = v; break;
+    }
+  }
+
+  uint32_t endMs = hours * 3600000.0;
+  uint32_t nightMs = perMin * 60000.0;
+  double   worst { 0.0 };
+
+  printf( " %.1f h, NightSw each %.0f min, factory NVs\n", hours, perMin );
+  printf( " chans  BAM  engine us mean   max   BAM slots us/ms  soft PWM us/ms"
+          "  host ns/tick\n" );
+  for( const benchApi_t * b : API )
+  {
+    bench = b;
+    simMs = 0;
+    b->boot();
+
+    uint8_t  qty = b->chans - QTY_PWMCHAN;
+    double   sumUs { 0.0 }, maxUs { 0.0 }, slotUs { 0.0 };
+    bool     swap { false };              /* BAM writes since frame start */
+    auto     t0 = std::chrono::steady_clock::now();
+
+    for( simMs = 1; simMs <= endMs; simMs++ )
+    {
+      if( simMs % nightMs == 0 )
+      {
+        b->night( simMs / nightMs % 2 );
+      }
+      uint8_t touched, branches;
+      timerWrites = 0;
+      bamWrites = 0;
+      b->tick( touched, branches );
+
+      double us = COST_BASE + COST_TOUCH * touched
+                + COST_BRANCH * branches + COST_PWM * timerWrites
+                + COST_BAMW * bamWrites;
+
+      sumUs += us;
+      maxUs = ( us > maxUs ? us : maxUs );
+      swap |= ( bamWrites != 0 );
+      if( qty != 0 && simMs % 2 == 0 )   /* a 2 ms BAM frame                */
+      {
+        slotUs += c24::BAM_SLOTS * COST_SLOT + ( swap ? COST_SWAP : 0.0 );
+        swap = false;
+      }
+    }
+    double ns = std::chrono::duration< double, std::nano >(
+                  std::chrono::steady_clock::now() - t0 ).count() / endMs;
+    double soft = ( qty == 0 ? 0.0
+                  : 128 * ( COST_SOFT + COST_SOFTCH * qty ) ); /* units/ms */
+
+    printf( "  %3u   %3u  %14.2f %6.1f  %15.2f  %14.1f  %12.0f\n", b->chans,
+            qty, sumUs / endMs, maxUs, slotUs / endMs, soft, ns );
+    worst = ( maxUs > worst ? maxUs : worst );
+  }
+
+  check( "BAM frame on units = level, 14 chans x 256", bamDuty( c24::api ) );
+  check( "BAM frame on units = level, 6 chans x 256", bamDuty( c16::api ) );
+  check( "engine worst tick within budget", worst <= budget );
+
+  printf( " CHANbench %s\n", ( bad == 0 ? "PASS" : "FAIL" ) );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------CHANbench.cpp EoF ------------------------------*/
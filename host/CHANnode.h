@@ -0,0 +1,60 @@
+/*file: CHANnode.h
+ *----------------------------------------------------------------------------
+ *
+ * One chan count for host/CHANbench.cpp. Define CHANS, then include it
+ *  inside a namespace. It builds a private copy of the channel engine and
+ *  BAM, src/CHAN.cpp and src/BAM.cpp, and gives them as a benchApi_t.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * As host/SYNCnode.h, the engine headers are taken again in each namespace.
+ *  HAL.h and PIN.h stay global. No include guard, on purpose.
+*/
+#undef CHAN_H__
+#undef GAMMA_H__
+#undef EASE_H__
+#undef MODE_H__
+#undef EFFECT_H__
+#undef SEQ_H__
+#undef BAM_H__
+#undef DEFAULTNV_H__
+
+#include "CHAN.cpp"
+#include "BAM.cpp"
+#include "DEFAULTNV.h"
+
+
+static void boot()                     /* as setup(), factory NVs            */
+{
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    nvs[nv] = defaultNV( nv );
+  }
+  nightSw = NIGHTSW_DAY;
+  initChannels();
+  setupChannels();
+}
+
+
+static void night( bool on )           /* NightSw event, as taskPhase()      */
+{
+  nightSw = (NIGHTSW_t) on;
+  startNewPhase();
+}
+
+
+static void tick( uint8_t & touched, uint8_t & branches ) /* 1 ms ISR      */
+{
+  chanStat = chanStat_t { };
+  processChannels();
+  touched = chanStat.touched;
+  branches = chanStat.branches;
+}
+
+
+const benchApi_t api { QTY_CHAN, boot, night, tick, bamWrite, bamSlot };
+
+
+/*-------------------------------CHANnode.h EoF ------------------------------*/
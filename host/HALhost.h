@@ -0,0 +1,64 @@
+/*file: HALhost.h
+ *----------------------------------------------------------------------------
+ *
+ * Host HAL for the checks in host/, see src/HAL.h. Include once, at file
+ *  scope, before any namespace that builds the engine.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * nvs[] stands in for the NVs, ee[] for the EEPROM and simMs for the clock.
+ *  ee[] is zero, a check that wants it erased sets it to 0xFF. Define, before
+ *  the include, to give your own...
+ *   HOST_PWM       halWritePWM(), else PWM writes go nowhere.
+ *   HOST_EEWRITE   halWriteEE(), EG. a rail that dies part way.
+ *   HOST_EE        halReadEE() & halWriteEE(), no ee[]. EG. one per node.
+ *   HOST_NV        halReadNV(), no nvs[].
+ *   HOST_CLOCK     halMillis() & halMicros(), no simMs. EG. a us clock.
+*/
+#ifndef HALHOST_H__  /* include guard */
+#define HALHOST_H__
+
+#include <stdio.h>
+
+#include "HAL.h"
+
+
+#ifndef HOST_NV
+static uint8_t  nvs[256];             /* NV 1 - QTY_NV of any CHANS, [0] unused */
+#endif
+#ifndef HOST_EE
+static uint8_t  ee[4096];             /* the EEPROM                          */
+#endif
+#ifndef HOST_CLOCK
+static uint32_t simMs;
+#endif
+
+#ifndef HOST_PWM
+void    halWritePWM( uint8_t, uint16_t ) { }
+#endif
+#ifndef HOST_NV
+uint8_t halReadNV( uint8_t nv )        { return nvs[nv]; }
+#endif
+#ifndef HOST_EE
+uint8_t halReadEE( uint16_t adr )      { return ee[adr]; }
+#ifndef HOST_EEWRITE
+void    halWriteEE( uint16_t adr, uint8_t val ) { ee[adr] = val; }
+#endif
+#endif
+void    halDither() { }
+void    halTransitLED( bool ) { }
+void    halNightLED( bool ) { }
+void    halIsrStart() { }
+void    halIsrEnd() { }
+void    halWarn( const char * msg, uint8_t ch ) { printf( "%s%u\n", msg, ch + 1 ); }
+#ifndef HOST_CLOCK
+uint32_t halMillis()                   { return simMs; }
+uint32_t halMicros()                   { return simMs * 1000UL; }
+#endif
+
+
+#endif /* HALHOST_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,170 @@
+/*file: LOGdec.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) decoder for CANlights binary log output. See src/LOG.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Serial Monitor 'b' switches the log to binary. Capture the serial port to
+ *  a file, then decode it to the same text lines as text mode.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/LOGdec.cpp src/LOG.cpp -o LOGdec
+ *   ./LOGdec capture.bin       (or stdin, if no file)
+ *   ./LOGdec -s                self check, exit 1 if it fails
+ *
+ * Self check fills the ring past full with no drain, as a busy bus with
+ *  Serial stalled. logPut() must not wait, drops must be counted and the
+ *  records must come back the same through the binary encoder/decoder.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "LOG.h"
+#include "HALhost.h"                  /* simMs, LOG.cpp timestamps           */
+
+
+/*------------------------------- logDecode() ---------------------------------
+ *
+ * parse 1 record from buf. Returns bytes used, 0 if more bytes needed.
+ *  Bytes that do not start a valid record are skipped, 1 at a time.
+*/
+
+static size_t logDecode( const uint8_t * buf, size_t len, logRec_t & rec,
+                         bool & ok )
+{
+  ok = false;
+  if( buf[0] != LOG_SYNC )
+  {
+    return 1;
+  }
+  if( len < 7 )
+  {
+    return 0;
+  }
+  if( buf[5] >= QTY_LOG || buf[6] > LOG_ARGS )
+  {
+    return 1;                         /* not a record, resync               */
+  }
+  if( len < (size_t)( 7 + buf[6] ) )
+  {
+    return 0;
+  }
+  rec.ms = buf[1] | ( buf[2] << 8 ) | ( buf[3] << 16 ) | ( (uint32_t) buf[4] << 24 );
+  rec.id = (LOG_t) buf[5];
+  rec.len = buf[6];
+  memcpy( rec.arg, &buf[7], rec.len );
+  ok = true;
+  return 7 + rec.len;
+}
+
+
+/*------------------------------- selfCheck() ---------------------------------
+*/
+
+static int selfCheck()
+{
+  const uint8_t OVER { 5 };
+  uint8_t  bin[( LOG_QTY + 1 ) * LOG_BIN];
+  size_t   binLen { 0 };
+  char     want[LOG_QTY + 1][LOG_LINE];
+  uint8_t  qty { 0 };
+  double   nsMax { 0 };
+
+  for( uint8_t i = 0; i < LOG_QTY + OVER; i++ )    /* no drain, ring fills   */
+  {
+    simMs = 1000 + i;
+    auto t0 = std::chrono::steady_clock::now();
+    logPut( LOG_EVTEST, i & 1, 1 + i % 10, 254 );
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration< double, std::nano >( t1 - t0 ).count();
+    nsMax = ( ns > nsMax ? ns : nsMax );
+  }
+  printf( " logPut x%u, max %.0f ns, dropped %u (want %u)\n",
+          LOG_QTY + OVER, nsMax, logDropped, OVER );
+
+  logRec_t rec;
+  while( logPop( rec ) == true )
+  {
+    logFormat( rec, want[qty++], LOG_LINE );
+    binLen += logEncode( rec, &bin[binLen] );
+  }
+
+  uint8_t got { 0 };
+  bool    same { true };
+  for( size_t p = 0; p < binLen; )
+  {
+    bool ok;
+    size_t n = logDecode( &bin[p], binLen - p, rec, ok );
+    if( n == 0 )
+    {
+      break;
+    }
+    p += n;
+    if( ok == true )
+    {
+      char line[LOG_LINE];
+      logFormat( rec, line, LOG_LINE );
+      same = same && got < qty && strcmp( line, want[got] ) == 0;
+      printf( " %s\n", line );
+      got++;
+    }
+  }
+  bool pass = ( logDropped == OVER && qty == LOG_QTY + 1 && got == qty && same );
+
+  printf( " records %u, decoded %u, %s\n", qty, got, ( pass ? "PASS" : "FAIL" ) );
+  return ( pass ? 0 : 1 );
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  if( argc > 1 && strcmp( argv[1], "-s" ) == 0 )
+  {
+    return selfCheck();
+  }
+  FILE * in = ( argc > 1 ? fopen( argv[1], "rb" ) : stdin );
+  if( in == NULL )
+  {
+    perror( argv[1] );
+    return 2;
+  }
+  uint8_t buf[256];
+  size_t  len { 0 };
+  size_t  n;
+
+  while( ( n = fread( &buf[len], 1, sizeof( buf ) - len, in ) ) > 0 )
+  {
+    len += n;
+    size_t p { 0 };
+    for( ;; )
+    {
+      logRec_t rec;
+      bool ok;
+      size_t used = ( p < len ? logDecode( &buf[p], len - p, rec, ok ) : 0 );
+      if( used == 0 )
+      {
+        break;
+      }
+      p += used;
+      if( ok == true )
+      {
+        char line[LOG_LINE];
+        logFormat( rec, line, LOG_LINE );
+        printf( "%s\n", line );
+      }
+    }
+    memmove( buf, &buf[p], len - p );
+    len -= p;
+  }
+  return 0;
+}
+
+/*-------------------------------LOGdec.cpp EoF ------------------------------*/
@@ -0,0 +1,374 @@
+/*file: MODEchk.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) check of every mode's phase sequence. See src/MODE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Builds src/CHAN.cpp natively. First run, chan 1 - 9 in mode 0 - 8, chan 10
+ *  in RANDOM010 with a long delay. Second run, the effect modes, with a chan
+ *  test and a SHUTDOWN while they run. Drives a NightSw script through the 1 ms tick
+ *  and records the phase of every transit each chan starts. '|' marks each
+ *  NightSw change. The traces must match the mode rules in CHAN.h
+ *  A scene recall 40 s in must start at once. See sceneRun()
+ *  Last, boot and scene transits must land on their dc at secTrans, cut
+ *  into a slice per dc they move. See transitRun()
+ * Delay NV 1 is 2 s, secCount must pass secDelay, so a 010 cycle is 3 s.
+ *  The RANDOM010 traces are for seedChannels( 2021 ).
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/MODEchk.cpp src/CHAN.cpp -o MODEchk
+ *   ./MODEchk                  exit 1 if any trace differs
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "CHAN.h"
+#include "HALhost.h"
+
+
+/* NightSw script. Boot is DAY. The short NIGHT at 40 s lands while ONESHOT
+ *  is still running, so it must be ignored.
+*/
+struct step_t
+{
+  uint32_t  ms;
+  NIGHTSW_t sw;
+};
+
+const step_t SCRIPT[]
+{
+  { 10000, NIGHTSW_NIGHT }, { 30000, NIGHTSW_DAY },
+  { 40000, NIGHTSW_NIGHT }, { 41000, NIGHTSW_DAY }
+};
+const uint8_t  QTY_STEP { sizeof( SCRIPT ) / sizeof( SCRIPT[0] ) };
+const uint32_t END_MS { 55000 };
+
+const uint8_t GROUPS { 2 };
+
+const uint8_t MODES[GROUPS][QTY_CHAN]  /* chan modes, each run */
+{
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, MODE_RANDOM010 },
+  { MODE_FLICKER, MODE_FIRE, MODE_ARC, MODE_STROBE,
+    MODE_FLICKER, MODE_FIRE, MODE_ARC, MODE_STROBE, 0, 0 }
+};
+
+/* transit phases, E = effect runs, '|' = NightSw change */
+const char * const WANT[GROUPS][QTY_CHAN]
+{
+  {
+    "0|1|0||0",                                /* DAYNIGHT                  */
+    "0|10|0||0",                               /* DUSK                      */
+    "10|0|10|0|10",                            /* DAWN                      */
+    "10|10|10||10",                            /* DUSKDAWN, 41 s restarts   */
+    "0|101010|0||0",                           /* NIGHT010, 30 s 1 is DAY's */
+    "101|0|101|0|1010",                        /* DAY010, 55 s is END_MS    */
+    "101|0101010|101||01010",                  /* ALWAYS010, input ignored  */
+    "0|10101010|||0",                          /* RANDOM010, delay 1 - 2 s  */
+    "0|10|0||10",                              /* ONESHOT, 41 s edge ignored */
+    "0|10|0||0"                                /* RANDOM010, delay 1 - 9 s  */
+  },
+  {
+    "0|1E|0||0",                               /* effects, rate 1           */
+    "0|1E|0||0",
+    "0|1E|0||0",
+    "0|1E|0||0",
+    "0|1E|0||0",                               /* effects, rate 255         */
+    "0|1E|0||0",
+    "0|1E|0||0",
+    "0|1E|0||0",
+    "0|1|0||0",
+    "0|1|0||0"
+  }
+};
+
+
+/*------------------------------- run() ---------------------------------------
+ *
+ * run the script with chan modes of group g. Group 1 also tests chan 1 at
+ *  20 - 22 s and SHUTDOWN at 25 - 26 s, in the effect. Frozen chans must
+ *  not change dc and an effect dc must stay at or below DC1.
+*/
+
+static uint8_t run( uint8_t g )
+{
+  ADRNV NV;
+  char    trace[QTY_CHAN][80] { };
+  uint8_t len[QTY_CHAN] { };
+  STATE_t lastState[QTY_CHAN];
+  uint8_t lastPhase[QTY_CHAN];
+  uint8_t frozenDC[QTY_CHAN];
+  uint32_t effectSteps { 0 }, overLevel { 0 }, thawed { 0 };
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.tran( ch )]   = 1;
+    nvs[NV.dly( ch, 0 )] = ( g == 1 && ch >= 4 && ch < 8 ? 255 : 1 );
+    nvs[NV.dly( ch, 1 )] = ( ch == 9 ? 8 : 1 );
+    nvs[NV.dc( ch, 0 )]  = 20;
+    nvs[NV.dc( ch, 1 )]  = 220;
+    nvs[NV.mode( ch )]   = MODES[g][ch];
+    nvs[NV.gamma( ch )]  = 0;
+  }
+  nightSw = NIGHTSW_DAY;
+  evCmd = EVAL_NIGHTSW;
+  seedChannels( 2021 );
+  initChannels();
+  setupChannels();
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    lastState[ch] = var[ch].state;
+    lastPhase[ch] = var[ch].phase;
+    frozenDC[ch] = var[ch].dcCur;
+  }
+
+  uint8_t s { 0 };
+  for( simMs = 1; simMs < END_MS; simMs++ )
+  {
+    if( s < QTY_STEP && simMs == SCRIPT[s].ms ) /* as loop(), NightSw change */
+    {
+      nightSw = SCRIPT[s++].sw;
+      startNewPhase();
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        trace[ch][len[ch]++] = '|';
+      }
+    }
+    if( g == 1 )                            /* as eventHandler()             */
+    {
+      switch( simMs )
+      {
+        case 20000 : evCmd = EVAL_TESTCH1; testDC = 254; break;
+        case 22000 : evCmd = EVAL_NIGHTSW; break;
+        case 25000 : evCmd = EVAL_SHUTDOWN; break;
+        case 26000 : evCmd = EVAL_NIGHTSW; break;
+      }
+    }
+    processChannels();                      /* as Timer1 ISR                 */
+
+    bool test = ( simMs >= 20000 && simMs < 22000 );
+    bool shut = ( simMs >= 25000 && simMs < 26000 );
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      STATE_t st = var[ch].state;
+      uint8_t ph = var[ch].phase;
+
+      if( ( st == STATE_TRANSIT || st == STATE_EFFECT )
+          && ( lastState[ch] != st || lastPhase[ch] != ph )
+          && len[ch] < sizeof( trace[ch] ) - 1 )
+      {
+        trace[ch][len[ch]++] = ( st == STATE_EFFECT ? 'E' : '0' + ph );
+      }
+      if( st == STATE_EFFECT )
+      {
+        effectSteps += ( var[ch].dcCur != frozenDC[ch] );
+        overLevel += ( var[ch].dcCur > 220 );
+      }
+      if( g == 1 && ( shut || ( test && ch == 0 ) ) )
+      {
+        thawed += ( var[ch].dcCur != frozenDC[ch] );
+      }
+      frozenDC[ch] = var[ch].dcCur;
+      lastState[ch] = st;
+      lastPhase[ch] = ph;
+    }
+  }
+  uint8_t bad { 0 };
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    bool ok = ( strcmp( trace[ch], WANT[g][ch] ) == 0 );
+    bad += ! ok;
+    printf( " ch%-2u mode %2u  %-26s %s\n", ch + 1, cfgBuf[cfgLive][ch].mode,
+            trace[ch], ( ok ? "ok" : "FAIL" ) );
+    if( ! ok )
+    {
+      printf( "             want %s\n", WANT[g][ch] );
+    }
+  }
+  if( g == 1 )
+  {
+    bool ok = ( effectSteps > 1000 && overLevel == 0 && thawed == 0 );
+    bad += ! ok;
+    printf( " effect dc changes %u, over DC1 %u, changed while frozen %u %s\n",
+            effectSteps, overLevel, thawed, ( ok ? "ok" : "FAIL" ) );
+  }
+  return bad;
+}
+
+
+/*------------------------------- sceneRun() ----------------------------------
+ *
+ * scene recall well into a run, past the 16 bit tick wrap half way. All
+ *  chans to dc 200 with no delay or transition must be there within
+ *  SCENE_MS, not wait on an old phase tick.
+*/
+
+const uint32_t SCENE_AT { 40000 };
+const uint32_t SCENE_MS { 500 };
+
+static uint8_t sceneRun()
+{
+  ADRNV NV;
+  sceneChan_t sc[QTY_CHAN];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.tran( ch )]   = 1;
+    nvs[NV.dly( ch, 0 )] = 1;
+    nvs[NV.dly( ch, 1 )] = 1;
+    nvs[NV.dc( ch, 0 )]  = 20;
+    nvs[NV.dc( ch, 1 )]  = 220;
+    nvs[NV.mode( ch )]   = 0;
+    nvs[NV.gamma( ch )]  = 0;
+    sc[ch] = sceneChan_t { 200, 0, 0 };
+  }
+  nightSw = NIGHTSW_DAY;
+  evCmd = EVAL_NIGHTSW;
+  initChannels();
+  setupChannels();
+  for( simMs = 1; simMs < SCENE_AT; simMs++ )
+  {
+    processChannels();
+  }
+  startScene( sc );
+
+  uint32_t ms { 0 };
+  uint8_t  at { 0 };
+  while( at != QTY_CHAN && ms < SCENE_MS * 100 )
+  {
+    simMs++;
+    ms++;
+    processChannels();
+    at = 0;
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      at += ( var[ch].dcCur == 200 );
+    }
+  }
+  bool ok = ( at == QTY_CHAN && ms <= SCENE_MS );
+  printf( " scene at %u ms, all chans dc 200 in %u ms %s\n", SCENE_AT, ms,
+          ( ok ? "ok" : "FAIL" ) );
+  return ! ok;
+}
+
+
+/*------------------------------- transitRun() --------------------------------
+ *
+ * DAY boot, DAYNIGHT chans go from DC_MID to DC0, then a scene from there.
+ *  DC0 == DC1 chans, the NV difference says nothing of the distance. Each
+ *  transit must end on its target, secTrans * 1000 ms after it starts, in
+ *  one slice per dc of distance, 32 at least. Zero secTrans is 1 ms/slice.
+*/
+
+const uint8_t TRAN_SEC[QTY_CHAN] { 1, 3, 7, 0, 2, 1, 13, 60, 0, 5 };
+const uint8_t TRAN_DC0[QTY_CHAN] { 20, 200, 127, 0, 255, 100, 140, 250, 130, 90 };
+const uint8_t TRAN_DC1[QTY_CHAN] { 220, 200, 127, 0, 0, 100, 140, 250, 10, 90 };
+const sceneChan_t TRAN_SC[QTY_CHAN]
+{
+  { 255, 2, 0 }, { 10, 1, 0 }, { 127, 3, 0 }, { 255, 0, 0 }, { 240, 9, 0 },
+  { 90, 4, 0 }, { 0, 1, 0 }, { 251, 2, 0 }, { 30, 0, 0 }, { 200, 11, 0 }
+};
+
+static uint8_t transitCheck( const char * what, const uint8_t * to,
+                             const uint8_t * sec )
+{
+  uint8_t  from[QTY_CHAN];
+  uint32_t start[QTY_CHAN] { };
+  uint32_t took[QTY_CHAN] { };
+  uint8_t  steps[QTY_CHAN] { };
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    from[ch] = var[ch].dcCur;
+  }
+  for( uint32_t ms = 0; ms < 100000; ms++ )
+  {
+    simMs++;
+    processChannels();
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      if( var[ch].state == STATE_TRANSIT && start[ch] == 0 )
+      {
+        start[ch] = simMs;
+        steps[ch] = var[ch].steps;
+      }
+      if( var[ch].state != STATE_TRANSIT && start[ch] != 0 && took[ch] == 0 )
+      {
+        took[ch] = simMs - start[ch];
+      }
+    }
+  }
+  uint8_t bad { 0 };
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    uint8_t  dist = ( to[ch] > from[ch] ? to[ch] - from[ch] : from[ch] - to[ch] );
+    uint8_t  wantSteps = ( dist < 32 ? 32 : dist );
+    uint32_t wantMs = ( sec[ch] == 0 ? wantSteps : sec[ch] * 1000UL );
+    bool ok = ( var[ch].dcCur == to[ch] && took[ch] == wantMs
+                && steps[ch] == wantSteps );
+    bad += ! ok;
+    if( ! ok )
+    {
+      printf( " %s ch%-2u dc %3u > %3u  at %3u in %6u ms, %3u slices."
+              " want %6u ms, %3u slices FAIL\n", what, ch + 1, from[ch],
+              to[ch], var[ch].dcCur, took[ch], steps[ch], wantMs, wantSteps );
+    }
+  }
+  printf( " %s transits end on dc at secTrans %s\n", what,
+          ( bad == 0 ? "ok" : "FAIL" ) );
+  return bad;
+}
+
+
+static uint8_t transitRun()
+{
+  ADRNV NV;
+  uint8_t dc[QTY_CHAN];
+  uint8_t sec[QTY_CHAN];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.tran( ch )]   = TRAN_SEC[ch];
+    nvs[NV.dly( ch, 0 )] = 0;
+    nvs[NV.dly( ch, 1 )] = 0;
+    nvs[NV.dc( ch, 0 )]  = TRAN_DC0[ch];
+    nvs[NV.dc( ch, 1 )]  = TRAN_DC1[ch];
+    nvs[NV.mode( ch )]   = MODE_DAYNIGHT;
+    nvs[NV.gamma( ch )]  = 0;
+    dc[ch] = TRAN_SC[ch].dc;
+    sec[ch] = TRAN_SC[ch].secTrans;
+  }
+  nightSw = NIGHTSW_DAY;
+  evCmd = EVAL_NIGHTSW;
+  simMs = 0;
+  initChannels();
+  setupChannels();
+  uint8_t bad = transitCheck( "boot ", TRAN_DC0, TRAN_SEC );
+
+  startScene( TRAN_SC );
+  bad += transitCheck( "scene", dc, sec );
+  return bad;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main()
+{
+  uint8_t bad { 0 };
+
+  for( uint8_t g = 0; g < GROUPS; g++ )
+  {
+    bad += run( g );
+  }
+  bad += sceneRun();
+  bad += transitRun();
+  printf( " MODEchk %s\n", ( bad == 0 ? "PASS" : "FAIL" ) );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------MODEchk.cpp EoF ------------------------------*/
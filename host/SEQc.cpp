@@ -0,0 +1,659 @@
+/*file: SEQc.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) compiler for CANlights keyframe programs. See src/SEQ.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Compiles a source file to the SEQ_BYTES image, then checks it on the
+ *  chan engine, src/CHAN.cpp, with the image loaded by src/SEQ.cpp as the
+ *  module does. Each program runs on chan 1, the rest have none...
+ *  - timing. Each op the engine starts, its ms and the dc then, must be as
+ *    the source says. NightSw changes each -p minutes, for the waits.
+ *  - cost. Branches a tick, above the same tick with no program, must be no
+ *    more than a DAYNIGHT transit of chan 1 in the same run.
+ *  - load. The upload frames, put as the Sequence event does, must load the
+ *    image, and a bad byte must not. Nor a good crc on a slice over
+ *    SEQ_MSMAX, or a start inside an op.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -DCHAN_STATS -Isrc host/SEQc.cpp src/SEQ.cpp \
+ *       src/CHAN.cpp -o SEQc
+ *   ./SEQc host/lamps.seq                  check, list and print the image
+ *   ./SEQc host/lamps.seq -u 257 10        plus the CBUS frames to load it
+ *
+ *  -m n   minutes simulated                            (default 60)
+ *  -p n   minutes between NightSw changes              (default 10)
+ *  -u nn en  GridConnect frames, long event nn en, taught EV1 = 23
+ *
+ * Exit 1 if the source has an error or a check fails.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "CHAN.h"
+#include "SEQ.h"
+#include "CRC.h"
+#include "DEFAULTNV.h"
+#include "HALhost.h"
+
+
+const uint16_t SEQ_EE { 1000 };       /* ee[], the image                     */
+
+
+struct op_t                   /* a compiled op, as the source means it       */
+{
+  uint8_t   pc;
+  uint8_t   op;               /* SEQ_RAMP ... SEQ_END, no arg bits           */
+  uint8_t   len;              /* bytes                                       */
+  uint32_t  ms;               /* RAMP & HOLD time                            */
+  uint8_t   dc;               /* RAMP & SET                                  */
+  uint8_t   night;            /* WAIT                                        */
+  uint8_t   count;            /* LOOP, and its body pc                       */
+  uint8_t   body;
+  int       line;
+};
+
+struct evt_t                  /* chan 1 starts the op at pc                  */
+{
+  uint32_t  ms;
+  uint8_t   pc;
+  uint8_t   dc;
+};
+
+static uint8_t img[SEQ_BYTES];
+static std::vector<op_t> ops;
+static int     at[256];               /* ops[] index of pc, or -1            */
+
+
+/*------------------------------- compile() -----------------------------------
+ *
+ * source to img[] and ops[]. Prints each error, returns the error count
+*/
+
+static bool getMs( const char * s, uint32_t & ms )  /* ms, or s with a '.'  */
+{
+  char * end;
+  double v = strtod( s, &end );
+
+  if( end == s || v < 0 || ( *end != '\0' && strcmp( end, "s" ) != 0 ) )
+  {
+    return false;
+  }
+  bool sec = ( strchr( s, '.' ) != NULL || *end == 's' );
+  ms = (uint32_t) ( sec ? v * 1000.0 + 0.5 : v );
+  return true;
+}
+
+
+static uint8_t sliceBits( uint32_t ms )   /* 2^n slices, 1 ms at least    */
+{
+  uint8_t bits = SEQ_SLICEBITS;
+
+  while( bits != 0 && ( ms >> bits ) == 0 )
+  {
+    bits--;
+  }
+  return bits;
+}
+
+
+static uint8_t emit( uint8_t op, uint8_t len, int line ) /* to ops.back() */
+{
+  op_t o {};
+  int  pc = ( ops.empty() ? QTY_SEQ : ops.back().pc + ops.back().len );
+
+  o.pc = ( pc > 0xFF ? 0xFF : pc );           /* too long, compile() says  */
+  o.op = op;
+  o.len = len;
+  o.line = line;
+  ops.push_back( o );
+  return o.pc;
+}
+
+
+static int compile( FILE * in, const char * name )
+{
+  char  text[200];
+  int   line { 0 };
+  int   errs { 0 };
+  int   prog { -1 };
+  int   loopAt { -1 };                        /* body pc, in a loop           */
+  bool  loopTime { false };                   /* body takes time              */
+
+  memset( img, SEQ_END, SEQ_BYTES );
+  memset( img, SEQ_NONE, QTY_SEQ );
+  ops.clear();
+
+  auto err = [&]( const char * msg )
+  {
+    printf( "%s:%d: %s\n", name, line, msg );
+    errs++;
+  };
+  auto loopCount = [&]()                      /* kept in ops[] till next   */
+  {
+    uint8_t count { 0 };
+
+    for( size_t i = ops.size(); i-- != 0; )
+    {
+      if( ops[i].op == 0xFF )
+      {
+        count = ops[i].count;
+        ops.erase( ops.begin() + i );
+        break;
+      }
+    }
+    return count;
+  };
+  auto endProg = [&]()
+  {
+    if( loopAt >= 0 )
+    {
+      err( "loop with no next" );
+      loopCount();
+      loopAt = -1;
+    }
+    if( prog >= 0 && ( ops.empty() || ops.back().op != SEQ_END
+                       || ops.back().pc < img[prog] ) )
+    {
+      emit( SEQ_END, 1, line );
+    }
+  };
+
+  while( fgets( text, sizeof( text ), in ) != NULL )
+  {
+    char * tok[4] {};
+    uint8_t n { 0 };
+
+    line++;
+    text[strcspn( text, "#" )] = '\0';
+    for( char * t = strtok( text, " \t\r\n" ); t != NULL && n < 4;
+         t = strtok( NULL, " \t\r\n" ) )
+    {
+      tok[n++] = t;
+    }
+    if( n == 0 )
+    {
+      continue;
+    }
+    const char * w = tok[0];
+    long   a = ( n > 1 ? strtol( tok[1], NULL, 0 ) : -1 );
+    uint32_t ms { 0 };
+
+    if( strcmp( w, "seq" ) == 0 )
+    {
+      endProg();
+      if( n != 2 || a < 0 || a >= QTY_SEQ || img[a] != SEQ_NONE )
+      {
+        err( "seq N, 0 - 7, once each" );
+        prog = -1;
+        continue;
+      }
+      prog = a;
+      img[prog] = emit( SEQ_END, 0, line );    /* start pc, no op yet      */
+      ops.pop_back();
+      continue;
+    }
+    if( prog < 0 )
+    {
+      err( "not in a seq" );
+      continue;
+    }
+    if( strcmp( w, "ramp" ) == 0 )
+    {
+      if( n != 3 || a < 0 || a > DC_MAX || getMs( tok[2], ms ) == false )
+      {
+        err( "ramp DC T" );
+        continue;
+      }
+      if( ms == 0 )
+      {
+        emit( SEQ_SET, 2, line );
+        ops.back().dc = a;
+        continue;
+      }
+      if( ( ms >> sliceBits( ms ) ) > SEQ_MSMAX )
+      {
+        err( "ramp over 2097 s" );
+        continue;
+      }
+      emit( SEQ_RAMP, SEQ_OPMAX, line );
+      ops.back().ms = ms;
+      ops.back().dc = a;
+      loopTime = true;
+    }
+    else if( strcmp( w, "hold" ) == 0 )
+    {
+      if( n != 2 || getMs( tok[1], ms ) == false )
+      {
+        err( "hold T" );
+        continue;
+      }
+      if( ( ms >> sliceBits( ms ) ) > SEQ_MSMAX )
+      {
+        err( "hold over 2097 s" );
+        continue;
+      }
+      if( ms != 0 )
+      {
+        emit( SEQ_HOLD, SEQ_OPMAX - 1, line );
+        ops.back().ms = ms;
+        loopTime = true;
+      }
+    }
+    else if( strcmp( w, "wait" ) == 0 )
+    {
+      bool night = ( n == 2 && strcmp( tok[1], "night" ) == 0 );
+
+      if( n != 2 || ( night == false && strcmp( tok[1], "day" ) != 0 ) )
+      {
+        err( "wait night|day" );
+        continue;
+      }
+      emit( SEQ_WAIT, 1, line );
+      ops.back().night = night;
+      loopTime = true;
+    }
+    else if( strcmp( w, "loop" ) == 0 )
+    {
+      if( n != 2 || a < 0 || a > 255 || loopAt >= 0 )
+      {
+        err( "loop N, 0 - 255, not nested" );
+        continue;
+      }
+      loopAt = emit( 0xFF, 0, line );         /* body pc, 0 bytes          */
+      ops.back().count = a;                   /* see loopCount()           */
+      loopTime = false;
+    }
+    else if( strcmp( w, "next" ) == 0 )
+    {
+      if( n != 1 || loopAt < 0 )
+      {
+        err( "next with no loop" );
+        continue;
+      }
+      uint8_t count = loopCount();
+
+      if( count == 0 && loopTime == false )
+      {
+        err( "loop 0 with no ramp, hold or wait, it would never end" );
+      }
+      emit( SEQ_LOOP, 3, line );
+      ops.back().count = count;
+      ops.back().body = loopAt;
+      loopAt = -1;
+    }
+    else if( strcmp( w, "end" ) == 0 && n == 1 )
+    {
+      emit( SEQ_END, 1, line );
+    }
+    else
+    {
+      err( "not a keyframe, see src/SEQ.h" );
+    }
+  }
+  endProg();
+
+  for( int & i : at )
+  {
+    i = -1;
+  }
+  for( size_t i = 0; i < ops.size(); i++ )    /* bytes, now pcs are known  */
+  {
+    const op_t & o = ops[i];
+    uint8_t * b = &img[o.pc];
+
+    line = o.line;
+    if( o.pc > SEQ_BYTES - 1 - SEQ_OPMAX )
+    {
+      err( "programs too long, the code is 119 bytes" );
+      break;
+    }
+    at[o.pc] = i;
+    switch( o.op )
+    {
+      case SEQ_RAMP :
+      case SEQ_HOLD :                         /* as a ramp, no dc          */
+      {
+        uint8_t  bits = sliceBits( o.ms );
+        uint16_t slice = o.ms >> bits;
+        uint8_t  * t = &b[o.op == SEQ_RAMP ? 2 : 1];
+
+        b[0] = o.op | bits;
+        b[1] = o.dc;
+        t[0] = slice & 0xFF;
+        t[1] = slice >> 8;
+        t[2] = o.ms - ( (uint32_t) slice << bits );
+        break;
+      }
+      case SEQ_SET :
+        b[0] = SEQ_SET;
+        b[1] = o.dc;
+        break;
+      case SEQ_WAIT :
+        b[0] = SEQ_WAIT | o.night;
+        break;
+      case SEQ_LOOP :
+        b[0] = SEQ_LOOP;
+        b[1] = o.count;
+        b[2] = o.body;
+        break;
+      default :
+        b[0] = SEQ_END;
+    }
+  }
+  img[SEQ_BYTES - 1] = crc8( img, SEQ_BYTES - 1 );
+  return errs;
+}
+
+
+/*------------------------------- model() -------------------------------------
+ *
+ * the pc and dc after each call of program prog, when it changes. From
+ *  ops[], not the bytes. A call starts 1 op. A ramp or hold ends in the
+ *  call that starts the next, an op with no time takes 1 ms. The first call
+ *  is in the tick after the phase starts, and a wait not so goes on in the
+ *  tick after NightSw changes, as any effect nextState() starts.
+*/
+
+static void model( uint8_t prog, uint8_t dc, uint32_t endMs, uint32_t flipMs,
+                   std::vector<evt_t> & v )
+{
+  uint8_t  pc = img[prog];
+  uint8_t  prev = pc;
+  uint8_t  loops { 0 };
+  uint32_t t { 1 };
+
+  auto mark = [&]()
+  {
+    if( pc != prev )
+    {
+      v.push_back( { t, pc, dc } );
+      prev = pc;
+    }
+  };
+
+  while( t <= endMs )
+  {
+    const op_t * o = ( at[pc] >= 0 ? &ops[at[pc]] : NULL );
+
+    if( o == NULL || o->op == SEQ_END )
+    {
+      mark();
+      return;
+    }
+    switch( o->op )
+    {
+      case SEQ_RAMP :
+      case SEQ_HOLD :
+        mark();
+        t += o->ms;
+        dc = ( o->op == SEQ_RAMP ? o->dc : dc );
+        pc += o->len;
+        continue;                             /* next starts in that call  */
+      case SEQ_SET :
+        dc = o->dc;
+        pc += o->len;
+        break;
+      case SEQ_WAIT :
+        if( o->night != ( t / flipMs ) % 2 )  /* DAY first                 */
+        {
+          mark();
+          t = ( t / flipMs + 1 ) * flipMs + 1; /* after the next change    */
+          continue;
+        }
+        pc += o->len;
+        break;
+      case SEQ_LOOP :
+        if( o->count == 0 || ++loops < o->count )
+        {
+          pc = o->body;
+        }
+        else
+        {
+          loops = 0;
+          pc += o->len;
+        }
+        break;
+    }
+    mark();
+    t++;
+  }
+}
+
+
+/*------------------------------- engine() ------------------------------------
+ *
+ * run chan 1 in mode, program prog, the others with none. Image from
+ *  EEPROM by seqLoad(). Branches each tick to br[], the ops chan 1 starts
+ *  to v, if given.
+*/
+
+static void engine( uint8_t mode, uint8_t prog, uint32_t endMs, uint32_t flipMs,
+                    std::vector<uint8_t> & br, std::vector<evt_t> * v )
+{
+  ADRNV NV;
+
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    nvs[nv] = defaultNV( nv );
+  }
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.mode( ch )] = MODE_SEQ;
+    nvs[NV.dly( ch, 0 )] = SEQ_NONE;
+  }
+  nvs[NV.mode( 0 )] = mode;
+  nvs[NV.dly( 0, 0 )] = ( mode == MODE_SEQ ? prog : 1 );
+  nvs[NV.dly( 0, 1 )] = 1;
+  nvs[NV.tran( 0 )] = 5;
+  nvs[NV.dc( 0, 0 )] = DC_MIN;
+  nvs[NV.dc( 0, 1 )] = DC_MAX;
+
+  seqLoad();
+  nightSw = NIGHTSW_DAY;
+  initChannels();
+  setupChannels();
+
+  uint8_t prev = img[prog];
+
+  br.assign( endMs + 1, 0 );
+  for( simMs = 0; simMs <= endMs; simMs++ )
+  {
+    if( simMs != 0 && simMs % flipMs == 0 )
+    {
+      nightSw = (NIGHTSW_t) !nightSw;
+      startNewPhase();
+    }
+    chanStat.touched = 0;
+    chanStat.branches = 0;
+    processChannels();                        /* as Timer1 ISR              */
+    br[simMs] = chanStat.branches;
+    if( v != NULL && chanSeqPc( 0 ) != prev )
+    {
+      prev = chanSeqPc( 0 );
+      v->push_back( { simMs, prev, var[0].dcCur } );
+    }
+  }
+}
+
+
+static int cost( const std::vector<uint8_t> & br, const std::vector<uint8_t> & idle )
+{
+  int most { 0 };
+
+  for( size_t t = 0; t < br.size(); t++ )
+  {
+    most = ( br[t] - idle[t] > most ? br[t] - idle[t] : most );
+  }
+  return most;
+}
+
+
+/*------------------------------- upload() ------------------------------------
+ *
+ * the image as the Sequence event puts it, an ACON3 each 2 bytes, then the
+ *  ACOF that loads it. Frames to out as GridConnect, if given.
+*/
+
+static bool upload( uint16_t nn, uint16_t en, FILE * out )
+{
+  for( uint8_t adr = 0; adr < SEQ_BYTES; adr += 2 )
+  {
+    seqPut( adr, img[adr], img[adr + 1] );
+    if( out != NULL )
+    {
+      fprintf( out, ":SB020NF0%04X%04X%02X%02X%02X;\n", nn, en, adr,
+               img[adr], img[adr + 1] );
+    }
+  }
+  if( out != NULL )
+  {
+    fprintf( out, ":SB020N91%04X%04X;\n", nn, en );
+  }
+  return seqLoad();
+}
+
+
+/*------------------------------- badLoad() -----------------------------------
+ *
+ * seqLoad() of the image with byte adr changed to val, the crc made good.
+ *  Puts the image back after.
+*/
+
+static bool badLoad( uint8_t adr, uint8_t val )
+{
+  uint8_t * e = &ee[SEQ_EE];
+  uint8_t was = e[adr];
+
+  e[adr] = val;
+  e[SEQ_BYTES - 1] = crc8( e, SEQ_BYTES - 1 );
+  bool loads = seqLoad();
+  e[adr] = was;
+  e[SEQ_BYTES - 1] = img[SEQ_BYTES - 1];
+  return loads;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  const char * name { NULL };
+  uint32_t mins { 60 };
+  uint32_t per  { 10 };
+  long     nn { -1 }, en { -1 };
+
+  for( int i = 1; i < argc; i++ )
+  {
+    if( strcmp( argv[i], "-m" ) == 0 && i + 1 < argc )      mins = atoi( argv[++i] );
+    else if( strcmp( argv[i], "-p" ) == 0 && i + 1 < argc ) per  = atoi( argv[++i] );
+    else if( strcmp( argv[i], "-u" ) == 0 && i + 2 < argc )
+    {
+      nn = atol( argv[++i] );
+      en = atol( argv[++i] );
+    }
+    else                                                     name = argv[i];
+  }
+  FILE * in = ( name != NULL ? fopen( name, "r" ) : NULL );
+  if( in == NULL )
+  {
+    printf( " usage: SEQc file.seq [-m min] [-p min] [-u nn en]\n" );
+    return 2;
+  }
+  int errs = compile( in, name );
+  fclose( in );
+  if( errs != 0 )
+  {
+    printf( " %d errors\n", errs );
+    return 1;
+  }
+
+  uint32_t endMs = mins * 60000UL;
+  uint32_t flipMs = ( per != 0 ? per : 1 ) * 60000UL;
+  bool     ok { true };
+  std::vector<uint8_t> idle, br;
+
+  memset( ee, 0xFF, sizeof( ee ) );
+  seqBegin( SEQ_EE );
+  ok &= upload( 0, 0, NULL );                 /* loads & its crc is good    */
+  ee[SEQ_EE + QTY_SEQ] ^= 0x01;
+  ok &= ( seqLoad() == false );               /* a bad byte does not        */
+  ee[SEQ_EE + QTY_SEQ] ^= 0x01;
+  for( const op_t & o : ops )                 /* nor code SEQc would not make */
+  {
+    if( o.op == SEQ_RAMP || o.op == SEQ_HOLD )
+    {
+      ok &= ( badLoad( o.pc + ( o.op == SEQ_RAMP ? 3 : 2 ), 0x80 ) == false );
+      ok &= ( badLoad( 0, o.pc + 1 ) == false );  /* starts inside an op   */
+      break;
+    }
+  }
+  printf( " image %u of %u code bytes, crc 0x%02X, upload %s\n",
+          ops.empty() ? 0 : ops.back().pc + ops.back().len - QTY_SEQ,
+          SEQ_BYTES - 1 - QTY_SEQ, img[SEQ_BYTES - 1], ( ok ? "ok" : "FAIL" ) );
+
+  engine( MODE_SEQ, SEQ_NONE, endMs, flipMs, idle, NULL );
+  engine( MODE_DAYNIGHT, 0, endMs, flipMs, br, NULL );
+  int transit = cost( br, idle );
+
+  printf( " %u min, NightSw each %u min. Branches a tick above idle, transit %d\n",
+          mins, per, transit );
+  for( uint8_t p = 0; p < QTY_SEQ; p++ )
+  {
+    if( img[p] == SEQ_NONE )
+    {
+      continue;
+    }
+    std::vector<evt_t> want, got;
+
+    engine( MODE_SEQ, p, endMs, flipMs, br, &got );
+    model( p, DC_MID, endMs, flipMs, want );
+    int    c = cost( br, idle );
+    size_t i { 0 };
+
+    while( i < want.size() && i < got.size() && want[i].ms == got[i].ms
+           && want[i].pc == got[i].pc && want[i].dc == got[i].dc )
+    {
+      i++;
+    }
+    bool same = ( i == want.size() && i == got.size() );
+
+    printf( "  seq %u  pc %3u  %5u pc changes, timing %s, branches %d %s\n",
+            p, img[p], (unsigned) got.size(), ( same ? "ok" : "FAIL" ), c,
+            ( c <= transit ? "ok" : "FAIL" ) );
+    if( same == false )
+    {
+      const evt_t e0 { 0, 0, 0 };
+      const evt_t & w = ( i < want.size() ? want[i] : e0 );
+      const evt_t & g = ( i < got.size() ? got[i] : e0 );
+
+      printf( "   op %u, source %u ms pc %u dc %u, engine %u ms pc %u dc %u\n",
+              (unsigned) i, w.ms, w.pc, w.dc, g.ms, g.pc, g.dc );
+    }
+    ok &= same && c <= transit;
+  }
+  for( uint8_t r = 0; r < SEQ_BYTES; r += 16 )
+  {
+    printf( "  %3u ", r );
+    for( uint8_t c = 0; c < 16; c++ )
+    {
+      printf( " %02X", img[r + c] );
+    }
+    printf( "\n" );
+  }
+  if( ok == true && nn >= 0 )
+  {
+    upload( nn, en, stdout );
+  }
+  printf( " SEQc %s\n", ( ok ? "PASS" : "FAIL" ) );
+  return ( ok ? 0 : 1 );
+}
+
+/*-------------------------------SEQc.cpp EoF ------------------------------*/
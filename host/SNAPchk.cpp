@@ -0,0 +1,180 @@
+/*file: SNAPchk.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) check of the warm restart snapshot, src/SNAP.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Erased EEPROM must be a cold start. A save must come back as saved, on a
+ *  new boot. Saves go round the slots and the seq wraps. A part write, as
+ *  a rail that dies mid save, must leave the slot before as newest. Settle
+ *  saves must wait SNAP_SETTLEMS, and not save a moving chan again and again.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/SNAPchk.cpp src/SNAP.cpp \
+ *       src/CHAN.cpp src/LOG.cpp -o SNAPchk
+ *   ./SNAPchk                  exit 1 if any check fails
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "SNAP.h"
+#include "LOG.h"
+#define HOST_EEWRITE
+#include "HALhost.h"
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+static uint16_t writes { 0 };         /* EEPROM writes since reset           */
+static uint16_t writeLimit { 0xFFFF }; /* writes before the rail dies        */
+
+void    halWriteEE( uint16_t adr, uint8_t val )
+{
+  if( writes++ < writeLimit )
+  {
+    ee[adr] = val;
+  }
+}
+
+
+const uint16_t EE_SNAP { 600 };       /* any free EEPROM address             */
+
+static uint8_t bad { 0 };
+
+
+static void check( const char * what, bool ok )
+{
+  printf( " %-44s %s\n", what, ( ok ? "ok" : "FAIL" ) );
+  bad += ! ok;
+}
+
+
+static void setChans( uint8_t base )  /* steady chans, dc base + ch          */
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    var[ch].dcCur = base + ch;
+    var[ch].phase = ch & 1;
+    var[ch].state = STATE_STEADY;
+  }
+}
+
+
+static bool chansAre( uint8_t base )
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( var[ch].dcCur != base + ch || var[ch].phase != ( ch & 1 )
+        || var[ch].state != STATE_STEADY )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+static bool boot()                    /* power on, as setup()                */
+{
+  initChannels();
+  nightSw = NIGHTSW_DAY;
+  snapBegin( EE_SNAP );
+  return snapRestore();
+}
+
+
+static uint16_t saves()               /* LOG_SNAP records in the log         */
+{
+  logRec_t rec;
+  uint16_t n { 0 };
+
+  while( logPop( rec ) == true )
+  {
+    n += ( rec.id == LOG_SNAP );
+  }
+  return n;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main()
+{
+  memset( ee, 0xFF, sizeof( ee ) );
+  check( "erased EEPROM is a cold start", boot() == false );
+
+  setChans( 10 );
+  nightSw = NIGHTSW_NIGHT;
+  snapSave();
+  setChans( 99 );
+  bool warm = boot();
+  check( "save, then boot restores dc, phase, NightSw",
+         warm && chansAre( 10 ) && nightSw == NIGHTSW_NIGHT );
+
+  for( uint16_t i = 0; i < 300; i++ )  /* round the slots, seq wraps        */
+  {
+    setChans( i & 0x7F );
+    snapSave();
+  }
+  uint8_t lastSeq = snapSeq();
+  warm = boot();
+  check( "300 saves, newest after seq wrap", warm && chansAre( 299 & 0x7F )
+         && snapSeq() == lastSeq );
+
+  setChans( 50 );
+  writes = 0;
+  writeLimit = SNAP_BYTES / 2;          /* rail dies half way through       */
+  snapSave();
+  writeLimit = 0xFFFF;
+  warm = boot();
+  check( "part write, slot before is newest",
+         warm && chansAre( 299 & 0x7F ) && snapSeq() == lastSeq );
+
+  setChans( 60 );
+  writes = 0;
+  writeLimit = SNAP_BYTES;              /* all but the CRC                  */
+  snapSave();
+  writeLimit = 0xFFFF;
+  warm = boot();
+  check( "CRC not written, slot before is newest",
+         warm && chansAre( 299 & 0x7F ) && snapSeq() == lastSeq );
+
+  /* settle saves, 1 ms steps of snapCheck() as loop() */
+  saves();
+  simMs = 100000;
+  setChans( 70 );
+  uint16_t n { 0 };
+  for( uint16_t i = 0; i < SNAP_SETTLEMS - SNAP_CHECKMS; i++ )
+  {
+    simMs++;
+    snapCheck();
+  }
+  n = saves();
+  for( uint16_t i = 0; i < 3 * SNAP_CHECKMS; i++ )
+  {
+    simMs++;
+    snapCheck();
+  }
+  check( "settle save waits, then 1 save", n == 0 && saves() == 1 );
+
+  var[2].state = STATE_EFFECT;          /* a moving chan, dc keeps changing */
+  for( uint16_t i = 0; i < 60000; i++ )
+  {
+    var[2].dcCur = i;
+    simMs++;
+    snapCheck();
+  }
+  check( "moving chan, 1 save in 60 s", saves() == 1 );
+
+  printf( " SNAPchk %s, %u slots of %u bytes\n",
+          ( bad == 0 ? "PASS" : "FAIL" ), SNAP_SLOTS, SNAP_BYTES );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------SNAPchk.cpp EoF ------------------------------*/
@@ -0,0 +1,86 @@
+/*file: SYNCnode.h
+ *----------------------------------------------------------------------------
+ *
+ * One simulated node for host/SYNCsim.cpp. Include it inside a namespace, it
+ *  builds a private copy of the channel engine and sync, src/CHAN.cpp and
+ *  src/SYNC.cpp, and gives them to the simulator as a nodeApi_t.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The engine headers are taken again in each namespace, so each node has
+ *  its own types, tables and data. HAL.h and LOG.h stay global, the HAL
+ *  picks the node by simNode, see SYNCsim.cpp. No include guard, on purpose.
+*/
+#undef CHAN_H__
+#undef GAMMA_H__
+#undef EASE_H__
+#undef MODE_H__
+#undef EFFECT_H__
+#undef SEQ_H__
+#undef SYNC_H__
+
+#include "CHAN.cpp"
+#include "SYNC.cpp"
+
+
+static void boot( bool master )       /* as setup()                          */
+{
+  nightSw = NIGHTSW_DAY;
+  syncBegin( 0 );
+  if( master == true )
+  {
+    syncSetMaster( true );
+  }
+  initChannels();
+  setupChannels();
+}
+
+
+static void tick( bool sync )          /* the 1 ms ISR, as foreground()      */
+{
+  for( uint8_t n = ( sync ? syncTicks() : 1 ); n != 0; n-- )
+  {
+    processChannels();
+  }
+}
+
+
+static void night( bool on, bool sync ) /* NightSw event, as taskPhase()     */
+{
+  nightSw = (NIGHTSW_t) on;
+  if( sync == true )
+  {
+    syncPhase();
+  }
+  else
+  {
+    startNewPhase();
+  }
+}
+
+
+static bool poll( bool & start, uint16_t & tick )  /* loop() pass, tx frame  */
+{
+  syncRun();
+  return syncTx( start, tick );
+}
+
+
+static uint8_t dcOf( uint8_t ch )
+{
+  return var[ch].dcCur;
+}
+
+
+static uint8_t state()
+{
+  return syncState();
+}
+
+
+const nodeApi_t api { boot, tick, night, syncRx, poll, dcOf, syncPPM, state };
+
+
+/*-------------------------------SYNCnode.h EoF ------------------------------*/
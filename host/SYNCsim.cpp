@@ -0,0 +1,354 @@
+/*file: SYNCsim.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) simulator of several CANlights nodes on one CBUS, src/SYNC.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * 2 layouts of 4 nodes each, the same but for sync. Layout A node 1 is the
+ *  sync master, the others teach its sync event. Layout B has no sync.
+ *  Each node has its own copy of the engine, see SYNCnode.h, its own crystal
+ *  error, boot time and loop() timing. Node n of A and node n of B are
+ *  alike. All chans are DAYNIGHT, 255 s transitions, DC 20 to 200.
+ *
+ * A layout controller sends a NightSw event each -p minutes. It reaches
+ *  each node up to -a ms apart, as through CAN bridges, and is seen at the
+ *  node's next loop() pass. Frames between nodes take 100 us to -j us on
+ *  the bus, then wait for a loop() pass, 0.3 to 1.5 ms, 1 in 50 is 6 ms.
+ *
+ * Skew is the real time between node 1 and each other node making the same
+ *  chan 1 dc step. Exit 1 if layout A skew is over -b ms.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/SYNCsim.cpp src/LOG.cpp -o SYNCsim
+ *   ./SYNCsim -h 1
+ *
+ *  -h n   simulated hours                              (default 1)
+ *  -p n   minutes between NightSw changes              (default 10)
+ *  -a n   NightSw arrival spread, ms                   (default 20)
+ *  -j n   bus jitter, us                               (default 2000)
+ *  -b n   skew bound, ms, layout A                     (default 5)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "CHAN.h"              /* QTY_NV, ADRNV. Each node takes its own too  */
+#include "LOG.h"
+#include "DEFAULTNV.h"
+#define HOST_EE                       /* each node its own, see host HAL     */
+#define HOST_CLOCK
+#include "HALhost.h"
+
+
+struct nodeApi_t                      /* a node, see SYNCnode.h              */
+{
+  void    ( * boot )( bool master );
+  void    ( * tick )( bool sync );
+  void    ( * night )( bool on, bool sync );
+  void    ( * rx )( bool start, uint16_t tick );
+  bool    ( * poll )( bool & start, uint16_t & tick );
+  uint8_t ( * dc )( uint8_t ch );
+  int16_t ( * ppm )();
+  uint8_t ( * state )();
+};
+
+namespace a1 {
+#include "SYNCnode.h"
+}
+namespace a2 {
+#include "SYNCnode.h"
+}
+namespace a3 {
+#include "SYNCnode.h"
+}
+namespace a4 {
+#include "SYNCnode.h"
+}
+namespace b1 {
+#include "SYNCnode.h"
+}
+namespace b2 {
+#include "SYNCnode.h"
+}
+namespace b3 {
+#include "SYNCnode.h"
+}
+namespace b4 {
+#include "SYNCnode.h"
+}
+
+
+const uint8_t QTY_NODE { 8 };          /* 0-3 layout A, 4-7 layout B          */
+const uint8_t PER_LAYOUT { 4 };
+
+const double PPM[PER_LAYOUT]  { 0.0, 80.0, -120.0, 200.0 };  /* crystal     */
+const double BOOTMS[PER_LAYOUT] { 0.0, 130.0, 370.0, 55.0 };  /* power on    */
+
+
+struct frame_t
+{
+  double   at;                        /* real us, delivered to loop() after  */
+  bool     night;                     /* NightSw event, else sync frame      */
+  bool     start;                     /* ACOF2 start, or NightSw On          */
+  uint16_t tick;
+};
+
+struct node_t
+{
+  const nodeApi_t * api;
+  bool     sync;
+  double   usTick;                    /* real us per ms tick, crystal        */
+  double   nextTick;
+  double   nextLoop;
+  uint32_t ms;                        /* halMillis()                         */
+  uint8_t  ee[4];
+  std::vector<frame_t> rx;
+  uint8_t  dcWas;
+  std::vector<double>  step;          /* real us of each chan 1 dc step      */
+};
+
+static node_t  node[QTY_NODE];
+static uint8_t simNode;               /* node the HAL is for                 */
+
+
+/*------------------------------- host HAL ------------------------------------
+*/
+
+uint8_t halReadEE( uint16_t adr )      { return node[simNode].ee[adr & 3]; }
+void    halWriteEE( uint16_t adr, uint8_t val ) { node[simNode].ee[adr & 3] = val; }
+uint32_t halMillis()                   { return node[simNode].ms; }
+uint32_t halMicros()                   { return node[simNode].ms * 1000UL; }
+
+
+static uint32_t lcg { 2021 };
+
+static double rnd( double lo, double hi )
+{
+  lcg = lcg * 1103515245UL + 12345;
+  return lo + ( hi - lo ) * ( ( lcg >> 8 ) & 0xFFFF ) / 65536.0;
+}
+
+
+static void send( uint8_t from, const frame_t & f, double jitUs )
+{
+  uint8_t first = ( from < PER_LAYOUT ? 0 : PER_LAYOUT );
+
+  for( uint8_t n = first; n < first + PER_LAYOUT; n++ )
+  {
+    if( n != from && node[n].ms != 0 )  /* not to a node still to boot   */
+    {
+      frame_t g = f;
+      g.at += rnd( 100.0, jitUs );
+      node[n].rx.push_back( g );
+    }
+  }
+}
+
+
+static void loopPass( uint8_t n, double now, double jitUs )
+{
+  node_t & d = node[n];
+
+  for( size_t i = 0; i < d.rx.size(); )
+  {
+    if( d.rx[i].at > now )
+    {
+      i++;
+      continue;
+    }
+    frame_t f = d.rx[i];
+    d.rx.erase( d.rx.begin() + i );
+    if( f.night == true )
+    {
+      d.api->night( f.start, d.sync );
+    }
+    else if( d.sync == true )
+    {
+      d.api->rx( f.start, f.tick );
+    }
+  }
+  frame_t f { now, false, false, 0 };
+
+  if( d.sync == true && d.api->poll( f.start, f.tick ) == true )
+  {
+    send( n, f, jitUs );
+  }
+  logRec_t rec;
+  while( logPop( rec ) == true )      /* sync steps & late starts            */
+  {
+    if( rec.id == LOG_SYNCSTEP || rec.id == LOG_SYNCLATE )
+    {
+      char line[LOG_LINE];
+      logFormat( rec, line, LOG_LINE );
+      printf( "  node %u %s\n", n + 1, line );
+    }
+  }
+  d.nextLoop = now + ( rnd( 0.0, 50.0 ) < 1.0 ? 6000.0 : rnd( 300.0, 1500.0 ) );
+}
+
+
+static double skew( uint8_t first, bool & same )
+{
+  double worst { 0.0 };
+  const node_t & m = node[first];
+
+  same = true;
+  for( uint8_t n = first + 1; n < first + PER_LAYOUT; n++ )
+  {
+    const node_t & d = node[n];
+
+    same &= ( d.step.size() == m.step.size() );
+    for( size_t i = 0; i < d.step.size() && i < m.step.size(); i++ )
+    {
+      worst = fmax( worst, fabs( d.step[i] - m.step[i] ) );
+    }
+  }
+  return worst / 1000.0;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  const nodeApi_t * const API[QTY_NODE]
+    { &a1::api, &a2::api, &a3::api, &a4::api,
+      &b1::api, &b2::api, &b3::api, &b4::api };
+  ADRNV NV;
+  double hours { 1.0 }, perMin { 10.0 }, spreadMs { 20.0 }, jitUs { 2000.0 };
+  double bound { 5.0 };
+
+  for( int i = 1; i + 1 < argc; i += 2 )
+  {
+    double v = atof( argv[i + 1] );
+
+    switch( argv[i][1] )
+    {
+      case 'h' : hours = v;    break;
+      case 'p' : perMin = v;   break;
+      case 'a' : spreadMs = v; break;
+      case 'j' : jitUs = v;    break;
+      case 'b' : bound = v;    break;
+    }
+  }
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    nvs[NV.dc( ch, 0 )]  = 20;
+    nvs[NV.dc( ch, 1 )]  = 200;
+    nvs[NV.tran( ch )]   = 255;
+    nvs[NV.mode( ch )]   = 0;            /* MODE_DAYNIGHT, linear             */
+  }
+  for( uint8_t n = 0; n < QTY_NODE; n++ )
+  {
+    node_t & d = node[n];
+    uint8_t k = n % PER_LAYOUT;
+
+    d.api = API[n];
+    d.sync = ( n < PER_LAYOUT );
+    d.usTick = 1000.0 * ( 1.0 - PPM[k] * 1e-6 );
+    d.nextTick = BOOTMS[k] * 1000.0;
+    d.nextLoop = d.nextTick + 1.0;
+    for( uint8_t i = 0; i < 4; i++ )
+    {
+      d.ee[i] = 0xFF;
+    }
+    simNode = n;
+    d.api->boot( d.sync && k == 0 );
+    d.dcWas = d.api->dc( 0 );
+  }
+
+  double end = hours * 3600e6;
+  double nextNight = perMin * 60e6;
+  bool   on { false };
+
+  for( ;; )
+  {
+    double now = nextNight;
+    uint8_t who = QTY_NODE;           /* QTY_NODE = controller               */
+    bool isTick { false };
+
+    for( uint8_t n = 0; n < QTY_NODE; n++ )
+    {
+      if( node[n].nextTick < now )
+      {
+        now = node[n].nextTick;
+        who = n;
+        isTick = true;
+      }
+      if( node[n].nextLoop < now )
+      {
+        now = node[n].nextLoop;
+        who = n;
+        isTick = false;
+      }
+    }
+    if( now > end )
+    {
+      break;
+    }
+    if( who == QTY_NODE )             /* NightSw event from the controller   */
+    {
+      on = ! on;
+      for( uint8_t k = 0; k < PER_LAYOUT; k++ )
+      {
+        frame_t f { now + rnd( 100.0, jitUs ) + rnd( 0.0, spreadMs * 1000.0 ),
+                    true, on, 0 };
+        node[k].rx.push_back( f );            /* same arrival, A and B   */
+        node[k + PER_LAYOUT].rx.push_back( f );
+      }
+      nextNight += perMin * 60e6;
+      continue;
+    }
+    node_t & d = node[who];
+
+    simNode = who;
+    if( isTick == true )
+    {
+      d.ms++;
+      d.api->tick( d.sync );
+      d.nextTick += d.usTick;
+      uint8_t dc = d.api->dc( 0 );
+      if( dc != d.dcWas && now > perMin * 60e6 )  /* after 1st NightSw      */
+      {
+        d.step.push_back( now );
+      }
+      d.dcWas = dc;
+    }
+    else
+    {
+      loopPass( who, now, jitUs );
+    }
+  }
+
+  bool sameA, sameB;
+  double skewA = skew( 0, sameA );
+  double skewB = skew( PER_LAYOUT, sameB );
+
+  printf( " %.1f h, NightSw each %.0f min, arrival spread %.0f ms, bus jitter"
+          " %.0f us\n", hours, perMin, spreadMs, jitUs );
+  for( uint8_t k = 0; k < PER_LAYOUT; k++ )
+  {
+    simNode = k;
+    printf( "  node %u  crystal %+5.0f ppm  sync %s  trim %+4d ppm  steps %zu\n",
+            k + 1, PPM[k], ( k == 0 ? "master" : node[k].api->state() == 1
+            ? "locked" : "NONE  " ), node[k].api->ppm(), node[k].step.size() );
+  }
+  printf( " layout A, sync     max skew %7.2f ms%s\n", skewA,
+          ( sameA ? "" : ", step counts differ!" ) );
+  printf( " layout B, no sync  max skew %7.2f ms%s\n", skewB,
+          ( sameB ? "" : ", step counts differ!" ) );
+
+  bool ok = ( sameA == true && skewA <= bound && node[0].step.size() > 0 );
+  printf( " SYNCsim %s, bound %.1f ms\n", ( ok ? "PASS" : "FAIL" ), bound );
+  return ( ok ? 0 : 1 );
+}
+
+/*-------------------------------SYNCsim.cpp EoF ------------------------------*/
@@ -0,0 +1,211 @@
+/*file: TASKchk.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) check of the loop() task scheduler, src/TASK.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The clock is simulated, each task moves it on by its run time. The tasks
+ *  are as setupTasks() adds them, with a slow Keys task. Checks...
+ *   - CBUS runs first each pass, then only 1 timed task.
+ *   - each timed task runs at its period, a slow task does not hold CBUS
+ *     up by more than its own run.
+ *   - run time mean & max, deadline misses and late are counted.
+ *   - a stall drops the late releases, no burst after.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/TASKchk.cpp src/TASK.cpp -o TASKchk
+ *   ./TASKchk                  exit 1 if any check fails
+*/
+#include <stdio.h>
+
+#include "TASK.h"
+#define HOST_CLOCK                    /* us clock, each task moves it on     */
+#include "HALhost.h"
+
+
+static uint32_t simUs { 0 };
+
+uint32_t halMillis()                   { return simUs / 1000; }
+uint32_t halMicros()                   { return simUs; }
+
+
+const uint8_t QTY_T { 7 };
+
+static uint32_t runs[QTY_T];
+static uint32_t cost[QTY_T] { 150, 10, 200, 50, 300, 5000, 20 };  /* us      */
+static char     order[64];            /* task letters this pass              */
+static uint8_t  orderLen;
+static uint32_t cbusWas;              /* simUs at last CBUS run              */
+static uint32_t cbusGap;              /* worst gap between CBUS runs         */
+
+static void work( uint8_t t )
+{
+  runs[t]++;
+  simUs += cost[t];
+  if( orderLen < sizeof( order ) - 1 )
+  {
+    order[orderLen++] = 'A' + t;
+  }
+}
+
+static void tCBUS()
+{
+  if( runs[0] != 0 && simUs - cbusWas > cbusGap )
+  {
+    cbusGap = simUs - cbusWas;
+  }
+  work( 0 );
+  cbusWas = simUs;
+}
+static void tPhase() { work( 1 ); }
+static void tPower() { work( 2 ); }
+static void tDiag()  { work( 3 ); }
+static void tLog()   { work( 4 ); }
+static void tKeys()  { work( 5 ); }
+static void tTicks() { work( 6 ); }
+static void tNone()  { }
+
+
+static uint8_t bad { 0 };
+
+static void check( const char * what, bool ok )
+{
+  printf( " %-48s %s\n", what, ( ok ? "ok" : "FAIL" ) );
+  bad += ! ok;
+}
+
+
+static void pass()                    /* 1 loop() pass                       */
+{
+  orderLen = 0;
+  taskRun();
+  order[orderLen] = 0;
+  simUs += 20;                        /* loop() overhead                     */
+}
+
+
+static bool find( const char * name, taskStat_t & s )
+{
+  for( uint8_t t = 0; t < taskQty(); t++ )
+  {
+    taskGet( t, s );
+    if( s.name == name )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main()
+{
+  const char * const NAME[QTY_T] { "CBUS", "Phase", "Power", "Diag", "Log",
+                                   "Keys", "Ticks" };
+
+  /* added out of priority order, the table sorts them */
+  taskAdd( NAME[6], tTicks, 1000,       50000, 6 );
+  taskAdd( NAME[2], tPower, 1,          1000,  2 );
+  taskAdd( NAME[0], tCBUS,  TASK_EVERY, 2000,  0 );
+  taskAdd( NAME[3], tDiag,  5,          5000,  3 );
+  taskAdd( NAME[5], tKeys,  20,         4000,  5 );
+  taskAdd( NAME[1], tPhase, TASK_EVERY, 500,   1 );
+  taskAdd( NAME[4], tLog,   2,          2000,  4 );
+  check( "table full at TASK_MAX",
+         taskAdd( "x", tNone, 60000, 1, 9 ) == true
+         && taskAdd( "y", tNone, 60000, 1, 9 ) == false );
+
+  bool sorted { true };
+  for( uint8_t t = 0; t + 1 < taskQty(); t++ )
+  {
+    taskStat_t a, b;
+    taskGet( t, a );
+    taskGet( t + 1, b );
+    sorted &= ( a.prio <= b.prio );
+  }
+  check( "table in priority order", sorted );
+
+  pass();                             /* all due at once                     */
+  check( "first pass CBUS, Phase, then Power only",
+         order[0] == 'A' && order[1] == 'B' && order[2] == 'C'
+         && orderLen == 3 );
+  pass();
+  check( "second pass CBUS, Phase, then next due (Diag)",
+         order[0] == 'A' && order[1] == 'B' && order[2] == 'D'
+         && orderLen == 3 );
+
+  for( uint8_t t = 0; t < QTY_T; t++ )
+  {
+    runs[t] = 0;
+  }
+  cbusGap = 0;
+  taskReset();
+  uint32_t start = simUs;
+  while( simUs - start < 10000000UL )  /* 10 s                               */
+  {
+    pass();
+  }
+  printf( " 10 s, %u passes, worst CBUS gap %u us\n", runs[0], cbusGap );
+  for( uint8_t t = 0; t < QTY_T; t++ )
+  {
+    taskStat_t s;
+    find( NAME[t], s );
+    unsigned mean = ( s.runs == 0 ? 0 : s.sumUs / s.runs );
+
+    printf( "  %-6s runs %6u  mean %5u  max %5u  late %5u  miss %5u\n",
+            s.name, s.runs, mean, s.maxUs, s.lateUs, s.misses );
+  }
+  /* each Keys run drops the releases due while it ran */
+  uint32_t keysMs = 500 * ( cost[5] / 1000 );
+  check( "Power each ms, less Keys runs", runs[2] >= 10000 - keysMs
+         && runs[2] <= 10001 );
+  check( "Log each 2 ms, Diag each 5 ms",
+         runs[4] >= 5000 - keysMs / 2 && runs[4] <= 5001
+         && runs[3] >= 2000 - keysMs / 5 && runs[3] <= 2001 );
+  check( "Keys each 20 ms, Ticks each s",
+         runs[5] >= 499 && runs[5] <= 501 && runs[6] >= 9 && runs[6] <= 11 );
+  check( "CBUS gap no more than 1 timed task", cbusGap <= cost[5] + 200 );
+
+  taskStat_t s;
+  find( NAME[5], s );
+  check( "Keys max & mean run time", s.maxUs == cost[5]
+         && s.sumUs / s.runs == cost[5] );
+  check( "Keys over its 4 ms deadline each run",
+         s.misses == s.runs );
+  find( NAME[0], s );
+  check( "CBUS in deadline", s.misses == 0 && s.maxUs == cost[0] );
+  find( NAME[2], s );
+  check( "Power late by a Keys run, misses counted",
+         s.lateUs >= cost[5] && s.misses > 0 && s.misses < s.runs / 10 );
+
+  /* a 30 ms stall, eg. a snapshot save. Power must not run in a burst */
+  taskReset();
+  pass();
+  simUs += 30000;
+  uint32_t was = runs[2];
+  start = simUs;
+  while( simUs - start < 10000 )
+  {
+    pass();
+  }
+  check( "stall, late releases dropped", runs[2] - was <= 11 );
+  find( NAME[2], s );
+  check( "stall seen as late & a miss", s.lateUs >= 30000 && s.misses >= 1 );
+
+  taskReset();
+  find( NAME[2], s );
+  check( "reset clears stats, keeps task", s.runs == 0 && s.maxUs == 0
+         && s.periodMs == 1 );
+
+  printf( " TASKchk %s\n", ( bad == 0 ? "PASS" : "FAIL" ) );
+  return ( bad == 0 ? 0 : 1 );
+}
+
+/*-------------------------------TASKchk.cpp EoF ------------------------------*/
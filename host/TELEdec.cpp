@@ -0,0 +1,316 @@
+/*file: TELEdec.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Host (PC) decoder for CANlights binary telemetry. See src/TELE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Serial Monitor 'R' 1 - 9 starts the stream. Capture the serial port to a
+ *  file, then decode it to CSV, a row a record, to plot. Log lines and
+ *  binary log records in between are skipped. Build with the module's
+ *  CHANS, a key of another chan count is skipped.
+ *
+ * Build and run, from the repo folder...
+ *
+ *   g++ -std=gnu++11 -O2 -Wall -Isrc host/TELEdec.cpp src/TELE.cpp src/CHAN.cpp -o TELEdec
+ *   ./TELEdec capture.bin > tele.csv   (or stdin, if no file)
+ *   ./TELEdec -s               self check, exit 1 if it fails
+ *
+ * Self check runs the chan engine through NightSw fades with the factory
+ *  NVs, streams at 100 Hz into a 115200 baud Serial, with log text in
+ *  between, and corrupts a frame. Every record must come back the same,
+ *  less those from the bad frame to the next key.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "TELE.h"
+#include "CRC.h"
+#include "DEFAULTNV.h"
+#include "HALhost.h"
+
+
+struct teleDec_t
+{
+  bool      synced;           /* a key since the last gap, deltas apply      */
+  uint8_t   seq;              /* of the last frame                           */
+  teleRec_t rec;              /* as the module last sent                     */
+  uint32_t  bad;              /* crc failed, or TELE_SYNC in other bytes     */
+  uint32_t  gaps;             /* frames lost, waited for a key               */
+};
+
+
+static uint8_t bits( const uint8_t * mask )
+{
+  uint8_t n { 0 };
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    n += ( mask[ch / 8] >> ( ch % 8 ) ) & 1;
+  }
+  return n;
+}
+
+
+/*------------------------------- teleDecode() --------------------------------
+ *
+ * parse 1 frame from buf into d.rec. Returns bytes used, 0 if more bytes
+ *  needed. Bytes that do not start a good frame are skipped, 1 at a time.
+ *  ok is true when d.rec is a new record.
+*/
+
+static size_t teleDecode( const uint8_t * buf, size_t len, teleDec_t & d,
+                          bool & ok )
+{
+  ok = false;
+  if( buf[0] != TELE_SYNC )
+  {
+    return 1;
+  }
+  if( len < 2 )
+  {
+    return 0;
+  }
+  uint8_t n = buf[1];                 /* type, seq & body                    */
+
+  if( n < 2 || n + 3 > TELE_MAX )
+  {
+    return 1;
+  }
+  if( len < n + 3U )
+  {
+    return 0;
+  }
+  if( crc8( &buf[1], n + 1 ) != buf[n + 2] )
+  {
+    d.bad++;
+    return 1;                         /* not a frame, resync                 */
+  }
+  const uint8_t * b = &buf[4];
+  bool inSeq = ( d.synced == true && buf[3] == (uint8_t) ( d.seq + 1 ) );
+
+  if( d.synced == true && inSeq == false )
+  {
+    d.gaps++;
+  }
+  d.synced = false;
+  d.seq = buf[3];
+  if( buf[2] == TELE_KEY && n == 9 + QTY_CHAN + TELE_SPB && b[6] == QTY_CHAN )
+  {
+    d.rec.ms = b[0] | ( b[1] << 8 ) | ( b[2] << 16 ) | ( (uint32_t) b[3] << 24 );
+    d.rec.mA = b[4] | ( b[5] << 8 );
+    memcpy( d.rec.dc, &b[7], QTY_CHAN );
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      d.rec.sp[ch] = ( b[7 + QTY_CHAN + ch / 2] >> ( ch & 1 ? 4 : 0 ) ) & 0x0F;
+    }
+    d.synced = true;
+  }
+  if( buf[2] == TELE_DELTA && inSeq == true )
+  {
+    const uint8_t * dcMask = &b[3];
+    const uint8_t * spMask = dcMask + TELE_MASK;
+    const uint8_t * dc = spMask + TELE_MASK;
+    const uint8_t * sp = dc + bits( dcMask );
+    uint8_t spQty = bits( spMask );
+
+    if( n != 5 + 2 * TELE_MASK + bits( dcMask ) + ( spQty + 1 ) / 2 )
+    {
+      return n + 3;                   /* good crc, bad frame, wait for a key */
+    }
+    d.rec.ms += b[0] | ( b[1] << 8 );
+    d.rec.mA += (int8_t) b[2];
+    for( uint8_t ch = 0, i = 0; ch < QTY_CHAN; ch++ )
+    {
+      if( ( dcMask[ch / 8] >> ( ch % 8 ) ) & 1 )
+      {
+        d.rec.dc[ch] += *dc++;         /* mod 256                            */
+      }
+      if( ( spMask[ch / 8] >> ( ch % 8 ) ) & 1 )
+      {
+        d.rec.sp[ch] = ( sp[i / 2] >> ( i & 1 ? 4 : 0 ) ) & 0x0F;
+        i++;
+      }
+    }
+    d.synced = true;
+  }
+  ok = d.synced;
+  return n + 3;
+}
+
+
+static void csvHead( FILE * out )
+{
+  fprintf( out, "ms,mA" );
+  for( uint8_t ch = 1; ch <= QTY_CHAN; ch++ )
+  {
+    fprintf( out, ",ch%u_dc,ch%u_state,ch%u_phase", ch, ch, ch );
+  }
+  fprintf( out, "\n" );
+}
+
+
+static void csvRow( FILE * out, const teleRec_t & rec )
+{
+  fprintf( out, "%u,%u", rec.ms, rec.mA );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    fprintf( out, ",%u,%u,%u", rec.dc[ch], rec.sp[ch] & 0x03, rec.sp[ch] >> 2 );
+  }
+  fprintf( out, "\n" );
+}
+
+
+/*------------------------------- selfCheck() ---------------------------------
+*/
+
+static int selfCheck()
+{
+  const uint32_t END_MS { 40000 };
+  const uint32_t BAD_AT { 17000 };           /* corrupt the frame from here  */
+  const double   BYTEMS { 11.52 };           /* 115200 baud, bytes a ms      */
+  const size_t   QTY_REC { END_MS / 10 + 1 };
+  static teleRec_t want[QTY_REC];
+  static uint8_t   cap[QTY_REC * TELE_MAX + END_MS / 1000 * 64];
+  size_t   capLen { 0 };
+  size_t   qty { 0 };
+  size_t   badRec { 0 };                     /* first record lost            */
+  size_t   keyAfter { 0 };                   /* next key after it            */
+  double   serialFree { 0 };
+  uint32_t keys { 0 };
+
+  for( uint8_t nv = 1; nv <= QTY_NV; nv++ )
+  {
+    nvs[nv] = defaultNV( nv );
+  }
+  nightSw = NIGHTSW_DAY;
+  initChannels();
+  setupChannels();
+  teleRate( QTY_TELERATE - 1 );
+  for( simMs = 0; simMs <= END_MS; simMs++ )
+  {
+    if( simMs % 10000 == 5000 )              /* NightSw each 10 s            */
+    {
+      nightSw = (NIGHTSW_t) !nightSw;
+      startNewPhase();
+    }
+    processChannels();                       /* as Timer1 ISR                */
+    if( simMs % 1000 == 500 )                /* a log line, 'Z' is TELE_SYNC */
+    {
+      int n = sprintf( (char *) &cap[capLen], "Zz %u log line\r\n", simMs );
+      capLen += n;
+      serialFree = simMs + n / BYTEMS;
+    }
+    if( simMs >= serialFree && teleDue() == true )     /* as taskLog()   */
+    {
+      teleRec_t & rec = want[qty];
+      uint16_t    mA { 0 };
+
+      for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+      {
+        mA += var[ch].dcCur * 3;
+      }
+      teleSample( rec, mA );
+      uint8_t n = teleEncode( rec, &cap[capLen] );
+      if( cap[capLen + 2] == TELE_KEY )
+      {
+        keys++;
+        keyAfter = ( badRec != 0 && keyAfter == 0 ? qty : keyAfter );
+      }
+      if( badRec == 0 && simMs >= BAD_AT && cap[capLen + 2] == TELE_DELTA )
+      {
+        badRec = qty;
+        cap[capLen + 5] ^= 0x10;             /* a bit error                  */
+      }
+      capLen += n;
+      serialFree = simMs + n / BYTEMS;
+      qty++;
+    }
+  }
+
+  teleDec_t d {};
+  size_t    got { 0 };
+  size_t    w { 0 };
+  bool      same { true };
+  for( size_t p = 0; p < capLen; )
+  {
+    bool   ok;
+    size_t n = teleDecode( &cap[p], capLen - p, d, ok );
+    if( n == 0 )
+    {
+      break;
+    }
+    p += n;
+    if( ok == true )
+    {
+      w = ( w == badRec ? keyAfter : w );    /* lost, bad frame to a key     */
+      same = same && w < qty && d.rec.ms == want[w].ms && d.rec.mA == want[w].mA
+             && memcmp( d.rec.dc, want[w].dc, QTY_CHAN ) == 0
+             && memcmp( d.rec.sp, want[w].sp, QTY_CHAN ) == 0;
+      got++;
+      w++;
+    }
+  }
+  size_t lost = keyAfter - badRec;
+  bool   pass = ( same && badRec != 0 && keyAfter > badRec && got == qty - lost
+                  && qty == END_MS / 10 + 1 && d.gaps == 1 && d.bad >= 1 );
+
+  printf( " records %u (%u keys), %u bytes, %.1f a record, %.1f %% of 115200 baud\n",
+          (unsigned) qty, keys, (unsigned) capLen, (double) capLen / qty,
+          100.0 * capLen / ( END_MS * BYTEMS ) );
+  printf( " bad frame at record %u, lost %u to the next key, crc fails %u, gaps %u\n",
+          (unsigned) badRec, (unsigned) lost, d.bad, d.gaps );
+  printf( " decoded %u, %s\n", (unsigned) got, ( pass ? "PASS" : "FAIL" ) );
+  return ( pass ? 0 : 1 );
+}
+
+
+/*------------------------------- main() --------------------------------------
+*/
+
+int main( int argc, char * argv[] )
+{
+  if( argc > 1 && strcmp( argv[1], "-s" ) == 0 )
+  {
+    return selfCheck();
+  }
+  FILE * in = ( argc > 1 ? fopen( argv[1], "rb" ) : stdin );
+  if( in == NULL )
+  {
+    perror( argv[1] );
+    return 2;
+  }
+  teleDec_t d {};
+  uint8_t   buf[256];
+  size_t    len { 0 };
+  size_t    n;
+
+  csvHead( stdout );
+  while( ( n = fread( &buf[len], 1, sizeof( buf ) - len, in ) ) > 0 )
+  {
+    len += n;
+    size_t p { 0 };
+    for( ;; )
+    {
+      bool ok;
+      size_t used = ( p < len ? teleDecode( &buf[p], len - p, d, ok ) : 0 );
+      if( used == 0 )
+      {
+        break;
+      }
+      p += used;
+      if( ok == true )
+      {
+        csvRow( stdout, d.rec );
+      }
+    }
+    memmove( buf, &buf[p], len - p );
+    len -= p;
+  }
+  fprintf( stderr, "crc fails %u, gaps %u\n", d.bad, d.gaps );
+  return 0;
+}
+
+/*-------------------------------TELEdec.cpp EoF ------------------------------*/
@@ -0,0 +1,87 @@
+/*file: AWD.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Audio Warning Device tone from Timer3 comparator B. See AWD.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#ifdef ARDUINO            /* MEGA only, no host build                        */
+
+#include "AWD.h"
+#include "PWM.h"
+#include "CHAN.h"                     /* PWM_TOP                             */
+
+
+constexpr bool chanPin( uint8_t pin, uint8_t i = 0 )   /* pin in PWMPIN[]  */
+{
+  return ( i < QTY_PWMCHAN && ( PWMPIN[i] == pin || chanPin( pin, i + 1 ) ) );
+}
+
+static_assert( pwmTimer( PWMPIN[0] ) == 3,
+               "AWD needs Timer3 running at PWM_TOP, see AWD.h" );
+static_assert( pwmTimer( 2 ) == 3 && pwmComp( 2 ) == 1 && ! chanPin( 2 ),
+               "AWD needs OC3B, pin 2, free of chans" );
+
+const uint8_t AWD_IRQ { _BV( ICIE3 ) | _BV( OCIE3B ) | _BV( TOIE3 ) };
+const uint8_t AWD_FLAG { _BV( ICF3 ) | _BV( OCF3B ) | _BV( TOV3 ) };
+
+
+/*------------------------------------------ awdBegin() --------------------
+ *
+ * comparator B to half way, its pin stays a GPIO (COM3B = 0). From setup()
+*/
+
+void awdBegin()
+{
+  uint8_t sreg = SREG;                /* 16 bit store, timers share 1 TEMP   */
+  cli();
+  OCR3B = PWM_TOP / 2;
+  TIMSK3 &= ~AWD_IRQ;
+  SREG = sreg;
+  PINAWD_LOW;
+}
+
+
+/*------------------------------------------ awdSound() --------------------
+ *
+ * sounder on or off. Called each tick from the 1 ms ISR, so it is the only
+ *  TIMSK3 writer in an ISR. Stale flags are cleared as it starts, so the
+ *  first half cycle is not short.
+*/
+
+void awdSound( bool on )
+{
+  if( on == true )
+  {
+    if( ( TIMSK3 & AWD_IRQ ) == 0 )
+    {
+      TIFR3 = AWD_FLAG;               /* write 1 to clear                    */
+      TIMSK3 |= AWD_IRQ;
+    }
+  }
+  else
+  {
+    TIMSK3 &= ~AWD_IRQ;
+    PINAWD_LOW;
+  }
+}
+
+
+/*------------------------------------------ ISR() -------------------------
+ *
+ * each 128 us, at BOTTOM, OCR3B up, TOP, OCR3B down. Toggle the pin.
+*/
+
+ISR( TIMER3_COMPB_vect )
+{
+  PINAWD_TOGGLE;
+}
+
+ISR( TIMER3_CAPT_vect, ISR_ALIASOF( TIMER3_COMPB_vect ) );
+ISR( TIMER3_OVF_vect, ISR_ALIASOF( TIMER3_COMPB_vect ) );
+
+#endif /* ARDUINO */
+
+/*-------------------------------AWD.cpp EoF ------------------------------*/
@@ -0,0 +1,34 @@
+/*file: AWD.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Audio Warning Device. Piezo sounder tone on PINAWDSIG, see PIN.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The piezo is loudest near 4 kHz, 125 us a half cycle. The 1 ms tick is
+ *  far too slow to toggle it and PINAWDSIG (PC0) is not a comparator pin.
+ *
+ * Timer3 runs chans 1, 2 on OC3A, OC3C. Phase correct, TOP = PWM_TOP, so
+ *  a 512 us period, see PWM.h. Its comparator B (pin 2) is not a chan.
+ *  OCR3B at TOP / 2 matches on the way up and down. With the TOP (ICF3)
+ *  and BOTTOM (TOV3) flags that is an interrupt each 128 us, evenly
+ *  spaced. Each toggles the pin, a 3.9 kHz square. The timer is not
+ *  touched, chan PWM is as before.
+ * The 3 interrupts are on only while the sounder is, about 1% of the
+ *  CPU. awdSound() is called by the 1 ms tick, see foreground()
+*/
+#ifndef AWD_H__  /* include guard */
+#define AWD_H__
+
+#include "PIN.h"
+
+
+void awdBegin();                      /* OCR3B at TOP / 2. After setupPins() */
+void awdSound( bool on );             /* from ISR. Off leaves the pin low    */
+
+
+#endif /* AWD_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,129 @@
+/*file: BAM.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Bit angle modulation for chans 11 up. See BAM.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "BAM.h"
+
+
+static uint8_t bamLive[BAM_SLOTS][QTY_BAMPORT]; /* ISR rows, pad row is 0    */
+static uint8_t bamNext[BAM_BITS][QTY_BAMPORT];  /* rows by bit, bamWrite()   */
+static volatile bool bamReq { false };          /* bamNext[] to take         */
+
+
+/*------------------------------------------ bamWrite() --------------------
+ *
+ * new level for BAM chan i. Its port bit is set in the row of each level
+ *  bit, 8 writes whatever the chan count.
+*/
+
+void bamWrite( uint8_t i, uint16_t pwm )
+{
+  const bamPin_t & p = BAMPIN[i];
+  uint8_t level = pwm >> ( PWM_BITS - BAM_BITS );
+  uint8_t bit = 1U << p.bit;
+
+  for( uint8_t b = 0; b < BAM_BITS; b++, level >>= 1 )
+  {
+    if( level & 1 )
+    {
+      bamNext[b][p.port] |= bit;
+    }
+    else
+    {
+      bamNext[b][p.port] &= ~bit;
+    }
+  }
+  bamReq = true;
+}
+
+
+/*------------------------------------------ bamSlot() ---------------------
+ *
+ * ISR, slot s starts. A frame start takes a new table. Returns the port bits
+ *  to show till the next slot.
+*/
+
+const uint8_t * bamSlot( uint8_t s )
+{
+  if( s == 0 && bamReq == true )
+  {
+    for( uint8_t b = 0; b < BAM_BITS; b++ )
+    {
+      for( uint8_t p = 0; p < QTY_BAMPORT; p++ )
+      {
+        bamLive[BAM_BITS - 1 - b][p] = bamNext[b][p];  /* slot order, MSB 1st */
+      }
+    }
+    bamReq = false;
+  }
+  return bamLive[s];
+}
+
+
+#ifdef ARDUINO
+
+static void ( * bamTick )();          /* chan engine, each 1 ms              */
+
+const uint8_t BAMMASK_A { bamMask( BAMPORT_A ) };
+const uint8_t BAMMASK_L { bamMask( BAMPORT_L ) };
+const uint8_t BAMMASK_K { bamMask( BAMPORT_K ) };
+
+
+/*------------------------------------------ bamBegin() --------------------
+ *
+ * Timer1 to CTC, clk/1, compare A interrupt at each slot end. From setup(),
+ *  after setupPins(), in place of TimerOne.
+*/
+
+void bamBegin( void ( * tick )() )
+{
+  bamTick = tick;
+  TIMSK1 = 0;
+  TCCR1A = 0;                         /* no pins, WGM11:10 = 00              */
+  TCCR1B = _BV( WGM12 ) | _BV( CS10 ); /* CTC, TOP = OCR1A, clk/1           */
+  OCR1A = bamUnits( 0 ) * BAM_UNIT - 1;
+  TCNT1 = 0;
+  TIFR1 = _BV( OCF1A );
+  TIMSK1 = _BV( OCIE1A );
+}
+
+
+/*------------------------------------------ ISR() -------------------------
+ *
+ * slot end. OCR1A is not buffered in CTC, so it is set first, to the length
+ *  of the slot now starting. An ISR held off past a short slot would run
+ *  to 0xFFFF, it is cut short instead. Then the ports, then the engine.
+*/
+
+ISR( TIMER1_COMPA_vect )
+{
+  static uint8_t s { 1 };             /* slot 0 counts from bamBegin()       */
+  uint16_t top = bamUnits( s ) * BAM_UNIT - 1;
+
+  OCR1A = top;
+  if( TCNT1 >= top )
+  {
+    TCNT1 = top - 1;
+  }
+  const uint8_t * row = bamSlot( s );
+
+  PORTA = ( PORTA & ~BAMMASK_A ) | row[BAMPORT_A];
+  PORTL = ( PORTL & ~BAMMASK_L ) | row[BAMPORT_L];
+  PORTK = ( PORTK & ~BAMMASK_K ) | row[BAMPORT_K];
+
+  uint8_t was = s;
+  s = ( s + 1 == BAM_SLOTS ? 0 : s + 1 );
+  if( was < BAM_TICKSLOTS )
+  {
+    bamTick();                        /* foreground(), 500 us at least here  */
+  }
+}
+
+#endif /* ARDUINO */
+
+/*-------------------------------BAM.cpp EoF ------------------------------*/
@@ -0,0 +1,69 @@
+/*file: BAM.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Bit angle modulation (BAM). Software PWM for chans 11 up, on GPIO ports
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The timer comparators are all used by chans 1 - 10, PWM.h. With CHANS
+ *  over 10 the rest are on the port bits in BAMPIN[], see PIN.h.
+ *
+ * A BAM frame shows bit b of each chan's 8 bit level for 2^b units, so a
+ *  frame is 1 ISR per bit, not per level. Each ISR writes the 3 ports whole
+ *  from a table row, the same for 1 BAM chan or 14. ISR cost is O(bits),
+ *  not O(chans). A level change is 1 bit in each of the 8 rows.
+ *
+ * Timer1, CTC, clk/1. A unit is BAM_UNIT clocks, 7.8 us. Slots in order...
+ *  bit 7 (128 units, 1 ms), bit 6 (64) ... bit 0 (1), pad (1, all off).
+ *  256 units, a 2 ms frame, 500 Hz. The chan engine runs at the start of
+ *  bit 7 and of bit 6, exactly 1 ms apart, so Timer1 still gives the 1 ms
+ *  tick. TimerOne is not used with BAM chans. The engine must run in the
+ *  bit 6 slot, 500 us.
+ *
+ * The table is double buffered, as cfgBuf[] in CHAN.h. bamWrite() changes
+ *  the next table and sets bamReq, the ISR takes it at the frame start. So
+ *  a frame never shows half a level. The low PWM_BITS - 8 bits are dropped,
+ *  the dimmest levels are coarser than on chans 1 - 10.
+*/
+#ifndef BAM_H__  /* include guard */
+#define BAM_H__
+
+#include "PIN.h"
+
+
+const uint8_t  BAM_BITS  { 8 };            /* levels 0 - 255                 */
+const uint8_t  BAM_SLOTS { BAM_BITS + 1 }; /* a slot per bit, then the pad   */
+const uint8_t  BAM_PAD   { BAM_BITS };     /* slot bit of the pad, all off   */
+const uint16_t BAM_UNIT  { 125 };          /* clocks a unit at 16 MHz        */
+const uint8_t  BAM_TICKSLOTS { 2 };        /* slots 0, 1 run the chan engine */
+
+constexpr uint8_t BAM_SLOTBIT[BAM_SLOTS] { 7, 6, 5, 4, 3, 2, 1, 0, BAM_PAD };
+
+constexpr uint8_t bamUnits( uint8_t s )    /* slot length, units             */
+{
+  return ( BAM_SLOTBIT[s] == BAM_PAD ? 1 : 1U << BAM_SLOTBIT[s] );
+}
+
+constexpr uint8_t bamMask( uint8_t port, uint8_t i = 0 ) /* BAM port bits    */
+{
+  return ( i >= QTY_BAMCHAN ? 0
+         : ( BAMPIN[i].port == port ? 1U << BAMPIN[i].bit : 0 )
+           | bamMask( port, i + 1 ) );
+}
+
+static_assert( bamUnits( 0 ) * BAM_UNIT == 16000,
+               "bit 7 slot must be 1 ms, the engine tick" );
+
+
+void    bamWrite( uint8_t i, uint16_t pwm ); /* BAM chan i, chan 11 + i. With */
+                                             /*  interrupts off, see HAL.cpp  */
+const uint8_t * bamSlot( uint8_t s );        /* ISR, start slot s. Port bits  */
+                                             /*  to show, [QTY_BAMPORT]       */
+void    bamBegin( void ( * tick )() );       /* Timer1 BAM, tick each 1 ms    */
+
+
+#endif /* BAM_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,342 @@
+/*file: CACHE.cpp
+ *----------------------------------------------------------------------------
+ *
+ * RAM copy of the NVs and the learned event table. See CACHE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "CACHE.h"
+#include "CRC.h"                      /* crc8()                              */
+#include "DEFAULTNV.h"                /* defaultNV()                         */
+
+
+/* CBUS opcodes that change NVs or events. As cbusdefs.h, not included here
+ *  so the host build does not need the CBUS library.
+*/
+const uint8_t OPC_NNCLR_  { 0x55 };   /* clear all events                    */
+const uint8_t OPC_EVULN_  { 0x95 };   /* unlearn an event                    */
+const uint8_t OPC_NVSET_  { 0x96 };   /* set an NV                           */
+const uint8_t OPC_EVLRN_  { 0xD2 };   /* teach an event                      */
+const uint8_t OPC_EVLRNI_ { 0xF5 };   /* teach an event by index             */
+
+static cacheMap_t eeMap;              /* EEPROM layout                       */
+
+static uint8_t nvs[QTY_NV];           /* NV 1 - QTY_NV at [0] - [QTY_NV-1]   */
+static evIdx_t evs[QTY_EVENT];        /* learned event table                 */
+static bool    evStale { false };     /* events changed in EEPROM            */
+static bool    crcStale { false };    /* NVSET seen, the NV crc is behind    */
+
+
+static bool putEE( uint16_t adr, uint8_t val )  /* compare, then write      */
+{
+  if( halReadEE( adr ) == val )
+  {
+    return false;
+  }
+  halWriteEE( adr, val );
+  return true;
+}
+
+
+static uint8_t blobCrc()              /* header & NVs, as in EEPROM          */
+{
+  const uint8_t head[2] { NVBLOB_VER, QTY_CHAN };
+
+  return crc8( nvs, QTY_NV, crc8( head, 2 ) );
+}
+
+
+static void putCrc()
+{
+  crcStale = false;
+  putEE( eeMap.hdrStart + 2, blobCrc() );
+}
+
+
+/*------------------------------------------ loadNVs() ----------------------
+ *
+ * NVs of a chans layout to nvs[], a param row at a time, see ADRNV. Rows
+ *  from rows on, and chans past chans, are factory set. Returns the crc8
+ *  of what was read.
+*/
+
+static uint8_t loadNVs( uint8_t chans, uint8_t rows )
+{
+  const uint8_t head[2] { NVBLOB_VER, chans };
+  uint8_t crc = crc8( head, 2 );
+
+  for( uint8_t p = 0; p < NV_PER_CHAN; p++ )
+  {
+    for( uint8_t ch = 0; ch < chans && p < rows; ch++ )
+    {
+      uint8_t v = halReadEE( eeMap.nvStart + p * chans + ch );
+
+      crc = crc8( &v, 1, crc );
+      if( ch < QTY_CHAN )
+      {
+        nvs[p * QTY_CHAN + ch] = v;
+      }
+    }
+    for( uint8_t ch = ( p < rows ? chans : 0 ); ch < QTY_CHAN; ch++ )
+    {
+      nvs[p * QTY_CHAN + ch] = defaultNV( 1 + p * QTY_CHAN + ch );
+    }
+  }
+  return crc;
+}
+
+
+static void resetBadChans()           /* bad mode or gamma, factory chan     */
+{
+  ADRNV NV;
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( ( cacheNV( NV.mode( ch ) ) & 0x0F ) >= QTY_MODE
+        || cacheNV( NV.gamma( ch ) ) >= QTY_GAMMA )
+    {
+      for( uint8_t p = 0; p < NV_PER_CHAN; p++ )
+      {
+        nvs[p * QTY_CHAN + ch] = defaultNV( 1 + p * QTY_CHAN + ch );
+      }
+    }
+  }
+}
+
+
+static void moveEvents( uint16_t from )  /* event table, from other CHANS   */
+{
+  uint16_t qty = QTY_EVENT * eeMap.evBytes;
+
+  for( uint16_t i = 0; i < qty; i++ )
+  {
+    uint16_t b = ( from < eeMap.evStart ? qty - 1 - i : i );  /* overlaps    */
+
+    putEE( eeMap.evStart + b, halReadEE( from + b ) );
+  }
+}
+
+
+/*------------------------------------------ checkNVs() ---------------------
+ *
+ * check the NV blob and load it, or move it to this layout or use the
+ *  factory NVs. See CACHE.h
+ * The version byte is NVBLOB_CUT while the events move and the NVs are
+ *  written, and NVBLOB_VER last. If power is lost between, the next boot
+ *  keeps the NVs written so far, as this CHANS. Not DEFAULTNV, as an old
+ *  chan count with the new crc would give, and the event move is not run
+ *  again from a source it has part overwritten.
+*/
+
+static NVBLOB_t checkNVs()
+{
+  uint8_t  ver   = halReadEE( eeMap.hdrStart );
+  uint8_t  chans = halReadEE( eeMap.hdrStart + 1 );
+  uint8_t  crc   = halReadEE( eeMap.hdrStart + 2 );
+  NVBLOB_t blob { NVBLOB_MIGRATED };
+  uint16_t evFrom { 0 };              /* event table to move, 0 = none      */
+
+  if( ver == NVBLOB_VER )
+  {
+    if( chans < 1 || chans > QTY_PWMCHAN + QTY_BAMMAX
+        || loadNVs( chans, NV_PER_CHAN ) != crc )
+    {
+      blob = NVBLOB_DEFAULT;
+    }
+    else if( chans == QTY_CHAN )
+    {
+      return NVBLOB_OK;
+    }
+    else
+    {
+      evFrom = eeMap.nvStart + chans * NV_PER_CHAN;
+    }
+  }
+  else if( ver == NVBLOB_CUT )        /* a rewrite cut short, this CHANS    */
+  {
+    loadNVs( QTY_CHAN, NV_PER_CHAN );
+    resetBadChans();
+  }
+  else                                /* from before the blob, no Gamma     */
+  {
+    loadNVs( NVBASE_CHANS, NVBASE_ROWS );
+    resetBadChans();
+    evFrom = eeMap.nvStart + NVBASE_CHANS * NVBASE_ROWS;
+  }
+  if( blob == NVBLOB_DEFAULT )
+  {
+    for( uint8_t i = 0; i < QTY_NV; i++ )
+    {
+      nvs[i] = defaultNV( i + 1 );
+    }
+  }
+  putEE( eeMap.hdrStart, NVBLOB_CUT ); /* till done, see above              */
+  if( evFrom != 0 )
+  {
+    moveEvents( evFrom );             /* overlaps, a cut move is not redone  */
+  }
+  for( uint8_t i = 0; i < QTY_NV; i++ )
+  {
+    putEE( eeMap.nvStart + i, nvs[i] );
+  }
+  putCrc();
+  putEE( eeMap.hdrStart + 1, QTY_CHAN );
+  putEE( eeMap.hdrStart, NVBLOB_VER );  /* last, the blob is whole            */
+  return blob;
+}
+
+
+/*------------------------------------------ cacheBegin() -------------------
+ *
+ * set EEPROM layout, check & load all. Called by setupEEPROM()
+*/
+
+NVBLOB_t cacheBegin( const cacheMap_t & map )
+{
+  eeMap = map;
+  NVBLOB_t blob = checkNVs();
+  cacheLoadEvents();
+  return blob;
+}
+
+
+void cacheLoadEvents()
+{
+  evStale = false;
+  for( uint8_t idx = 0; idx < QTY_EVENT; idx++ )
+  {
+    uint16_t adr = eeMap.evStart + idx * eeMap.evBytes;
+
+    evs[idx].nn = ( halReadEE( adr ) << 8 ) | halReadEE( adr + 1 );
+    evs[idx].en = ( halReadEE( adr + 2 ) << 8 ) | halReadEE( adr + 3 );
+    evs[idx].ev = halReadEE( adr + 4 );
+  }
+}
+
+
+/*------------------------------------------ cacheNV() ---------------------
+ *
+ * NV value. Out of range NV reads 0, as CBUSConfig::readNV()
+*/
+
+uint8_t cacheNV( uint8_t nv )
+{
+  return ( nv >= 1 && nv <= QTY_NV ? nvs[nv - 1] : 0 );
+}
+
+
+void cacheSetNV( uint8_t nv, uint8_t val )
+{
+  if( nv >= 1 && nv <= QTY_NV && nvs[nv - 1] != val )
+  {
+    nvs[nv - 1] = val;
+    halWriteEE( eeMap.nvStart + nv - 1, val );
+    putCrc();
+  }
+}
+
+
+/*------------------------------------------ cacheSetNVs() ------------------
+ *
+ * all NVs, val[0] is NV 1. Only changed bytes are written, then the crc.
+ *  Returns the NV bytes written.
+*/
+
+uint8_t cacheSetNVs( const uint8_t * val )
+{
+  uint8_t n { 0 };
+
+  for( uint8_t i = 0; i < QTY_NV; i++ )
+  {
+    if( nvs[i] != val[i] )
+    {
+      nvs[i] = val[i];
+      halWriteEE( eeMap.nvStart + i, val[i] );
+      n++;
+    }
+  }
+  if( n != 0 )
+  {
+    putCrc();
+  }
+  return n;
+}
+
+
+/*------------------------------------------ cacheEvent() ------------------
+ *
+ * learned event in slot idx. False if the slot is free.
+*/
+
+bool cacheEvent( uint8_t idx, evIdx_t & ev )
+{
+  if( idx >= QTY_EVENT )
+  {
+    return false;
+  }
+  ev = evs[idx];
+  return ( ev.nn != 0xFFFF || ev.en != 0xFFFF );
+}
+
+
+uint8_t cacheEV( uint8_t idx )
+{
+  return ( idx < QTY_EVENT ? evs[idx].ev : 0 );
+}
+
+
+/*------------------------------------------ cacheFrame() ------------------
+ *
+ * look at a CAN frame, before the CBUS library acts on it.
+ * NVSET to this node is mirrored now, the library writes the same value.
+ * Event teach/unteach only marks events stale, the library picks the slot.
+*/
+
+void cacheFrame( const uint8_t * data, uint8_t len, uint16_t nodeNum )
+{
+  if( len < 1 )
+  {
+    return;
+  }
+  switch( data[0] )
+  {
+    case OPC_NVSET_ :
+      if( len >= 5 && ( ( data[1] << 8 ) | data[2] ) == nodeNum
+          && data[3] >= 1 && data[3] <= QTY_NV )
+      {
+        nvs[data[3] - 1] = data[4];
+        crcStale = true;              /* library writes it, then the crc    */
+      }
+      break;
+    case OPC_NNCLR_ :
+    case OPC_EVULN_ :
+    case OPC_EVLRN_ :
+    case OPC_EVLRNI_ :
+      evStale = true;
+      break;
+  }
+}
+
+
+/*------------------------------------------ cacheSync() -------------------
+ *
+ * reload stale events, put the NV crc right. Called by loop() after
+ *  CBUS.process()
+*/
+
+void cacheSync()
+{
+  if( evStale == true )
+  {
+    cacheLoadEvents();
+  }
+  if( crcStale == true )
+  {
+    putCrc();
+  }
+}
+
+
+/*-------------------------------CACHE.cpp EoF ------------------------------*/
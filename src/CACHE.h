@@ -0,0 +1,92 @@
+/*file: CACHE.h     This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * RAM copy of the NVs and the learned event table, from EEPROM
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Loaded in one pass at boot. Reads are then RAM reads, EG. the EV value
+ *  on every event and 70 NVs on every setupChannels().
+ * Kept in step...
+ *  cacheSetNV() writes EEPROM and the cache, write-through.
+ *  cacheFrame() sees NVSET frames to this node and mirrors the value the
+ *   CBUS library writes. Teach/unteach frames mark the events stale, and
+ *   cacheSync() reloads them after CBUS.process(). See frameHandler()
+ *
+ * EEPROM access is through halReadEE() & halWriteEE(), so host/CACHEchk.cpp
+ *  can test it against a plain byte array.
+ *
+ * The NVs are a blob. A 3 byte header at hdrStart, EEPROM 6 - 8 that the
+ *  CBUS library leaves free, holds NVBLOB_VER, the chan count the NVs are
+ *  laid out for and a crc8 of those 2 and the NVs. cacheBegin() checks it
+ *  in the one pass that loads them...
+ *  good          the NVs are used as they are.
+ *  bad crc       factory DEFAULTNV, as 'DN'.
+ *  no header     NVs from before the blob, 6 a chan for 10 chans. Kept,
+ *                less any chan with a bad mode NV, that chan is factory
+ *                reset. Gamma NVs are factory set. The event table is
+ *                moved up after them, no events are lost.
+ *  other CHANS   NVs are moved to this chan count, a chan at a time, and
+ *                the event table after them. New chans are factory set.
+ *                Scenes and curves are not moved, save them again.
+ *  NVBLOB_CUT    a move or rewrite cut short, see checkNVs(). The NVs
+ *                written so far are kept as this CHANS, less any bad chan.
+ *                Events cut mid move may need teaching again.
+ * Writes compare first, only a changed byte is written, then the crc once.
+ *  An FCU NVSET is written by the CBUS library, cacheSync() then puts the
+ *  crc right.
+*/
+#ifndef CACHE_H__  /* include guard */
+#define CACHE_H__
+
+#include "CHAN.h"                     /* QTY_NV                              */
+
+
+const uint8_t QTY_EVENT { 13 }; /* total events required                      */
+const uint8_t NVBLOB_VER { 1 }; /* NV blob layout, a new layout adds 1       */
+const uint8_t NVBLOB_CUT { 0x80 | NVBLOB_VER }; /* version while rewritten */
+const uint8_t NVBASE_CHANS { 10 }; /* layout before the blob, 10 chans of  */
+const uint8_t NVBASE_ROWS  { 6 };  /*  6 NVs, Trans to Mode, no Gamma       */
+
+
+enum NVBLOB_t : uint8_t   /* the NVs found by cacheBegin()                   */
+{
+  NVBLOB_OK,              /* crc good                                        */
+  NVBLOB_MIGRATED,        /* no header or other CHANS, moved to this layout  */
+  NVBLOB_DEFAULT          /* bad crc, factory DEFAULTNV                      */
+};
+
+
+struct cacheMap_t   /* EEPROM layout, as set in CBUSConfig by setupEEPROM()  */
+{
+  uint16_t  hdrStart;     /* NV blob header, 3 bytes, fixed for all CHANS    */
+  uint16_t  nvStart;      /* EE_NVS_START, NV 1                              */
+  uint16_t  evStart;      /* EE_EVENTS_START, event 0                        */
+  uint8_t   evBytes;      /* EE_BYTES_PER_EVENT, NN EN (4) + EVs             */
+};
+
+
+struct evIdx_t      /* a learned event, as in EEPROM                         */
+{
+  uint16_t  nn;           /* node number, 0xFFFF = slot free                 */
+  uint16_t  en;           /* event number                                    */
+  uint8_t   ev;           /* EV1, the EVAL_t command                         */
+};
+
+
+NVBLOB_t cacheBegin( const cacheMap_t & map ); /* set layout, check, load */
+void    cacheLoadEvents();                /* reload event table from EEPROM  */
+uint8_t cacheNV( uint8_t nv );            /* NV 1 - QTY_NV, RAM read          */
+void    cacheSetNV( uint8_t nv, uint8_t val );  /* write-through             */
+uint8_t cacheSetNVs( const uint8_t * val ); /* all NVs, bytes written        */
+bool    cacheEvent( uint8_t idx, evIdx_t & ev ); /* false if slot is free    */
+uint8_t cacheEV( uint8_t idx );           /* EV1 of learned event, RAM read  */
+void    cacheFrame( const uint8_t * data, uint8_t len, uint16_t nodeNum );
+void    cacheSync();                      /* reload stale parts, from loop() */
+
+
+#endif /* CACHE_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,380 @@
+/*file: CAL.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Per chan current calibration. See CAL.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "CAL.h"
+#include "GAMMA.h"            /* Gamma correction tables                      */
+#include "LOG.h"              /* deferred log ring                            */
+
+
+static uint16_t calStartEE { 0 };     /* EEPROM address of CAL_VALID         */
+static bool     valid { false };      /* curves are loaded                   */
+static uint8_t  base { 0 };           /* mA all off, LIM_UNITMA              */
+static uint8_t  curve[QTY_CHAN][LIM_POINTS]; /* as EEPROM, LIM_UNITMA        */
+static CALST_t  st[QTY_CHAN];         /* chan state, CALST_NONE till loaded  */
+static chanBits_t liveOpen { 0 };     /* bit per chan, calCheck() set OPEN   */
+
+static bool     busy { false };       /* calibration running                 */
+static uint8_t  step { 0 };           /* 0 = all off, then ch * points + 1   */
+static uint32_t msStep;               /* halMillis() at step PWM write       */
+static uint32_t msRead;               /* halMillis() at last Amp reading     */
+static uint32_t sum;                  /* Amp readings this step, mA          */
+static uint8_t  reads;
+static uint8_t  newBase;
+static uint8_t  newCurve[QTY_CHAN][LIM_POINTS];
+
+const uint8_t CAL_STEPS { 1 + QTY_CHAN * LIM_POINTS };
+
+
+static uint16_t pointPWM( uint8_t p )  /* PWM 1/4, 1/2, 3/4, TOP             */
+{
+  return ( p < LIM_POINTS - 1 ? ( p + 1 ) << LIM_PTSHIFT : PWM_TOP );
+}
+
+
+static void light( uint8_t s )         /* chan of step s on its own, loop()  */
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    bool on = ( s != 0 && ch == ( s - 1 ) / LIM_POINTS );
+
+    halWritePWM( ch, ( on ? pointPWM( ( s - 1 ) % LIM_POINTS ) : 0 ) );
+  }
+}
+
+
+/*------------------------------------------ apply() -------------------------
+ *
+ * state of each chan from its curve, and the curve to the limiter model
+*/
+
+static void apply()
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    const uint8_t * c = curve[ch];
+
+    if( c[LIM_POINTS - 1] == CAL_SHORT )
+    {
+      st[ch] = CALST_SHORT;
+    }
+    else if( c[LIM_POINTS - 1] * LIM_UNITMA < CAL_OPENMA )
+    {
+      st[ch] = CALST_OPEN;
+    }
+    else
+    {
+      st[ch] = CALST_OK;
+    }
+    limSetCurve( ch, c );
+  }
+  liveOpen = 0;
+  valid = true;
+}
+
+
+/*------------------------------------------ calBegin() ----------------------
+ *
+ * load stored curves, if any. Called from setupEEPROM(), after sceneBegin()
+*/
+
+void calBegin( uint16_t eeStart )
+{
+  calStartEE = eeStart;
+  if( halReadEE( eeStart ) != CAL_VALID )
+  {
+    return;                           /* not calibrated, LIM_FULLMA          */
+  }
+  base = halReadEE( eeStart + 1 );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    for( uint8_t p = 0; p < LIM_POINTS; p++ )
+    {
+      curve[ch][p] = halReadEE( eeStart + 2 + ch * LIM_POINTS + p );
+    }
+  }
+  apply();
+}
+
+
+/*------------------------------------------ calStart() ----------------------
+ *
+ * hold the ISR off the PWM and start with all chans off. The engine keeps
+ *  time, so the chans come back at their current dc. See setAllPWM()
+*/
+
+bool calStart()
+{
+  if( busy == true )
+  {
+    return false;
+  }
+  busy = true;
+  step = 0;
+  sum = 0;
+  reads = 0;
+  pwmHold = true;
+  light( step );
+  msStep = halMillis();
+  return true;
+}
+
+
+bool calBusy()
+{
+  return busy;
+}
+
+
+/*------------------------------------------ calAbort() ----------------------
+ *
+ * Power fault while calibrating. The chan lit tripped it, so it is a short.
+ *  Nothing is stored. Power holds the PWM off and restores it, so pwmHold
+ *  is left as it is.
+*/
+
+void calAbort()
+{
+  if( busy == false )
+  {
+    return;
+  }
+  busy = false;
+  if( step != 0 )
+  {
+    uint8_t ch = ( step - 1 ) / LIM_POINTS;
+
+    st[ch] = CALST_SHORT;
+    logPut( LOG_CALSHORT, ch + 1 );
+  }
+}
+
+
+/*------------------------------------------ finish() ------------------------
+ *
+ * store the new curves, valid byte last so a part write is not calibrated.
+ *  Then PWM back to the engine.
+*/
+
+static void finish()
+{
+  uint8_t open { 0 }, shorts { 0 };
+
+  busy = false;
+  base = newBase;
+  halWriteEE( calStartEE, 0xFF );
+  halWriteEE( calStartEE + 1, base );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    for( uint8_t p = 0; p < LIM_POINTS; p++ )
+    {
+      curve[ch][p] = newCurve[ch][p];
+      halWriteEE( calStartEE + 2 + ch * LIM_POINTS + p, curve[ch][p] );
+    }
+  }
+  halWriteEE( calStartEE, CAL_VALID );
+  apply();
+
+  pwmHold = false;
+  setAllPWM( PWM_RESTORE );
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( st[ch] == CALST_OPEN )
+    {
+      open++;
+      logPut( LOG_CALOPEN, ch + 1 );
+    }
+    else if( st[ch] == CALST_SHORT )
+    {
+      shorts++;
+      logPut( LOG_CALSHORT, ch + 1 );
+    }
+  }
+  uint16_t mA = base * LIM_UNITMA;
+  logPut( LOG_CALDONE, mA >> 8, mA & 0xFF, open, shorts );
+}
+
+
+/*------------------------------------------ calRun() ------------------------
+ *
+ * 1 step of calibration, called each loop() with the filtered Amp reading.
+ *  Waits CAL_SETTLEMS after each PWM change, then adds 1 reading a ms.
+ *  A chan over CAL_SHORTMA goes off at once, its points left are CAL_SHORT.
+*/
+
+void calRun( uint16_t mA )
+{
+  uint32_t ms = halMillis();
+
+  if( busy == false || ms - msStep < CAL_SETTLEMS || ms == msRead )
+  {
+    return;
+  }
+  msRead = ms;
+  sum += mA;
+  if( ++reads < CAL_SAMPLES )
+  {
+    return;
+  }
+  uint16_t avg = ( sum + CAL_SAMPLES / 2 ) / CAL_SAMPLES;
+  uint16_t bm = newBase * LIM_UNITMA;
+  uint16_t val = ( step == 0 ? avg : ( avg > bm ? avg - bm : 0 ) );
+  uint16_t units = ( val + LIM_UNITMA / 2 ) / LIM_UNITMA;
+
+  units = ( units > CAL_SHORT - 1 ? CAL_SHORT - 1 : units );
+  sum = 0;
+  reads = 0;
+  if( step == 0 )
+  {
+    newBase = units;
+  }
+  else
+  {
+    uint8_t ch = ( step - 1 ) / LIM_POINTS;
+    uint8_t p  = ( step - 1 ) % LIM_POINTS;
+
+    newCurve[ch][p] = units;
+    if( val > CAL_SHORTMA )
+    {
+      for( uint8_t q = p; q < LIM_POINTS; q++ )
+      {
+        newCurve[ch][q] = CAL_SHORT;
+      }
+      step += LIM_POINTS - 1 - p;     /* points left skipped, chan off       */
+    }
+  }
+  if( ++step >= CAL_STEPS )
+  {
+    finish();
+    return;
+  }
+  light( step );
+  msStep = ms;
+}
+
+
+/*------------------------------------------ calEstMA() ----------------------
+ *
+ * model mA of a chan, at the PWM the ISR writes. Soft limit scale included.
+ *  A held or SHUTDOWN chan is off. A chan under test is not modelled.
+*/
+
+uint16_t calEstMA( uint8_t ch )
+{
+  if( pwmHold == true || evCmd == EVAL_SHUTDOWN )
+  {
+    return 0;
+  }
+  uint32_t pwm = gammaLook( chanCfg( ch ).gamma, var[ch].dcCur );
+
+  return limPwmMA( ch, ( pwm * pwmScale ) >> 7 );
+}
+
+
+uint16_t calBaseMA()
+{
+  return base * LIM_UNITMA;
+}
+
+
+CALST_t calState( uint8_t ch )
+{
+  return st[ch];
+}
+
+
+/*------------------------------------------ calCheck() ----------------------
+ *
+ * live check, each CAL_CHECKMS while no chan is in a transit or effect. The
+ *  Amp reading low by one chan's model mA, within CAL_TOLMA + 1/32, names
+ *  that chan open. CAL_CHECKN checks in a row make a report. Other misfits
+ *  are logged as the model being off. An OPEN chan counts 0 mA, a live
+ *  OPEN is OK again once the reading is back up by its mA.
+*/
+
+void calCheck( uint16_t mA )
+{
+  static uint32_t msCheck { 0 };
+  static uint8_t  suspect { QTY_CHAN + 1 }; /* chan, QTY_CHAN = not 1 chan   */
+  static uint8_t  seen { 0 };               /* checks in a row on suspect    */
+
+  uint32_t ms = halMillis();
+
+  if( valid == false || busy == true || ms - msCheck < CAL_CHECKMS )
+  {
+    return;
+  }
+  msCheck = ms;
+
+  uint16_t chMA[QTY_CHAN];
+  uint16_t est = base * LIM_UNITMA;
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    STATE_t s = var[ch].state;
+
+    if( s == STATE_TRANSIT || s == STATE_EFFECT )
+    {
+      return;                         /* moving, Amp filter lags             */
+    }
+    chMA[ch] = ( st[ch] == CALST_OPEN ? 0 : calEstMA( ch ) );
+    est += chMA[ch];
+  }
+  int16_t  diff = (int16_t) mA - (int16_t) est;
+  uint16_t tol = CAL_TOLMA + est / 32;
+  uint8_t  who { QTY_CHAN + 1 };          /* fits, no suspect                */
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( ( liveOpen & ( (chanBits_t) 1 << ch ) ) != 0
+        && diff + (int16_t) tol >= (int16_t) calEstMA( ch ) )
+    {
+      st[ch] = CALST_OK;                  /* string back, check again next   */
+      liveOpen &= ~( (chanBits_t) 1 << ch );
+      return;
+    }
+  }
+
+  if( diff < -(int16_t) tol )
+  {
+    uint16_t best = tol + 1;
+
+    who = QTY_CHAN;
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      uint16_t miss = abs( (int16_t) chMA[ch] + diff );
+
+      if( st[ch] == CALST_OK && chMA[ch] != 0 && miss < best )
+      {
+        best = miss;
+        who = ch;
+      }
+    }
+  }
+  else if( diff > (int16_t) tol )
+  {
+    who = QTY_CHAN;
+  }
+
+  seen = ( who != suspect ? 1 : seen + ( seen <= CAL_CHECKN ) );
+  suspect = who;                      /* seen stops at CAL_CHECKN + 1        */
+  if( seen == CAL_CHECKN && who < QTY_CHAN )
+  {
+    st[who] = CALST_OPEN;
+    liveOpen |= ( (chanBits_t) 1 << who );
+    logPut( LOG_CALOPEN, who + 1 );
+  }
+  else if( seen == CAL_CHECKN && who == QTY_CHAN )
+  {
+    logPut( LOG_CALDRIFT, mA >> 8, mA & 0xFF, est >> 8, est & 0xFF );
+  }
+}
+
+
+/*-------------------------------CAL.cpp EoF ------------------------------*/
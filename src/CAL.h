@@ -0,0 +1,68 @@
+/*file: CAL.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Per chan current calibration. Measured mA curves in EEPROM, open & short
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The Amp sense is one reading for all chans. Calibration lights each chan
+ *  on its own, all others off, at PWM 1/4, 1/2, 3/4 and TOP, and averages
+ *  CAL_SAMPLES readings at each, after CAL_SETTLEMS. All off first gives
+ *  the base mA, taken off each point. About 3.5 s, lights are off for it.
+ * Serial Monitor 'C', or an EVAL_CALIBRATE On event, starts it. calRun()
+ *  steps it from loop(), it does not block. A Power fault aborts it.
+ *
+ * Curves feed the limiter model, see LIMIT.h, and the mA column of 'v'.
+ *  A chan under CAL_OPENMA at TOP is an open string. A chan over CAL_SHORTMA,
+ *  or that trips the over Amp, is a short. Its point is stored as 0xFF.
+ * calCheck() compares the Amp reading with the model while no chan moves.
+ *  Low by about one chan's mA names that chan as open.
+ *
+ * EEPROM map, after the scene table...
+ *  CAL_VALID, base mA, then per chan LIM_POINTS bytes, LIM_UNITMA units.
+ *  Erased EEPROM (0xFF) is not calibrated, chans use LIM_FULLMA.
+*/
+#ifndef CAL_H__  /* include guard */
+#define CAL_H__
+
+#include "LIMIT.h"
+
+
+const uint8_t  CAL_VALID    { 0xCA };  /* first byte of stored curves         */
+const uint8_t  CAL_BYTES    { 2 + QTY_CHAN * LIM_POINTS };  /* EEPROM bytes   */
+const uint8_t  CAL_SHORT    { 0xFF };  /* curve point of a shorted chan       */
+const uint16_t CAL_SETTLEMS { 20 };    /* ms after a PWM change, before reads */
+const uint8_t  CAL_SAMPLES  { 64 };    /* Amp readings averaged, 1 per ms     */
+const uint16_t CAL_OPENMA   { 16 };    /* less at PWM_TOP is an open string   */
+const uint16_t CAL_SHORTMA  { 1600 };  /* more, 1 chan alone, is a short      */
+const uint16_t CAL_TOLMA    { 66 };    /* live check slack, 3 Amp counts      */
+const uint16_t CAL_CHECKMS  { 1000 };  /* ms between live checks              */
+const uint8_t  CAL_CHECKN   { 3 };     /* checks in a row before a report     */
+
+
+enum CALST_t : uint8_t  /* chan calibration state */
+{
+  CALST_NONE  = 0,        /* not calibrated, LIM_FULLMA                      */
+  CALST_OK    = 1,
+  CALST_OPEN  = 2,        /* no current at PWM_TOP, or live check is low     */
+  CALST_SHORT = 3         /* over CAL_SHORTMA, or tripped, at calibration    */
+};
+const uint8_t QTY_CALST { 4 };
+
+
+void     calBegin( uint16_t eeStart );  /* EEPROM adr, load curves. setupEEPROM */
+bool     calStart();                    /* false if it is already running     */
+void     calRun( uint16_t mA );         /* 1 step, from loop(), Amp in mA     */
+void     calAbort();                    /* Power fault, chan lit is a short   */
+bool     calBusy();
+void     calCheck( uint16_t mA );       /* live open string check, loop()     */
+CALST_t  calState( uint8_t ch );
+uint16_t calEstMA( uint8_t ch );        /* model mA of chan now, as written   */
+uint16_t calBaseMA();                   /* mA with all chans off              */
+
+
+#endif /* CAL_H__
+ --------------------------------------- EoF ------------------------------
+*/
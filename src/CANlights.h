@@ -15,7 +15,11 @@
 #ifndef CANLIGHTS_H__  /* include guard */
 #define CANLIGHTS_H__
 
-//#include "CANlights.cpp"
+#include "CHAN.h"          /* channel engine types, data and functions    */
+#include "CACHE.h"         /* NV & event RAM copy, QTY_EVENT              */
+#include "CAL.h"           /* chan current curves, QTY_CALST              */
+#include "SYNC.h"          /* multi-node sync, QTY_SYNCST                 */
+#include "EVENT.h"         /* event & frame handling, calibrate()         */
 
 
 unsigned char sCBUSNAME[8] { "LIGHTS " };   /* 7 chars, trailing space pad */
@@ -23,50 +27,15 @@ unsigned char sCBUSNAME[8] { "LIGHTS " };   /* 7 chars, trailing space pad */
 const uint8_t CBUSMODULEID { 99 };
   
 
-extern const uint8_t QTY_CHAN;  /* qty of PWM channels for LED chans. * PIN.h */
-
-const uint8_t QTY_NV { 60 };    /* qty of Node Variables                      */
-  
-const uint8_t QTY_EVENT { 13 }; /* total events required                      */
-
-
-enum DC_t : uint8_t
-{
-  DC_MIN = 0,               /* Duty Cycle ranges  0                       */
-  DC_MID = 127,             /*                    to                      */
-  DC_MAX = 255              /*                    255                     */
-};
-
-
 enum EN_t : uint8_t   /* Event Numbers(EN) for ACON/ACOF message sending  */
 {
   EN_NIGHTSW = 0,           /* (extInput) On event= Night, Off event= Day */
   EN_POWERON = 1,           /* On event = Power On, Off event = na        */
   EN_ALARM   = 2,           /* On event = Alarm on, Off event = No Alarm  */
-  EN_TESTMSG = 3            /* On event NA, Off event NA                  */
+  EN_TESTMSG = 3,           /* On event NA, Off event NA                  */
+  EN_SYNC    = 4            /* ACON2 master ticks, ACOF2 start, SYNC.h    */
 };
-const uint8_t QTY_EN { 4 };
-
-
-enum MODE_t : uint8_t    /* channel mode codes. For global var[] */
-{
-  MODE_DAYNIGHT = 0,
-  MODE_DUSK     = 1,
-  MODE_DAWN     = 2,
-  MODE_DUSKDAWN = 3,
-  MODE_NIGHT010 = 4,
-  MODE_DAY010   = 5
-};
-const uint8_t QTY_MODE { 6 };
-
-
-enum STATE_t : uint8_t  /* channel state codes. For var[] */
-{
-  STATE_STEADY,
-  STATE_TRANSIT,
-  STATE_DELAY 
-};
-const uint8_t OTY_STATE { 3 };
+const uint8_t QTY_EN { 5 };
 
 
 enum ONOFF_t : bool   /* CBUS on or off codes */
@@ -77,118 +46,68 @@ enum ONOFF_t : bool   /* CBUS on or off codes */
 const uint8_t OTY_ONOFF{ 2 };
 
 
-enum NIGHTSW_t : bool   /* module input codes. for nightSw global var */
+enum PWRST_t : uint8_t  /* Power fault states. See Power::testAmpAndVolt() */
 {
-  NIGHTSW_DAY   = 0,
-  NIGHTSW_NIGHT = 1
-};
-const uint8_t QTY_INPUT { 2 };
-
-
-enum EVAL_t : uint8_t  /* EV values on stored events */
-{
-  EVAL_NIGHTSW  = 0,     /* On event = NIGHT, Off event = DAY.                */
-  EVAL_TESTCH1  = 1,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH2  = 2,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH3  = 3,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH4  = 4,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH5  = 5,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH6  = 6,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH7  = 7,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH8  = 8,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH9  = 9,     /* On event DC=254, Off event DC=1                   */
-  EVAL_TESTCH10 = 10,    /* On event DC=254, Off event DC=1                   */  
-  EVAL_TESTEND  = 11,    /* On event Test End, Off event NA                   */
-  EVAL_SHUTDOWN = 12     /* On = All chans DC=0, Off event = normal operation */
-};
-const uint8_t QTY_EVAL { 13 };
-
-
-enum PWM_t : uint8_t 
-{
-  PWM_OFF = 0,
-  PWM_RESTORE = 1
+  PWRST_OK      = 0,        /* normal, chans running                      */
+  PWRST_FAULT   = 1,        /* over Amp or under Volt, PWM held off       */
+  PWRST_RECOVER = 2         /* fault gone, waiting RECOVERMS to be sure   */
 };
+const uint8_t QTY_PWRST { 3 };
 
 
 /*----------------------------- class Power ------------------------------------
  *
- *  processing over Amp or under Volt conditions
+ *  processing over Amp or under Volt conditions.
+ *  Nothing here blocks. testAmpAndVolt() is called on each loop() and steps
+ *   the fault state. The 1 ms tick turns the sounder on & off, see AWD.h
 */
 
 class Power
 {
   public:
  
-    void alarm(uint16_t duration_ms); /* Sound AWD for n milli second.        */
-    bool isUnderVolt();               /* 12 V PolyFuse tripped                */
-    bool isOverAmp();                 /* read Volts on sense resistor as Amps */
-    void printAmps();                 /* print, approx, measured mA to Serial */
-    void testAmpAndVolt();            /* if fault alarm & reduce duty cycles  */
+    void alarm(uint16_t duration_ms); /* start AWD for n ms, does not wait    */
+    bool isUnderVolt();               /* 12 V PolyFuse tripped, filtered      */
+    bool isOverAmp();                 /* filtered sense resistor Volts > max  */
+    void printAmps();                 /* print filtered and peak mA to Serial */
+    void testAmpAndVolt();            /* step fault state, from loop()        */
+    PWRST_t getState() { return state; }
+    uint16_t getmA() { return amps * AMPCALIBRATE; } /* at last isOverAmp() */
 
   private:
   
-    uint16_t amps;                  /* latest Amp reading                     */
-
-    /* Rsense = 0R050,   2.0 A = 0.100 V on PINSENSE, into ADC
+    uint16_t amps;                  /* latest filtered Amp reading            */
+    uint16_t volts;                 /* latest filtered blue LED reading       */
+    bool     ampOver  { false };    /* filtered Amps was over at last check   */
+    bool     voltUnder { false };   /* filtered Volts was under at last check */
+    uint32_t msAmpOver;             /* millis() when Amps first seen over     */
+    uint32_t msVoltUnder;           /* millis() when Volts first seen under   */
+    PWRST_t  state { PWRST_OK };    /* fault state                            */
+    uint32_t msClear;               /* millis() when fault cleared            */
+    uint32_t msAlarm;               /* millis() when timed alarm started      */
+    uint16_t alarmLen { 0 };        /* timed alarm ms, 0 = none               */
+
+    static const uint16_t RECOVERMS { 250 };     /* fault clear ms to restore */
+    static const uint16_t TRIPMS { 2 };          /* over/under ms to trip     */
+
+    bool debounce( bool bad, bool & was, uint32_t & since );
+    void logFault();                /* queue fault record, see LOG.h          */
+
+    /* Samples are IIR filtered by the ADC ISR, see SENSE.h. Then a fault
+     *  must be seen on 2 checks, TRIPMS apart, before it trips.
+     *
+     * Rsense = 0R050,   2.0 A = 0.100 V on PINSENSE, into ADC
      * ADC range 0-1023, Vref = 1.10 V.  ADC reads 0.001074 V per unit. 
      * Max reading is 0.10 / 0.001074 = 93
     */
     static const uint16_t MAXAMPADCREAD { 93 };  /* 2.0 A  ADC threshold      */
     static const uint16_t AMPCALIBRATE { 22 };   /* multiplier for true Amps  */
+    static const uint16_t MINVOLTADCREAD { 1022 }; /* blue LED Vf, 12 V is on */
   
 }; /* end of class Power */
 
 
 
-/*-------------------------------- class ADRNV ---------------------------------
- *
- *  return address of NV  for a channel and param type
-*/
-
-class ADRNV
-{
-  public:
-  
-    ADRNV() { };
-    ~ADRNV() { };
-
-    uint8_t tran( uint8_t chan )           /* return transition NV for chan */
-    {
-      return ( NVmap[NV_TRAN][0] + chan );
-    }
-    
-    uint8_t dly( uint8_t chan, bool indx ) /* return delay NV for chan & idx */
-    {
-      return ( NVmap[NV_DLY][indx] + chan ); 
-    }
-
-    uint8_t dc( uint8_t chan, bool indx )   /* return DC NV for chan/index  */
-    {
-      return ( NVmap[NV_DC][indx] + chan ); 
-    }
-    
-    uint8_t mode( uint8_t chan)             /* return mode NV addr for chan */
-    {
-      return ( NVmap[NV_MODE][0] + chan );
-    }
-
-  private:
-    enum NV_t : uint8_t 
-    {
-      NV_TRAN = 0, NV_DLY, NV_DC, NV_MODE, NV_MAPSIZE
-    };
-    static constexpr uint8_t NVmap[NV_MAPSIZE][2] 
-    {
-      { 1,  1 },    /* Transition Secs are same for phase 0 or 1          */
-      { 11, 21 },   /* Delay Seconds for phase 0 and 1                    */
-      { 31, 41 },   /* DutyCylce for phase 0 and 1                        */
-      { 51, 51 }    /* Modes ... for phase 0 or 1 are the same            */
-    };
-}; /* end of class ADRNV */
-
-
-
 /*-------------------------------- class SerMon ------------------------------
  *
  *  print various data to Serial
@@ -203,6 +122,10 @@ class SerMon
     void variables();
     void storedEvents();
     void processKeyBoard();
+    void drainLog();                  /* 1 log record, if Serial has room     */
+    void saveScene( uint8_t n );      /* current chan DCs as scene n, 0 - 7   */
+    void printProf();                 /* latency profiles, then reset         */
+    void printTasks();                /* loop() task table, then reset        */
     
 }; /* end of class SerMon */
 
@@ -212,26 +135,32 @@ class SerMon
 */
 
 void loop();                          /* bacground process                    */
-void processChannels();               /* foreground process 1ms timer1        */
-void processChan( uint8_t );          /* process single chan, from foreground */
-
-void startNewPhase();                 /* called from loop or setUpChannels    */
-
+void setupTasks();                    /* loop() tasks, see TASK.h             */
+void taskCBUS();                      /* each pass, CAN frames or CAN start   */
+void taskPhase();                     /* each pass, NightSw to a new phase    */
+void taskPower();                     /* 1 ms, faults, calibration & limit    */
+void taskLog();                       /* 2 ms, telemetry & 1 log record       */
+void taskKeys();                      /* 20 ms, Serial Monitor keys           */
+void taskSync();                      /* each pass, sync timers & frames      */
+void foreground();                    /* 1 ms timer1 ISR, chans and sounder   */
 void eventHandler( uint8_t, CANFrame*); /* function registerd to CBUS library */
 void frameHandler( CANFrame* );       /* function registerd to CBUS library   */ 
 
 void sendEvent( ONOFF_t, uint16_t );  /* format/send ASON/ASOF event with EN  */
+void sendDiag();                      /* 1 DGN reply to RDGN, see PROF.h      */
+void sendSync( bool, uint16_t );      /* ACON2/ACOF2 EN_SYNC, see SYNC.h      */
 
 void setDefaultNVs();                 /* preset NVs. Called by SerMon command */
 
-void setAllPWM( PWM_t );              /* set all PWM DC to 0 or reset         */
-
 void setup();                         /* called on power on or reset          */
+void setupEEPROM();                   /* called by setup(), before the chans  */
 void setupCBUS();                     /* called by setup()                    */
-void setupChannels();                 /* called by setup()                    */
+void canStart();                      /* CBUS.begin(), retried from loop()    */
 
 extern void setupPins();              /* called by setup()  in PIN.cpp        */
 
+/* processChannels() setupChannels() startNewPhase() setAllPWM() in CHAN.h  */
+
 
 /*------------------------- data definitions --------------------------------*/
 
@@ -250,7 +179,18 @@ const char sEVAL[QTY_EVAL][9] /* fixed width strings */
   "TestCh9 ",             /* Chan 9 DC = 1 or 254         */
   "TestCh10",             /* Chan 10 DC = 1 or 254        */
   "TestEnd ",             /* Test mode end                */
-  "ShutDown"              /* all channels duty cycle = 0  */
+  "ShutDown",             /* all channels duty cycle = 0  */
+  "Scene1  ",             /* recall scene 1, see SCENE.h  */
+  "Scene2  ",
+  "Scene3  ",
+  "Scene4  ",
+  "Scene5  ",
+  "Scene6  ",
+  "Scene7  ",
+  "Scene8  ",
+  "Calibrat",             /* chan current calibration     */
+  "Sync    ",             /* sync master frames, SYNC.h   */
+  "Sequence"              /* program upload, SEQ.h        */
 };
 
 const char sEN[QTY_EN][9]       /* fixed width strings  */
@@ -258,7 +198,15 @@ const char sEN[QTY_EN][9]       /* fixed width strings  */
   " NightSw",
   " PowerOn",
   " Alarm  ",
-  " TestMsg"
+  " TestMsg",
+  " Sync   "
+};
+
+const char sPWRST[QTY_PWRST][8]  /* fixed width strings */
+{
+  "OK     ",
+  "Fault  ",
+  "Recover"
 };
 
 const char sINPUT[QTY_INPUT][6]  /* fixed width strings */
@@ -267,11 +215,27 @@ const char sINPUT[QTY_INPUT][6]  /* fixed width strings */
   "Night" 
 };
 
+const char sCALST[QTY_CALST][5]   /* fixed width strings */
+{
+  "-   ",
+  "ok  ",
+  "open",
+  "shrt"
+};
+
+const char sSYNCST[QTY_SYNCST][7]  /* fixed width strings */
+{
+  "none  ",
+  "locked",
+  "master"
+};
+
 const char sSTATE[OTY_STATE][5]   /* fixed width strings */
 {
   "Stdy",
   "Tran",
-  "Dly " 
+  "Dly ",
+  "Efct"
 };
 
 const char sMODE[QTY_MODE][9]  /* fixed width strings */
@@ -281,80 +245,18 @@ const char sMODE[QTY_MODE][9]  /* fixed width strings */
   "Dawn    ",
   "DuskDawn",
   "Night010",
-  "Day010  "
-};
-
-
-
-struct var_t   /* channel data structure. Populated at boot time from NVs    */
-{
-  uint8_t   secTrans;     /* Transition seconds                      0 - 255 */
-  
-  uint8_t   secDelay[2];  /* Delay seconds                           0 - 255 */
-
-  MODE_t    mode;         /* chan mode                                 0 - 5 */  
-
-  uint8_t   dc[2];        /* DC0 & DC1 phase 0 & phase 1 targets     0 - 255 */
-  
-  uint8_t   dcCur;        /* current DC value                        0 - 255 */
-  
-                          /* Derived from NV Transition seconds              */
-  uint16_t  msPerStep;    /* ms between duty cycle inc/dec           0 - 65k */
-
-     /* following are status/trackers */
-                          
-  uint32_t  msCount;      /* millis() counter for step or delay   0 - 255000 */
-                      
-  uint8_t   secCount;     /* seconds counter                         0 - 255 */
-  
-  STATE_t   state;        /* Stdy, Tran, Dlay trackers                 0 - 2 */
-  
-  bool      phase;        /* phase 0 or 1                              0 - 1 */                        
+  "Day010  ",
+  "Alws010 ",
+  "Rand010 ",
+  "OneShot ",
+  "Flicker ",
+  "Fire    ",
+  "Arc     ",
+  "Strobe  ",
+  "Seq     "
 };
 
 
-/* Channel Modes...
- *  
- *  MODE_DAYNIGHT 
- *  --------
- *  Input change to NIGHT,
- *   after secDelay[1], dc transitions from current dc to dc[1].
- *   Stay steady until,
- *  Input change to DAY,
- *   after secDelay[0], dc transitions from current dc to dc[0].
- *  
- *  DUSKDAWN
- *  -----------
- *  Input change to NIGHT,
- *   after secDelay[1], dc transitions from current dc to dc[1],
- *   after secDelay[0], dc transitions from current dc to dc[0].
- *  Stay steady until,
- *  Input change to DAY... as per nightSw change to 1.
- *   
- *  NIGHT010
- *  ---------
- *   Input change to NIGHT,
- *    after secDelay[1], transitions from current dc to dc[1],
- *    after secDelay[0], transitions from dc[1] to dc[0],
- *    after secDelay[1], transitions from dc[0] to dc[1],
- *    ... repeats until nightSw change to 0.
- *   Input change to DAY,
- *    after secDelay[0], transitions from current dc to dc[0].  
- *    
- *  DAY010
- *  -------
- *   Input change to DAY,
- *    after secDelay[1], transitions from current dc to dc[1],
- *    after secDelay[0], transitions from dc[1] to dc[0],
- *    after secDelay[1], transitions from dc[0] to dc[1],
- *    ... repeats until nightSw change to 0.
- *   Input change to NIGHT,
- *    after secDelay[0], transitions from current dc to dc[0].  
- *    
- *  [0] is day, [1] is night
- *  dc[0] and dc[1] can be configured as any value you want.
-*/
-
 
 #endif /* CANLIGHTS_H__ 
  --------------------------------------- EoF ------------------------------
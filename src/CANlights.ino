@@ -7,7 +7,7 @@ const char sTITLE[] { "CANlights © Dave Harris 2021 (MERG M2740)" };
 
 const uint8_t VER_MAJOR { 0 };            /* 0-255.    'CBUS version style' */
 const char    VER_MINOR { 'c' };          /* a-z character.                 */
-const uint8_t VER_BETA  { 5 };            /* 0-255. 0 is Released, > 0 beta */
+const uint8_t VER_BETA  { 6 };            /* 0-255. 0 is Released, > 0 beta */
 
 /*------------------------ © Copyright and License ----------------------------
  *  
@@ -30,11 +30,12 @@ const uint8_t VER_BETA  { 5 };            /* 0-255. 0 is Released, > 0 beta */
  * - CBUS events to put channels into a test mode (TestCh)
  * - CBUS event used to shutdown all channels (ShutDown)
  * 
- * - Each channel has the following 6 variables (from CBUS NVs)...
+ * - Each channel has the following 7 variables (from CBUS NVs)...
  *    Transintion seconds. Range 0-255.
  *    Delay0 and Delay1 seconds. Range 0-255.
  *    DC0 and DC1 duty cycles. Range 0 (off) through to 255 (on).
  *    Mode = DAYNIGHT DAWN DUSK DUSKDAWN NIGHT010 DAY010 ALWAY010.
+ *    Gamma curve 0-5. 0 = 2.75 (default), 1 = linear. See GAMMA.h
  * - A trigger causes a channels DC (PWM duty cycle) to change.
  *    (A trigger depends on the channels Mode)
  *    Phase 0 = after Delay0 secs, the DC transitions to DC0 & steady after.
@@ -93,6 +94,32 @@ const uint8_t VER_BETA  { 5 };            /* 0-255. 0 is Released, > 0 beta */
  *  9-May-2021 DH, v0b beta3 revB PCB changes
  * 18-May-2021 DH, v0c beta4 confusion on event DayNight, renamed to NightSw 
  * 20-May-2021 DH, v0c beta5 added local NightSw function
+ * 16-Oct-2026     v0c beta5 channel engine split to CHAN.cpp behind HAL.h,
+ *                  host simulator added in host/
+ * 16-Oct-2026     v0c beta6 12 bit PWM, compile time gamma tables, Gamma NVs
+ *                  61-70. Event table moves up 10 bytes, an older EEPROM
+ *                   is moved at boot, Gamma NVs factory set. See CACHE.h
+ *                  Non-blocking Power fault states, 3.9 kHz sounder, AWD.cpp
+ *                  ADC free runs in SENSE.cpp, filtered Amps & Volts
+ *                  Event, frame & fault output via deferred log, LOG.cpp
+ *                  NVs & event table cached in RAM, CACHE.cpp
+ *                  Scene table after events, recall by 1 event, SCENE.cpp
+ *                  Mode table, MODE.h. ALWAYS010 RANDOM010 ONESHOT modes
+ *                  Effect modes FLICKER FIRE ARC STROBE, EFFECT.h
+ *                  Latency profiler, PROF.cpp. 'P' & CBUS RDGN
+ *                  Soft current limiter, LIMIT.cpp. Over Amp trip is last
+ *                  Chan current calibration, CAL.cpp. 'C' & Calibrate event
+ *                  Warm restart snapshot, SNAP.cpp. CAN starts in background
+ *                  loop() task scheduler, TASK.cpp. 'L' prints the task table
+ *                  Multi-node sync, SYNC.cpp. 'M' = master, Sync event
+ *                  Chan count is build flag CHANS, 10 - 24. Chans 11 up are
+ *                   bit angle modulated on GPIO ports, BAM.cpp
+ *                  Event & frame handling in EVENT.cpp, host/BUSsim.cpp
+ *                  Binary telemetry, TELE.cpp. 'R' 0 - 9 sets the rate
+ *                  NVs are a versioned blob with a crc, checked at boot and
+ *                   moved to a new CHANS, CACHE.cpp
+ *                  Keyframe programs, mode SEQ, SEQ.cpp. host/SEQc.cpp
+ *                   compiles them, Sequence event uploads
  * 
  * 
 *--------------------------- file includes -----------------------------------*/
@@ -115,7 +142,20 @@ const uint8_t VER_BETA  { 5 };            /* 0-255. 0 is Released, > 0 beta */
 /* The following must be in the CANlights folder...                           */
 #include "CANlights.h"        /* class and function declarations              */
 #include "PIN.h"              /* pin definitions   ** settings PIN.cpp **     */
-#include "GAMMA8.h"           /* Gamma correction table                       */
+#include "CHAN.h"             /* channel engine    ** CHAN.cpp & HAL.cpp **   */
+#include "SENSE.h"            /* ADC sampler, Amps & Volts  ** SENSE.cpp **   */
+#include "LOG.h"              /* deferred log ring          ** LOG.cpp **     */
+#include "SCENE.h"            /* scene table in EEPROM      ** SCENE.cpp **   */
+#include "PROF.h"             /* latency profiler           ** PROF.cpp **    */
+#include "LIMIT.h"            /* soft current limiter       ** LIMIT.cpp **   */
+#include "SNAP.h"             /* warm restart snapshot      ** SNAP.cpp **    */
+#include "TASK.h"             /* loop() task scheduler      ** TASK.cpp **    */
+#include "SYNC.h"             /* multi-node sync            ** SYNC.cpp **    */
+#include "BAM.h"              /* chans 11 up, GPIO PWM      ** BAM.cpp **     */
+#include "EVENT.h"            /* event & frame handling     ** EVENT.cpp **   */
+#include "TELE.h"             /* binary telemetry stream    ** TELE.cpp **    */
+#include "SEQ.h"              /* keyframe programs          ** SEQ.cpp **     */
+#include "AWD.h"              /* sounder tone, Timer3       ** AWD.cpp **     */
 #include "DEFAULTNV.h"        /* factory reset NV array                       */
 
 
@@ -124,19 +164,12 @@ const uint8_t VER_BETA  { 5 };            /* 0-255. 0 is Released, > 0 beta */
 
 uint8_t  params[21];            /* CBUS params array                          */
 
-volatile var_t var[QTY_CHAN];   /* channel variable array. ISR modifies       */
-                                /* A mix of NVs, derived and tracking values  */
-
-volatile NIGHTSW_t  nightSw;     /* nightSw state 0 = DAY or 1 = NIGHT        */
-volatile bool swChange { true }; /* set by ISR. Reset when actioned           */
-
-EVAL_t  evCmd  { EVAL_NIGHTSW }; /* the current event command                 */
-uint8_t testDC { 0 };            /* current duty cycle for test mode          */
-bool    testCh { false };        /* false= no test chan, true= testing chan   */
-bool   stopISR { false };        /* true = disable 1 ms ISR process           */
 bool    noCAN  { false };        /* false = CBUS on, true = noCAN = no CBUS   */
-bool    debug  { false };        /* false = quiet, true = verbose             */
+bool    canUp  { false };        /* true = CBUS.begin() done, see canStart()  */
 bool muteAlarm { false };        /* false = quiet, true = sounding            */
+bool logBinary { false };        /* false = log as text, true = binary        */
+volatile bool awdOn { false };   /* true = sounder on, see Power & AWD.h      */
+uint32_t usLoop;                 /* micros() at start of last loop() pass     */
 
 
 /*------------------------------- objects ------------------------------------*/
@@ -151,230 +184,184 @@ CBUSSwitch INPUT_SW;          /* local NightSw input object                   */
 
 SerMon SerialMon;             /* Serial Monitor print object                  */
 Power  * PWR;                 /* Power object pointer                         */
+NVBLOB_t nvBlob;              /* NVs found at boot, see CACHE.h               */
 
 
 /*---------------------------------------------------- loop() ----------------- 
  * 
- * this is the Background process.
+ * this is the Background process. The tasks are in setupTasks(), see TASK.h
 */
 
 void loop() 
 {
-  if( noCAN == false )
+  uint32_t us = micros();
+  profAdd( PROF_LOOP, us - usLoop );  /* loop() pass, see PROF.h             */
+  usLoop = us;
+
+  taskRun();
+}
+
+
+/*--------------------------------------------------- setupTasks() ------------
+ *
+ * the loop() tasks. CBUS and the NightSw run every pass, so an event is
+ *  never behind housekeeping. Deadlines are from when the task is due.
+*/
+
+void setupTasks()
+{
+  /*       name     function     period ms   deadline us  priority */
+  taskAdd( "CBUS ", taskCBUS,    TASK_EVERY, 2000,        0 );
+  taskAdd( "Phase", taskPhase,   TASK_EVERY, 500,         1 );
+  taskAdd( "Sync ", taskSync,    TASK_EVERY, 500,         1 );
+  taskAdd( "Power", taskPower,   1,          1000,        2 );
+  taskAdd( "Diag ", sendDiag,    5,          5000,        3 );
+  taskAdd( "Log  ", taskLog,     2,          2000,        4 );
+  taskAdd( "Keys ", taskKeys,    20,         20000,       5 );
+  taskAdd( "Ticks", checkTicks,  1000,       50000,       6 );
+}
+
+
+/*--------------------------------------------------- taskCBUS() --------------
+ *
+ * CAN frames & events, or a CAN start retry
+*/
+
+void taskCBUS()
+{
+  if( canUp == true )
   {
     CBUS.process();
-  };
-  PWR->testAmpAndVolt();
-  
+    cacheSync();                      /* reload events the FCU changed       */
+  }
+  else if( noCAN == false )
+  {
+    canStart();                       /* retry, backs off, see canStart()    */
+  }
+}
+
+
+/*--------------------------------------------------- taskPhase() -------------
+ *
+ * local NightSw, or a NightSw event, starts a new phase
+*/
+
+void taskPhase()
+{
   INPUT_SW.run();
   if( INPUT_SW.stateChanged() == true )
   {
     nightSw = (NIGHTSW_t) ! INPUT_SW.getState();
-    Serial << " local NightSw " << sINPUT[nightSw] << endl;
+    logPut( LOG_LOCALSW, nightSw );
     sendEvent( (ONOFF_t) nightSw, EN_NIGHTSW );
-    startNewPhase();
+    syncPhase();                      /* now, or at the master's tick        */
   }
   else
   {
     if( swChange == true )  /* flag set by Event handler  */
     {
       swChange = false;     /* clear the flag             */
-      startNewPhase();
+      syncPhase();
     }
   }
-  SerialMon.processKeyBoard();
 }
 
 
-/*--------------------------------------------- processChannels() ----------
- * 
- * timer1 Interrupt Service Routine.  1 ms foreground process.
+/*--------------------------------------------------- taskSync() --------------
+ *
+ * sync timers, and the master's frames. A sync frame is sent as soon as it
+ *  is made, its ticks are read as late as can be. See SYNC.h
 */
-                                /* !!! This is ISR which runs every 1 ms !!! */
-void processChannels()          /*        keep it light as possible          */
-{
-  PINTP_D31_HIGH;               /* is ISR run time = min 21 us to peak 87 us */
 
-  if( stopISR == false )        /* other code sets true, if it changes var[] */
-  {                 
-    bool transits { false };    /* lights LED_BUILTIN if Transits are active */
+void taskSync()
+{
+  bool     start;
+  uint16_t tick;
 
-    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )      /* loop all channels     */
-    {
-      if( ch + 1 == evCmd )         /* TEST?, ch start at 0, cmd ch starts 1 */
-      {
-        analogWrite( PWMPIN[ch], testDC );    /* test DC is either 1 or 254  */
-      }
-      else
-      {
-        if( evCmd != EVAL_SHUTDOWN )      /* SHUTDOWN is done in eventHandler*/
-        {
-          processChan( ch, transits );
-        }
-      }
-    }
-    digitalWrite( LED_BUILTIN, transits );          /* show TRANSIT activity */
+  syncRun();
+  if( syncTx( start, tick ) == true )
+  {
+    sendSync( start, tick );
   }
-  PINTP_D31_LOW;   /* time from pin high to low is ISR run time */
 }
 
 
-/*--------------------------------------------- processChan() ---------------
- * 
- * Process 1 channel. Called from the foreground processChannels() 
+/*--------------------------------------------------- taskPower() -------------
+ *
+ * each ms. Power fault states, calibration or live check, snapshot and the
+ *  soft current limit, all from the one Amp reading.
 */
 
-void processChan( uint8_t ch, bool & transits )
+void taskPower()
 {
-  if( var[ch].state != STATE_STEADY )         /* is state not STEADY?        */
+  PWR->testAmpAndVolt();
+  if( PWR->getState() != PWRST_OK )
   {
-    var[ch].msCount++;
-    
-    if( var[ch].state == STATE_DELAY )                /* is state Delay?     */
-    {
-      if( var[ch].msCount >= 1000 )                   /* count delay seconds */
-      {
-        var[ch].msCount = 0;
-        var[ch].secCount++;
-        
-        if( var[ch].secCount > var[ch].secDelay[var[ch].phase] )
-        {
-          var[ch].state = STATE_TRANSIT;              /* end state Delay     */
-          var[ch].secCount = 0;
-        }
-      }
-    }
-    else /* so, state must be TRANSIT */
-    {
-      transits = true;                                /* drives LED_builtin  */
-      
-      if( var[ch].msCount > var[ch].msPerStep )
-      {
-        var[ch].msCount = 0;
-        if( var[ch].dcCur == var[ch].dc[var[ch].phase] )
-        { 
-          var[ch].state = STATE_STEADY;               /* dc transit complete */
-          
-          switch( var[ch].mode )                      /* trigger a new phase */
-          {
-            case MODE_NIGHT010 :
-              if( nightSw == NIGHTSW_NIGHT )
-              {
-                var[ch].phase = ! var[ch].phase;
-                var[ch].state = STATE_DELAY;
-              }
-              break;
-            case MODE_DAY010 :
-              if( nightSw == NIGHTSW_DAY )
-              {
-                var[ch].phase = ! var[ch].phase;
-                var[ch].state = STATE_DELAY;
-              }
-              break;
-            case MODE_DUSK :
-              if( var[ch].phase == 1 )
-              {
-                var[ch].phase = 0;
-                var[ch].state = STATE_DELAY;                  
-              }
-              break;
-            case MODE_DAWN :
-              if( var[ch].phase == 1  )
-              {
-                var[ch].phase = 0;
-                var[ch].state = STATE_DELAY;                  
-              }
-              break;
-            case MODE_DUSKDAWN :
-              if( var[ch].phase == 1 )
-              {
-                var[ch].phase = 0;
-                var[ch].state = STATE_DELAY;
-              }
-              break;  
-            case MODE_DAYNIGHT : 
-              break;
-          }
-        }
-        else  /* in Transit & current DC is GT or LT target DC */
-        {
-          if( var[ch].dcCur > var[ch].dc[var[ch].phase] )   /*   which?      */
-          {
-            var[ch].dcCur--;                              /* GT so decrement */ 
-          }
-          else
-          {
-            var[ch].dcCur++;                              /* LT so increment */
-          }
-          analogWrite( PWMPIN[ch], GAMMA8[var[ch].dcCur] );    /* set new dc */
-        }
-      }
-    }
+    calAbort();                       /* fault holds PWM, chan lit is short  */
+  }
+  else if( calBusy() == true )
+  {
+    calRun( PWR->getmA() );           /* 1 reading or step, see CAL.h        */
+  }
+  else
+  {
+    calCheck( PWR->getmA() );         /* live open string check              */
+    snapCheck();                      /* settled chans to EEPROM, see SNAP.h */
+  }
+  if( limUpdate( PWR->getmA() ) == true )  /* soft limit started or ended   */
+  {
+    limStat_t ls;
+    limGet( ls );
+    logPut( ls.scale == PWM_SCALE1 ? LOG_LIMITEND : LOG_LIMIT,
+            ls.planMA >> 8, ls.planMA & 0xFF, ls.scale );
   }
 }
 
 
-/*-------------------------------------------- startNewPhase() ---------------
- * 
- * The day/night input has changed, so setup new phase for each channel 
+/*--------------------------------------------------- taskLog() ---------------
+ *
+ * Serial out. A telemetry record when due, then 1 log record. Each only if
+ *  Serial has room, see TELE.h and LOG.h
 */
 
-void startNewPhase()
+void taskLog()
 {
-  stopISR = true;         /* all variables here are also manipulated by ISR  */
-  digitalWrite( PINLEDORA, nightSw );
-
-  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )   /* loop all channels */
+  if( teleDue() == true && Serial.availableForWrite() >= TELE_MAX )
   {
-    var[ch].secCount = 0;          /* reset counters                         */
-    var[ch].msCount = 0;
-    var[ch].state = STATE_TRANSIT; /* default values, some updated by switch */
-    var[ch].phase = 0;             /* this allows DC to transit back to DC0  */
+    teleRec_t rec;
+    uint8_t   buf[TELE_MAX];
 
-    switch( var[ch].mode )
-    {
-      case MODE_DAYNIGHT :         /* either input edge starts MODE_DAYNIGHT */
-        var[ch].state = STATE_DELAY;
-        var[ch].phase = nightSw;   /* phase 0 = 0 (day), phase 1 = 1 (night) */
-        break;
-      case MODE_DUSK :             /* day to night starts dusk               */
-        if( nightSw == NIGHTSW_NIGHT )
-        {
-          var[ch].state = STATE_DELAY;
-          var[ch].phase = 1;
-        }
-        break;
-      case MODE_DAWN :             /* night to day starts dawn               */
-        if( nightSw == NIGHTSW_DAY )
-        {
-          var[ch].state = STATE_DELAY;
-          var[ch].phase = 1;
-        }
-        break;
-      case MODE_DUSKDAWN :         /* either input edge starts DUSKDAWN      */
-        var[ch].state = STATE_DELAY;
-        var[ch].phase = 1;
-        break;
-      case MODE_NIGHT010 :         /* day to night starts NIGHT010           */
-        if( nightSw == NIGHTSW_NIGHT )
-        {
-          var[ch].state = STATE_DELAY;
-          var[ch].phase = 1;
-        }
-        break;
-      case MODE_DAY010 :           /* night to day starts DAY010             */
-        if( nightSw == NIGHTSW_DAY )
-        {
-          var[ch].state = STATE_DELAY;
-          var[ch].phase = 1;
-        }
-        break;
-    }
-  }                /* end ch loop */
-  stopISR = false;
+    teleSample( rec, PWR->getmA() );
+    Serial.write( buf, teleEncode( rec, buf ) );
+  }
+  SerialMon.drainLog();
 }
 
 
+void taskKeys()                       /* Serial Monitor key commands         */
+{
+  SerialMon.processKeyBoard();
+}
+
+
+/*--------------------------------------------------- foreground() ------------
+ *
+ * timer1 ISR, every 1 ms. Channel engine, then the sounder. A synced node
+ *  now and then runs the engine twice or not at all, see SYNC.h
+ * The tone is Timer3 interrupts, 3.9 kHz. The tick only turns it on or
+ *  off, see AWD.h
+*/
+
+void foreground()
+{
+  for( uint8_t n = syncTicks(); n != 0; n-- )  /* 1, or 0 or 2 to slip      */
+  {
+    processChannels();
+  }
+
+  awdSound( awdOn == true && muteAlarm == false );
+}
+
 
 /*--------------------------------------------------- setup() -----------------
  *
@@ -386,105 +373,93 @@ void setup()
   PWR = new Power();                               /* PWR is global pointer */
   
   setupPins();
+  awdBegin();                                   /* sounder quiet, Timer3    */
+  senseBegin();                                 /* ADC free runs from now   */
   noCAN = ! digitalRead( PINCAN );
 
+  setupEEPROM();                                /* NVs, scenes, curves, snap */
+  initChannels();
+  bool warm = snapRestore();                    /* saved dc, phase & NightSw */
+  seedChannels( micros() ^ senseFilt( SENSE_AMP ) ); /* ADC jitter          */
+  setupChannels();
+  setAllPWM( PWM_RESTORE );                     /* chans lit, before CAN    */
+
   Serial.begin( 115200 );
   SerialMon.about( '_' );
+  Serial << ( warm ? " warm start, snapshot " : " cold start, snapshot " )
+         << snapSeq() << endl;
+  const char * const NVBLOB[] { " NVs ok", " NVs moved to this layout",
+                                " !NVs bad crc, factory reset" };
+  Serial << NVBLOB[nvBlob] << endl;
   
-  PWR->alarm( 250 );                            /* test sounder for 0.25 s  */
-
   if( ( config.readEEPROM( 0 ) > 2 ) ||         /* invalid SLiM/FLiM        */
       ( config.readEEPROM( 1 ) > 127 ) )        /* invalid CANID            */
-  {  /* EEPROM map 0=SLiM/FLiM, 1=CANID, 2/3=NNhi&lo, 5=reset, 6-9=reserved */
+  {  /* EEPROM map 0=SLiM/FLiM, 1=CANID, 2/3=NNhi&lo, 5=reset, 6-8=NV blob */
     Serial << "!Invalid EEPROM contents." << endl;
   }
 
   setupCBUS();  
 
   INPUT_SW.setPin( PINNIGHTSW, LOW );
-  
-  setupChannels();
+  setupTasks();
   
   SerialMon.variables();
   
-  Timer1.initialize( 1000 );                   /* T1 runs at 1000 us (1 ms) */
-  Timer1.attachInterrupt( processChannels );   /* T1 ISR is Foreground task */
+  if( QTY_BAMCHAN == 0 )
+  {
+    Timer1.initialize( 1000 );                 /* T1 runs at 1000 us (1 ms) */
+    Timer1.attachInterrupt( foreground );      /* T1 ISR is Foreground task */
+  }
+  else
+  {
+    bamBegin( foreground );                    /* T1 BAM slots, 1 ms tick   */
+  }
+
+  PWR->alarm( 250 );                  /* test sounder for 0.25 s, from tick */
 
   Serial << " debug=" << debug << " mute=" << muteAlarm;
-  PWR->isOverAmp();
   PWR->printAmps();
+  usLoop = micros();
 }
 
 
-/*---------------------------------------- setupChannels() -------------------
+/*-------------------------------------------- setupEEPROM() ---------------
  * 
- * set channel variables from channel NVs and set the PWM
+ *  called by setup(), first. NVs, events, scenes, mA curves, snapshot, sync
+ *  master and programs, all the chans need, without waiting on CAN.
 */
 
-void setupChannels()
+void setupEEPROM()
 {
-  ADRNV NV;  /* lookup NV for chan, phase and datatype  */
- 
-  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )      /* loop through channels   */
-  {
-    var[ch].dc[0]       = config.readNV( NV.dc( ch, 0 ) );
-    var[ch].dc[1]       = config.readNV( NV.dc( ch, 1 ) );
-    var[ch].secDelay[0] = config.readNV( NV.dly( ch, 0 ) );
-    var[ch].secDelay[1] = config.readNV( NV.dly( ch, 1 ) );
-    var[ch].secTrans    = config.readNV( NV.tran( ch ) );
-    var[ch].mode        = (MODE_t) config.readNV( NV.mode( ch ) );
-    if( var[ch].mode >= QTY_MODE )
-    {
-      Serial << "!bad mode " << var[ch].mode << " Reset ch" << ch+1 << endl;
-      var[ch].mode = MODE_DAYNIGHT;
-    }
-                                /* calculate ms/step rate of change value   */
-    if( var[ch].secTrans == 0 ) /* zero seconds transit is special          */
-    { 
-      var[ch].msPerStep = 1;    /* dc transits rapidly to target duty cycle */
-    }
-    else                        /* non-zero transit secs, calc ms per step  */
-    {
-      uint16_t diff = abs( var[ch].dc[0] - var[ch].dc[1] );
-
-      if( diff < 4 )            /* diff under 4, makes msPerStep >65k error */
-      {                         /* Its a pointless difference, so ...       */
-        var[ch].msPerStep = 9;  /* Set to arbitary rate and dc levels.      */
-        var[ch].dc[0] = 90;
-        var[ch].dc[1] = 170;
-        Serial << endl << "!DC diff < 4 Reset ch" << ch +1 << endl;
-      }
-      else /* calculate number of milliseconds per step */
-      {
-        var[ch].msPerStep = ( var[ch].secTrans * 1000UL ) / diff;
-      }
-    }
-    var[ch].dcCur = DC_MID;           /* */
-    var[ch].state = STATE_STEADY;     /* */
-    var[ch].phase = 0;                /* */
-
-    analogWrite( PWMPIN[ch], var[ch].dcCur );
-  }
-  startNewPhase();
+  config.setEEPROMtype( EEPROM_INTERNAL );
+  config.EE_NVS_START = 10;                /*  as good a place as anywhere.. */
+  config.EE_NUM_NVS = QTY_NV;              /*     setDefaultNVs uses this    */
+  config.EE_EVENTS_START = ( config.EE_NVS_START + QTY_NV );
+  config.EE_MAX_EVENTS = QTY_EVENT;
+  config.EE_NUM_EVS = 1;
+  config.EE_BYTES_PER_EVENT = ( config.EE_NUM_EVS + 4 );
+  config.begin();
+  nvBlob = cacheBegin( { 6, config.EE_NVS_START, config.EE_EVENTS_START,
+                         config.EE_BYTES_PER_EVENT } ); /* checked, to RAM  */
+  uint16_t ee = config.EE_EVENTS_START + QTY_EVENT * config.EE_BYTES_PER_EVENT;
+  sceneBegin( ee );                              /* scenes after events     */
+  ee += QTY_SCENE * SCENE_BYTES;
+  calBegin( ee );                                /* then chan mA curves     */
+  ee += CAL_BYTES;
+  snapBegin( ee );                               /* then snapshot slots     */
+  ee += SNAP_SLOTS * SNAP_BYTES;
+  syncBegin( ee );                               /* then sync master byte   */
+  seqBegin( ee + 1 );                            /* then program image      */
 }
 
 
 /*-------------------------------------------- setupCBUS() -----------------
  * 
- *  called by setup()
+ *  called by setup(), after setupEEPROM(). CAN is started by canStart()
 */
 
 void setupCBUS()
 {
-  config.setEEPROMtype( EEPROM_INTERNAL );
-  config.EE_NVS_START = 10;                /*  as good a place as anywhere.. */
-  config.EE_NUM_NVS = QTY_NV;              /*     setDefaultNVs uses this    */
-  config.EE_EVENTS_START = ( config.EE_NVS_START + QTY_NV );
-  config.EE_MAX_EVENTS = QTY_EVENT;
-  config.EE_NUM_EVS = 1;
-  config.EE_BYTES_PER_EVENT = ( config.EE_NUM_EVS + 4 );
-  config.begin();
- 
   params[0] = 20;                     /* Number of parameters               */
   params[1] = MANU_MERG;              /* Manufacturer ID                    */
   params[2] = VER_MINOR;              /* minor version                      */
@@ -539,39 +514,61 @@ void setupCBUS()
   }
   else
   {
-    while( CBUS.begin() == false )
-    {
-      Serial << " ErrFlg 0x" << _HEX( CBUS.canp->errorFlagRegister() ) << endl;
-      PWR->alarm( 250 );
-    }
-    SerialMon.cbusState();
-    SerialMon.storedEvents();
-    sendEvent( ONOFF_ON, EN_POWERON );
+    canStart();                           /* first try, then from loop()     */
+  }
+}
+
+
+/*-------------------------------------------- canStart() ------------------
+ * 
+ *  try CBUS.begin(), from setupCBUS() then each loop() till it is up. A
+ *  fail waits 250 ms, doubling to 8 s, and does not block. Chans run from
+ *  their restored state meanwhile, CAN events wait for it.
+*/
+
+void canStart()
+{
+  static uint32_t msTry { 0 };        /* millis() of last try                */
+  static uint16_t msWait { 0 };       /* ms before next try                  */
+  static uint16_t tries { 0 };
+
+  if( millis() - msTry < msWait )
+  {
+    return;
   }
+  msTry = millis();
+  tries++;
+  if( CBUS.begin() == false )
+  {
+    logPut( LOG_CANDOWN, CBUS.canp->errorFlagRegister() );
+    digitalWrite( PINLEDRED, HIGH );
+    msWait = ( msWait == 0 ? 250 : msWait < 8000 ? msWait * 2 : 8000 );
+    return;
+  }
+  canUp = true;
+  logPut( LOG_CANUP, tries );
+  if( PWR->getState() == PWRST_OK && awdOn == false )
+  {
+    digitalWrite( PINLEDRED, LOW );
+  }
+  SerialMon.cbusState();
+  SerialMon.storedEvents();
+  sendEvent( ONOFF_ON, EN_POWERON );
 }
 
 
 /*------------------------------------------ Power::alarm() -----------------
  * 
  * Sound Audio Warning Device piezo buzzer for n milli seconds.
- * Timers are all used up, but this can be done OK in a loop.
+ * Returns at once. foreground() starts the tone, testAmpAndVolt() ends it.
 */
 
 void Power::alarm( uint16_t duration_ms )
 {
   digitalWrite( PINLEDRED, HIGH );
-  SerialMon.processKeyBoard();
-  uint16_t loopCount = duration_ms * 4;
-     
-  for( uint16_t k = 0; k < loopCount; k++ )
-  {
-    if( muteAlarm == false )
-    {                                   /* 4 kHz, cycle high or low, 125 us  */
-      digitalWrite( PINAWDSIG, k & 1 ); /* LSB of k, even-odd-even, 0-1-0... */
-      delayMicroseconds( 121 );         /* 121 allows for overheads in loop  */
-    }
-  }
-  digitalWrite( PINLEDRED, LOW );
+  msAlarm = millis();
+  alarmLen = duration_ms;
+  awdOn = true;
 }
 
 
@@ -582,178 +579,186 @@ void Power::alarm( uint16_t duration_ms )
 
 bool Power::isUnderVolt()
 {
-  return ( analogRead( PINBLUE ) < 1022 ); 
+  volts = senseFilt( SENSE_VOLT );
+  return debounce( volts < MINVOLTADCREAD, voltUnder, msVoltUnder ); 
 }
 
 
 /*---------------------------------- Power::isOverAmp() ----------------------
  * 
- * Read Volts on sense resistor to measure Amps, return true if over Amp
+ * Filtered Volts on sense resistor measures Amps, return true if over Amp
 */
 
 bool Power::isOverAmp()
 {
-  amps = analogRead( PINSENSE );
-  return ( amps > MAXAMPADCREAD );
+  amps = senseFilt( SENSE_AMP );
+  return debounce( amps > MAXAMPADCREAD, ampOver, msAmpOver );
 }
 
 
-/*---------------------------------- Power::printAmps() ----------------------
+/*---------------------------------- Power::debounce() -----------------------
  * 
- * prints, approx, measured mA to Serial
- * displays as multiples of 22 mA   ## anything below that shows as zero ##
+ * true once 'bad' is seen on checks at least TRIPMS apart, with no good
+ *  check between. One noisy loop() can not trip a fault.
 */
 
-void Power::printAmps()
+bool Power::debounce( bool bad, bool & was, uint32_t & since )
 {
-  Serial << " Amp=" << ( amps * AMPCALIBRATE ) << "mA" << endl;
+  uint32_t ms = millis();
+
+  if( bad == false )
+  {
+    was = false;
+    return false;
+  }
+  if( was == false )
+  {
+    was = true;
+    since = ms;
+  }
+  return ( ms - since >= TRIPMS );
 }
 
 
-/*-------------------------------------- Power::testAmpAndVolt() -------------
+/*---------------------------------- Power::printAmps() ----------------------
  * 
- * If under Volt (poly fuse?) or over current then alarm & reduce duty cycles.
+ * prints, approx, filtered and peak mA to Serial. Peak is since last print
+ * displays as multiples of 22 mA   ## anything below that shows as zero ##
+ * then the soft limiter plan and scale, see LIMIT.h
 */
 
-void Power::testAmpAndVolt()
-{  
-  if( isOverAmp() == true || isUnderVolt() == true )
-  {
-    stopISR = true;                   /* stop ISR as this code overides DC  */
-    digitalWrite( PINLEDRED, HIGH );
-    sendEvent( ONOFF_ON, EN_ALARM );
-    
-    setAllPWM( PWM_OFF );
-    Serial << "! OverAmp/UnderVolt";
-    printAmps();
-    do
-    {
-      alarm( 250 ); /* sound AWD for n milli secs */
-    }
-    while( isOverAmp() == true || isUnderVolt() == true );
-    
-    setAllPWM( PWM_RESTORE );
-    stopISR = false;
-    sendEvent( ONOFF_OFF, EN_ALARM );
-  }
+void Power::printAmps()
+{
+  senseStat_t st;
+
+  senseStats( SENSE_AMP, st );
+  Serial << " Amp=" << ( st.filt * AMPCALIBRATE ) << "mA peak="
+         << ( st.peak * AMPCALIBRATE ) << "mA min=" << ( st.min * AMPCALIBRATE )
+         << "mA avg=" << ( st.avg * AMPCALIBRATE ) << "mA Vblue="
+         << senseFilt( SENSE_VOLT ) << endl;
+
+  limStat_t ls;
+  limGet( ls );
+  Serial << " Limit plan=" << ls.planMA << "mA budget=" << ls.budgetMA
+         << "mA scale=" << ls.scale << "/128 trim=" << ls.trim << "/128 limits="
+         << ls.limits << endl;
 }
 
 
-/*----------------------------- setAllPWM() --------------------------
+/*---------------------------------- Power::logFault() ----------------------
  * 
- * set all PWM channel duty cycles to zero or reset to old values
+ * queue the fault record, filtered and peak mA. printAmps() would wait on
+ *  Serial, so the fault path logs instead.
 */
 
-void setAllPWM( PWM_t flag )
+void Power::logFault()
 {
-  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
-  {
-    analogWrite( PWMPIN[ch], (flag == PWM_OFF ? 0 : GAMMA8[var[ch].dcCur] ) );
-  }
+  senseStat_t st;
+
+  senseStats( SENSE_AMP, st );
+  uint16_t mA = st.filt * AMPCALIBRATE;
+  uint16_t peak = st.peak * AMPCALIBRATE;
+  logPut( LOG_FAULT, mA >> 8, mA & 0xFF, peak >> 8, peak & 0xFF );
 }
 
 
-/*---------------------------------------- eventHandler() -------------------
+/*-------------------------------------- Power::testAmpAndVolt() -------------
  * 
- * event process function called from CBUS library when learned event is rx
+ * If under Volt (poly fuse?) or over current then alarm & hold PWM off.
+ * The soft limiter keeps the LEDs under LIM_BUDGETMA, so an over Amp trip
+ *  is the last resort. EG. a shorted chan or a low mA figure. See LIMIT.h
+ * One step of the fault state per call, so loop() keeps running CBUS,
+ *  the Serial Monitor and NightSw all through a fault.
+ *
+ *  OK      -> FAULT    fault seen. PWM held off, alarm event, sounder on.
+ *  FAULT   -> RECOVER  fault gone.
+ *  RECOVER -> FAULT    fault back, before RECOVERMS.
+ *  RECOVER -> OK       fault gone for RECOVERMS. PWM restored, sounder off.
 */
 
-void eventHandler( uint8_t idx, CANFrame *msg ) 
-{
-  PINTP_D30_HIGH;
-  
-  EVAL_t  evVal = (EVAL_t) config.getEventEVval( idx, 1 );
-  uint8_t opc = msg->data[0];
-  bool evOn = ( opc == OPC_ASON || opc == OPC_ACON );
-  
-  Serial << endl << "> Ev *O" << (evOn ? 'N' : 'F') <<" eVal=" << evVal << ' ';
-  
-  switch( evVal )
+void Power::testAmpAndVolt()
+{  
+  bool fault = ( isOverAmp() == true || isUnderVolt() == true );
+  uint32_t ms = millis();
+
+  switch( state )
   {
-    case EVAL_NIGHTSW:                 /* evVal is NightSw event */
-      Serial << sEVAL[EVAL_NIGHTSW];
-      if( nightSw != (NIGHTSW_t) evOn )
-      {
-        nightSw = (NIGHTSW_t) evOn;
-        swChange = true;                      /* flag to cause phase change */
-        Serial << sINPUT[evOn];
-      }
-      else
-      {
-        Serial << "ignore";
-      }
-      break;
-    case EVAL_SHUTDOWN:                /* evVal is Shutdown event */ 
-      Serial << sEVAL[EVAL_SHUTDOWN];
-      if( evCmd == EVAL_SHUTDOWN && evOn == false )
+    case PWRST_OK :
+      if( fault == true )
       {
-         evCmd = EVAL_NIGHTSW;              /* revert to normal operations  */
-         Serial << " end" << endl; 
-         setAllPWM( PWM_RESTORE );
-      }
-      else
-      {
-        if( evCmd != EVAL_SHUTDOWN && evOn == true )
+        pwmHold = true;               /* ISR keeps time, but no PWM writes  */
+        setAllPWM( PWM_OFF );
+        if( voltUnder == true && ms >= SNAP_BOOTMS )
         {
-          evCmd = EVAL_SHUTDOWN;            /* turn on shutdown             */
-          setAllPWM( PWM_OFF );
+          snapSave();                 /* rail going, LEDs off gives hold up */
         }
+        digitalWrite( PINLEDRED, HIGH );
+        awdOn = true;
+        alarmLen = 0;
+        sendEvent( ONOFF_ON, EN_ALARM );
+        logFault();
+        state = PWRST_FAULT;
       }
-      break;
-    case EVAL_TESTEND:                /* evVal is TestEnd event */ 
-      Serial << sEVAL[EVAL_TESTEND];
-      if( testCh == true )
+      else if( alarmLen != 0 && ms - msAlarm >= alarmLen )
       {
-        Serial << sEVAL[evCmd];
-        analogWrite( PWMPIN[( evCmd -1 )], var[( evCmd -1 )].dcCur );
-        evCmd = EVAL_NIGHTSW;
-        testCh = false;
+        alarmLen = 0;                 /* timed alarm() is done              */
+        awdOn = false;
+        digitalWrite( PINLEDRED, LOW );
       }
-      else
+      break;
+
+    case PWRST_FAULT :
+      if( fault == false )
       {
-        Serial << "ignore";
+        msClear = ms;
+        state = PWRST_RECOVER;
       }
-      break; 
-    default:                        /* evVal is test chX or invalid */ 
-      if( evVal > EVAL_TESTCH10 )
+      break;
+
+    case PWRST_RECOVER :
+      if( fault == true )
       {
-        Serial << "unknow!";
+        state = PWRST_FAULT;
       }
-      else /* therefore its a TestChX eval */
+      else if( ms - msClear >= RECOVERMS )
       {
-        if( evCmd != evVal && testCh == true )   
-        {
-          Serial << "end" << sEVAL[evCmd] << ' ' ;
-          analogWrite( PWMPIN[(evCmd -1)], var[(evCmd -1)].dcCur );          
-        }
-        testCh = true;
-        testDC = ( evOn ? (DC_MAX -1) : (DC_MIN +1) ); 
-        evCmd = evVal;
-        Serial << sEVAL[evVal] << " dc=" << testDC;
+        awdOn = false;
+        digitalWrite( PINLEDRED, LOW );
+        pwmHold = false;
+        setAllPWM( PWM_RESTORE );
+        sendEvent( ONOFF_OFF, EN_ALARM );
+        logPut( LOG_POWEROK );
+        state = PWRST_OK;
       }
+      break;
   }
-  Serial << endl;
+}
+
+
+/*---------------------------------------- eventHandler() -------------------
+ * 
+ * event process function called from CBUS library when learned event is rx.
+ *  The handling is evEvent(), see EVENT.h
+*/
+
+void eventHandler( uint8_t idx, CANFrame *msg ) 
+{
+  PINTP_D30_HIGH;
+  evEvent( idx, msg->data, msg->len );
   PINTP_D30_LOW;
 }
 
 
 /*--------------------------------- frameHandler() ----------------------------
  * 
- * CBUS frame processing called from the CBUS library for every CAN frame rx
+ * CBUS frame processing called from the CBUS library for every CAN frame rx.
+ *  The handling is evFrame(), see EVENT.h
 */
 
 void frameHandler( CANFrame *msg ) 
 {
   PINTP_D30_HIGH;
-  if( debug == true )     /* debug is toggled by serial monitor command */
-  {
-    Serial << "> rx len" << msg->len;
-    for( uint8_t i = 0; i < msg->len; i++ ) 
-    {
-      Serial << ' ' << _HEX( msg->data[i] );
-    }
-    Serial << endl;
-  }
+  evFrame( msg->data, msg->len, config.nodeNum );
   PINTP_D30_LOW;
 }
 
@@ -765,26 +770,175 @@ void frameHandler( CANFrame *msg )
 
 void sendEvent( ONOFF_t onOff, uint16_t en )
 {
-  if( config.FLiM == true && noCAN == false )
+  if( config.FLiM == true && canUp == true )
   {
     CANFrame msg;   /* create and initialise a message object */
-    msg.len = 5;
-    msg.data[0] = ( onOff == ONOFF_ON ? OPC_ACON : OPC_ACOF );
-    msg.data[1] = highByte( config.nodeNum );
-    msg.data[2] = lowByte( config.nodeNum );
-    msg.data[3] = highByte( en );
-    msg.data[4] = lowByte( en );
+    msg.len = evPack( msg.data, ( onOff == ONOFF_ON ? OPC_ACON : OPC_ACOF ),
+                      config.nodeNum, en );
     
     if( CBUS.sendMessage( &msg ) == false )
     {
-      Serial << endl << "! Error 0x" << _HEX( CBUS.canp->errorFlagRegister() );
+      logPut( LOG_TXERR, CBUS.canp->errorFlagRegister() );
     }
-    Serial << "< tx ACO" << (onOff == true ? "N n" : "F n") << config.nodeNum 
-           << " e" << en << (en >= QTY_EN ? "=?" : sEN[en]) << endl << endl;
+    logPut( LOG_TX, onOff, msg.data[1], msg.data[2], msg.data[3], msg.data[4] );
   }
 }
 
 
+/*--------------------------------------- sendSync() -------------------
+ * 
+ * Send the sync master's frame, ACON2 ticks or ACOF2 start tick, EN_SYNC
+*/
+
+void sendSync( bool start, uint16_t tick )
+{
+  if( config.FLiM == true && canUp == true )
+  {
+    CANFrame msg;
+    msg.len = evPack( msg.data, ( start ? OPC_ACOF2 : OPC_ACON2 ),
+                      config.nodeNum, EN_SYNC ) + 2;
+    msg.data[5] = highByte( tick );
+    msg.data[6] = lowByte( tick );
+
+    if( CBUS.sendMessage( &msg ) == false )
+    {
+      logPut( LOG_TXERR, CBUS.canp->errorFlagRegister() );
+    }
+  }
+}
+
+
+/*--------------------------------------- sendDiag() -------------------
+ * 
+ * Send 1 CBUS DGN reply to an RDGN, a loop() task. See PROF.h
+ *  DGN = NN, ServiceIndex, DiagCode, value hi, value lo
+*/
+
+void sendDiag()
+{
+  if( dgnLeft == 0 )
+  {
+    return;
+  }
+  if( config.FLiM == false || canUp == false )
+  {
+    dgnLeft = 0;
+    return;
+  }
+  CANFrame msg;
+
+  noInterrupts();                     /* ISR adds to PROF_ISR & PROF_EVENT   */
+  msg.len = evDiag( msg.data, config.nodeNum );
+  interrupts();
+
+  if( CBUS.sendMessage( &msg ) == false )
+  {
+    logPut( LOG_TXERR, CBUS.canp->errorFlagRegister() );
+    return;                           /* try again next pass                 */
+  }
+  dgnCode++;
+  dgnLeft--;
+}
+
+
+/*--------------------------------------- calibrate() ------------------
+ * 
+ * start chan current calibration, see CAL.h. Not in a Power fault, a chan
+ *  test or ShutDown, they own the PWM. False if not started.
+*/
+
+bool calibrate()
+{
+  if( PWR->getState() != PWRST_OK || evCmd != EVAL_NIGHTSW )
+  {
+    return false;
+  }
+  return calStart();
+}
+
+
+/*-------------------------------- SerMon::printTasks() ------------------------
+ *
+ * print the loop() task table, then reset it. See TASK.h
+*/
+
+void SerMon::printTasks()
+{
+  const uint8_t BSIZE { 64 };
+  char buf[BSIZE];
+  char per[6] { " pass" };
+
+  Serial << " task  period dl us     runs  mean   max  late  miss";
+  for( uint8_t t = 0; t < taskQty(); t++ )
+  {
+    taskStat_t s;
+    taskGet( t, s );
+    unsigned long mean = ( s.runs == 0 ? 0 : s.sumUs / s.runs );
+
+    if( s.periodMs != TASK_EVERY )
+    {
+      snprintf( per, sizeof( per ), "%5u", s.periodMs );
+    }
+    snprintf( buf, BSIZE, " %s  %s %5u %8lu %5lu %5u %5u %5u",
+      s.name, per, s.deadlineUs, (unsigned long) s.runs, mean, s.maxUs,
+      s.lateUs, s.misses );
+    Serial << endl << buf;
+  }
+  taskReset();
+  Serial << endl << " reset" << endl;
+}
+
+
+/*-------------------------------- SerMon::printProf() -------------------------
+ *
+ * print profiles, then reset them. ISR in us to 0.1, others in us.
+ *  hist shows b:count for buckets in use, b counts 2^b to 2^(b+1) - 1
+*/
+
+void SerMon::printProf()
+{
+  const char * const NAME[QTY_PROF] { " ISR us  ", " loop us ", " ev>PWM us" };
+  profStat_t st[QTY_PROF];
+
+  noInterrupts();                     /* ISR adds to PROF_ISR & PROF_EVENT   */
+  for( uint8_t p = 0; p < QTY_PROF; p++ )
+  {
+    profGet( (PROF_t) p, st[p] );
+  }
+  profReset();
+  interrupts();
+
+  for( uint8_t p = 0; p < QTY_PROF; p++ )
+  {
+    const profStat_t & s = st[p];
+    uint32_t mean = ( s.n == 0 ? 0 : s.sum / s.n );
+    uint8_t  div = ( p == PROF_ISR ? PROF_ISRDIV : 1 );
+
+    Serial << NAME[p] << " n=" << s.n;
+    if( p == PROF_ISR )
+    {
+      Serial << " min=" << s.min / div << '.' << s.min % div * 10 / div
+             << " mean=" << mean / div << '.' << mean % div * 10 / div
+             << " max=" << s.max / div << '.' << s.max % div * 10 / div;
+    }
+    else
+    {
+      Serial << " min=" << s.min << " mean=" << mean << " max=" << s.max;
+    }
+    Serial << endl << "  hist";
+    for( uint8_t b = 0; b < PROF_BUCKETS; b++ )
+    {
+      if( s.hist[b] != 0 )
+      {
+        Serial << ' ' << b << ':' << s.hist[b];
+      }
+    }
+    Serial << endl;
+  }
+  Serial << " reset" << endl;
+}
+
+
 /*-------------------------------- SerMon::about() -----------------------------
  *
  * print title, code version and serial monitor menu
@@ -795,12 +949,13 @@ void SerMon::about(char boot)
   Serial << endl << endl << boot << sTITLE
   << " v" << VER_MAJOR << VER_MINOR << " β" << VER_BETA << endl
 <<" : c=bus, e=ev, v=var, m=mem, A=Amp, T=tx, /=debug, *=mute, DN=DefNv, N=rdNv"
-  << endl;
+  << endl << " : b=binLog, S1-8=saveScene, P=profile, C=calibrate, L=tasks,"
+  " M=sync master," << endl << " : R0-9=telemetry rate" << endl;
 }
 
 /*----------------------------------- SerMon::cbusState() ---------------------
  *
- * print module CBUS state - NOCAN or SLiM/FLiM + CANID & NN
+ * print module CBUS state - NOCAN, CAN down or SLiM/FLiM + CANID & NN
 */
 
 void SerMon::cbusState()
@@ -809,12 +964,18 @@ void SerMon::cbusState()
   {
     Serial << " NoCAN" << endl;
   }
+  else if( canUp == false )
+  {
+    Serial << " CAN down, retrying" << endl;
+  }
   else
   {
     Serial << ( config.FLiM == true ? " FLiM" : " SLiM" )
      << " CANID=" << config.CANID << " NN=" << config.nodeNum << endl << ' ';
     CBUS.printStatus();
   }
+  Serial << " sync=" << sSYNCST[syncState()] << " trim=" << syncPPM()
+         << "ppm err=" << syncErr() << endl;
 }
 
 
@@ -825,23 +986,92 @@ void SerMon::cbusState()
 
 void SerMon::variables()
 {
-  const uint8_t BSIZE { 75 };
+  const uint8_t BSIZE { 96 };
   char buf[BSIZE];
   const char fmt[]
-    { " %2d  %3ds %5dms %3ds %3ds  %3d  %3d  %s   %d  %s  %3d %3ds" };
+    { " %2d  %3ds %5dms %3ds %3ds  %3d  %3d  %s  %d   %d  %s  %3d %3ds %4u %s" };
+  uint16_t model { calBaseMA() };
     
   Serial << " Vars. NightSw=" << sINPUT[nightSw] << " evCmd=" <<
-     sEVAL[evCmd] << endl <<
-     " ch Trans perStep Dly0 Dly1  DC0  DC1  mode   phase state dcCur count";
+     sEVAL[evCmd] << " ticksLost=" << ticksLost << " cfgSwaps=" << cfgSwaps
+     << " logDropped=" << logDropped << endl <<
+     " ch Trans perStep Dly0 Dly1  DC0  DC1  mode  gamma phase state dcCur count"
+     "   mA cal";
   for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
   {
+    const cfg_t & c = chanCfg( ch );
     snprintf( buf, BSIZE, fmt,
-      ch +1, var[ch].secTrans, var[ch].msPerStep, var[ch].secDelay[0],
-      var[ch].secDelay[1], var[ch].dc[0], var[ch].dc[1], sMODE[var[ch].mode],
-      var[ch].phase, sSTATE[var[ch].state], var[ch].dcCur, var[ch].secCount );
+      ch +1, c.secTrans, var[ch].msPerStep, c.secDelay[0],
+      c.secDelay[1], c.dc[0], c.dc[1],
+      ( c.mode < QTY_MODE ? sMODE[c.mode] : "Scene   " ), c.gamma,
+      var[ch].phase, sSTATE[var[ch].state], var[ch].dcCur, var[ch].secCount,
+      calEstMA( ch ), sCALST[calState( ch )] );
     Serial << endl << buf;
+    if( c.mode == MODE_SEQ )
+    {
+      Serial << " pc=" << chanSeqPc( ch );
+    }
+    model += calEstMA( ch );
   }
-  Serial << endl;
+  Serial << endl << " Amp=" << PWR->getmA() << "mA model=" << model
+         << "mA base=" << calBaseMA() << "mA" << endl;
+}
+
+
+/*----------------------------- SerMon::drainLog() ---------------------------
+ *
+ * write 1 queued log record, only if Serial can take it without waiting.
+ * A loop() task, so logging never holds up CBUS.process().
+*/
+
+void SerMon::drainLog()
+{
+  if( Serial.availableForWrite() < LOG_LINE + 2 )
+  {
+    return;                           /* Serial busy, try next run           */
+  }
+  logRec_t rec;
+
+  if( logPop( rec ) == true )
+  {
+    if( logBinary == true )
+    {
+      uint8_t bin[LOG_BIN];
+      Serial.write( bin, logEncode( rec, bin ) );
+    }
+    else
+    {
+      char line[LOG_LINE];
+      logFormat( rec, line, LOG_LINE );
+      Serial << line << endl;
+    }
+  }
+}
+
+
+/*----------------------------- SerMon::saveScene() ---------------------------
+ *
+ * save current chan DCs as scene n (0 - 7), with NV Transition secs and no
+ *  delay. Set the DCs with NVs, a scene or TestCh, then save.
+*/
+
+void SerMon::saveScene( uint8_t n )
+{
+  if( n >= QTY_SCENE )
+  {
+    Serial << " !scene 1-" << QTY_SCENE << endl;
+    return;
+  }
+  sceneChan_t sc[QTY_CHAN];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    sc[ch].dc = var[ch].dcCur;
+    sc[ch].secTrans = chanCfg( ch ).secTrans;
+    sc[ch].secDelay = 0;
+  }
+  sceneSave( n, sc );
+  Serial << " Scene" << n + 1 << " saved" << endl;
 }
 
 
@@ -852,12 +1082,16 @@ void SerMon::variables()
 
 void setDefaultNVs()
 {
+  uint8_t nvs[QTY_NV];
+
   for( uint8_t nv = 0; nv < QTY_NV; nv++ )
   {
-    config.writeNV( nv + 1, DEFAULTNV[nv] );
+    nvs[nv] = defaultNV( nv + 1 );
   }
+  uint8_t n = cacheSetNVs( nvs );     /* changed bytes only, EEPROM & RAM  */
   setupChannels();
-  Serial << " NVs Reset. In FCU, do Node>ReadNVs and save." << endl;
+  Serial << " NVs Reset, " << n << " written. In FCU, do Node>ReadNVs and save."
+         << endl;
 }
 
 
@@ -873,21 +1107,14 @@ void SerMon::storedEvents()
   
   for( uint8_t j = 0; j < config.EE_MAX_EVENTS; j++ )  /* each storedEvent   */
   {
-    if( config.getEvTableEntry( j ) != 0 )             /* is ev entry valid? */
+    evIdx_t ev;
+
+    if( cacheEvent( j, ev ) == true )                  /* is ev entry valid? */
     {
       count++;
-      uint8_t v[config.EE_BYTES_PER_EVENT];
-
-      for( uint8_t e = 0; e < ( config.EE_NUM_EVS + 4 ); e++ ) /* each event */
-      {
-        v[e] = config.readEEPROM(
-             config.EE_EVENTS_START + ( j * config.EE_BYTES_PER_EVENT ) + e );
-      };
-      uint8_t eval = config.getEventEVval( j, 1 );
-
-      Serial << ' ' << j << "  n" << ( v[0] * 256 ) + v[1]
-        << " e" << ( v[2] * 256 ) + v[3] << " \teVal=" << eval << ' '
-        << ( ( eval >= QTY_EVAL ) ? "!unknown" : sEVAL[eval] ) << endl;   
+      Serial << ' ' << j << "  n" << ev.nn << " e" << ev.en
+        << " \teVal=" << ev.ev << ' '
+        << ( ( ev.ev >= QTY_EVAL ) ? "!unknown" : sEVAL[ev.ev] ) << endl;   
     }
   }
   Serial << "   " << count << '/' << config.EE_MAX_EVENTS << endl;
@@ -901,18 +1128,57 @@ void SerMon::storedEvents()
 
 void SerMon::processKeyBoard() 
 {
+  static char prefix { 0 };           /* 'D' 'S' or 'R' waiting for 2nd key  */
+
   if( Serial.available() ) 
   {
-    switch( Serial.read() )   
+    char key = Serial.read();
+
+    if( prefix == 'D' )               /* Default Node variables. D plus N    */
     {
-      case 'D':                        /* Default Node variables. R plus N  */
-        while( Serial.available() == false ){};
-        if( Serial.read() == 'N' )
-        {
-          setDefaultNVs(); 
-        }
+      prefix = 0;
+      if( key == 'N' )
+      {
+        setDefaultNVs();
+      }
+      return;
+    }
+    if( prefix == 'S' )               /* Save chan DCs as Scene. S plus 1-8  */
+    {
+      prefix = 0;
+      SerialMon.saveScene( key - '1' );
+      return;
+    }
+    if( prefix == 'R' )               /* telemetry Rate. R plus 0-9, TELE.h  */
+    {
+      prefix = 0;
+      teleRate( key - '0' );
+      Serial << " tele=" << TELE_PERIODMS[teleRateNow()] << "ms" << endl;
+      return;
+    }
+    switch( key )   
+    {
+      case 'D':                       /* 2nd key on a later run, no wait     */
+      case 'S':
+      case 'R':
+        prefix = key;
+        break;
+      case 'L':                       /* print & reset loop() task table     */
+        SerialMon.printTasks();
+        break;
+      case 'P':                       /* print & reset latency profiles     */
+        SerialMon.printProf();
         break;
-      case 'A':                       /* print estimate LED Amps            */
+      case 'M':                       /* sync master toggle, see SYNC.h     */
+        syncSetMaster( syncState() != SYNCST_MASTER );
+        Serial << " sync=" << sSYNCST[syncState()] << endl;
+        break;
+      case 'C':                       /* chan current calibration, CAL.h    */
+        Serial << ( calibrate() ? " Calibrate, lights off 4 s" : " !busy" )
+               << endl;
+        break;
+      case 'A':                       /* print estimate LED Amps & state    */
+        Serial << " Power " << sPWRST[PWR->getState()];
         PWR->printAmps();
         break;
       case 'N':                       /* read NVs into vars                 */
@@ -928,7 +1194,10 @@ void SerMon::processKeyBoard()
         SerialMon.variables();
         break;
       case 'y':                       /* reset CAN bus & CBUS processing    */     
-        CBUS.reset();
+        if( canUp == true )
+        {
+          CBUS.reset();
+        }
         break;
       case 'm':
         Serial << " freeSRAM=" << config.freeSRAM() << endl;
@@ -943,6 +1212,10 @@ void SerMon::processKeyBoard()
         debug = ! debug;
         Serial << " debug=" << debug << endl;
         break;
+      case 'b':                       /* log binary toggle, see LOG.h       */
+        logBinary = ! logBinary;
+        Serial << " logBinary=" << logBinary << endl;
+        break;
       case '*':                       /* mute alarm toggle                  */
         muteAlarm = ! muteAlarm;
         Serial << " mute=" << muteAlarm << endl;
@@ -0,0 +1,1057 @@
+/*file: CHAN.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Channel engine. 1 ms foreground process and phase control. See CHAN.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include <string.h>
+
+#include "CHAN.h"
+#include "GAMMA.h"            /* Gamma correction tables                      */
+#include "EASE.h"             /* transition curve tables                      */
+#include "MODE.h"             /* mode transition table                        */
+#include "EFFECT.h"           /* effect mode waveform tables                  */
+#include "SEQ.h"              /* keyframe program bytecode                    */
+
+
+/*---------------------------- global variables ------------------------------*/
+
+volatile var_t var[QTY_CHAN];   /* channel status array. ISR modifies         */
+
+cfg_t   cfgBuf[2][QTY_CHAN];    /* channel config, from NVs. Double buffer    */
+volatile uint8_t cfgLive { 0 }; /* cfgBuf[] index the ISR is using            */
+
+volatile NIGHTSW_t  nightSw;     /* nightSw state 0 = DAY or 1 = NIGHT        */
+
+EVAL_t  evCmd  { EVAL_NIGHTSW }; /* the current event command                 */
+uint8_t testDC { 0 };            /* current duty cycle for test mode          */
+volatile bool pwmHold { false }; /* true = ISR makes no PWM writes            */
+volatile uint8_t pwmScale { PWM_SCALE1 }; /* soft limit, set by limUpdate()  */
+
+volatile uint16_t ticks { 0 };   /* 1 ms ISR ticks, the engine clock          */
+
+chanStat_t chanStat;             /* work counters. See CHAN_STATS             */
+uint16_t cfgSwaps { 0 };         /* config buffer swaps done by the ISR       */
+int32_t  ticksLost { 0 };        /* ms elapsed minus ISR ticks counted        */
+
+static volatile bool cfgReq   { false }; /* new config waiting in cfgBuf[]    */
+static volatile bool phaseReq { false }; /* new phase waiting to start        */
+static volatile uint16_t phaseTick { 0 }; /* ticks to start it at             */
+static volatile uint16_t ticksHeld { 0 }; /* ticks with time held, SHUTDOWN  */
+
+static const cfg_t * cfg { cfgBuf[0] }; /* ISR copy of cfgBuf[cfgLive]       */
+static bool sceneCfg { false };          /* cfgBuf[] holds a scene, not NVs   */
+
+static uint8_t seqBuf[2][SEQ_BYTES];     /* program image, pairs with cfgBuf  */
+static const uint8_t * code { seqBuf[0] }; /* ISR copy of seqBuf[cfgLive]    */
+static volatile bool seqFresh { false }; /* seqNext() filled the next image  */
+
+
+/*------------------------------ due queue ----------------------------------
+ *
+ * Channels not STEADY wait in dueQ[], sorted by their var[].due tick.
+ * The ISR only looks at the head, so idle channels cost nothing.
+*/
+
+static uint8_t dueQ[QTY_CHAN];   /* chan numbers, earliest due first          */
+static uint8_t dueLen { 0 };     /* qty of chans in dueQ                      */
+
+static uint8_t transitQty { 0 }; /* qty of chans in STATE_TRANSIT             */
+static bool    transitLED { false }; /* LED_BUILTIN last written state        */
+
+static EVAL_t  testCmd { EVAL_NIGHTSW }; /* evCmd as last seen by the ISR     */
+static uint8_t testChan { QTY_CHAN };    /* chan under test, QTY_CHAN = none  */
+static uint8_t testShown { 0 };          /* testDC as last written to PWM     */
+static uint16_t testLeft { 0 };          /* ticks left on frozen test chan    */
+
+const uint8_t STEPS_MIN { 32 };          /* min slices, keeps fades smooth    */
+const uint8_t TEST_SHIFT { PWM_BITS - 8 }; /* test DC is raw 8 bit PWM       */
+
+
+/* progress per slice, 65535 / steps, so startTransit() needs no divide */
+
+template< typename S > struct stepTab;
+
+template< int... I > struct stepTab< gammaSeq< I... > >
+{
+  static constexpr uint16_t tab[256] PROGMEM          /* in flash          */
+  {
+    (uint16_t) ( I < STEPS_MIN ? 0 : 65535U / I )...
+  };
+};
+
+template< int... I >
+constexpr uint16_t stepTab< gammaSeq< I... > >::tab[256];
+
+typedef stepTab< gammaMkSeq< 256 >::type > PROGSTEP;
+
+
+static void schedule( uint8_t ch )     /* insert chan into dueQ by due tick  */
+{
+  uint8_t i = dueLen++;
+
+  while( i > 0 && (int16_t)( var[dueQ[i - 1]].due - var[ch].due ) > 0 )
+  {
+    dueQ[i] = dueQ[i - 1];
+    i--;
+  }
+  dueQ[i] = ch;
+}
+
+
+static void unschedule( uint8_t ch )   /* remove chan from dueQ, if there    */
+{
+  uint8_t j = 0;
+
+  for( uint8_t i = 0; i < dueLen; i++ )
+  {
+    if( dueQ[i] != ch )
+    {
+      dueQ[j++] = dueQ[i];
+    }
+  }
+  dueLen = j;
+}
+
+
+static void showTransit( bool on )     /* LED_BUILTIN, only write on change  */
+{
+  if( on != transitLED )
+  {
+    transitLED = on;
+    halTransitLED( on );
+  }
+}
+
+
+static uint16_t pwmNext[QTY_CHAN];     /* PWM value to write at end of tick  */
+static chanBits_t pwmDirty { 0 };      /* bit per chan, pwmNext[] changed    */
+static uint8_t  scaleShown { PWM_SCALE1 }; /* pwmScale as last written      */
+
+static uint16_t scalePWM( uint16_t pwm )   /* soft limit, see LIMIT.h       */
+{
+  uint8_t s = scaleShown;
+
+  return ( s == PWM_SCALE1 ? pwm : (uint16_t)( ( (uint32_t) pwm * s ) >> 7 ) );
+}
+
+static void writePWM( uint8_t ch, uint16_t pwm )   /* mark chan dirty        */
+{
+  pwmNext[ch] = pwm;
+  pwmDirty |= ( (chanBits_t) 1 << ch );
+}
+
+
+static void flushPWM()            /* write dirty chans, unless Power holds */
+{
+  chanBits_t dirty = pwmDirty;
+
+  pwmDirty = 0;
+  if( pwmHold == true )
+  {
+    return;
+  }
+  for( uint8_t ch = 0; dirty != 0; ch++, dirty >>= 1 )
+  {
+    if( dirty & 1 )
+    {
+      halWritePWM( ch, scalePWM( pwmNext[ch] ) );
+    }
+  }
+}
+
+
+/*--------------------------------------------- rescale() -------------------
+ *
+ * pwmScale changed, so every chan is written again at its current dc.
+ *  Each PWM is worked out again, pwmNext[] may be an old gamma or test dc.
+ *  In SHUTDOWN the PWM stays off, setAllPWM() restores it at the new scale.
+*/
+
+static void rescale()
+{
+  scaleShown = pwmScale;
+  if( evCmd == EVAL_SHUTDOWN )
+  {
+    return;
+  }
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    writePWM( ch, ( ch == testChan ? testDC << TEST_SHIFT
+                                   : gammaLook( cfg[ch].gamma, var[ch].dcCur ) ) );
+  }
+}
+
+
+static uint16_t sliceTicks( uint8_t ch )  /* ms to next slice, spreads msRem */
+{
+  uint16_t err = var[ch].msErr + var[ch].msRem;
+  uint16_t ms = var[ch].msPerStep;
+
+  if( err >= var[ch].steps )
+  {
+    err -= var[ch].steps;
+    ms++;
+  }
+  var[ch].msErr = err;
+  return ms;
+}
+
+
+static uint8_t sliceDc( uint8_t ch, uint8_t to, uint8_t p ) /* p/256 of way */
+{
+  STAT_BRANCH;
+  if( cfg[ch].ease != EASE_LINEAR )
+  {
+    p = EASE[cfg[ch].ease - 1][p >> 2];
+  }
+  STAT_BRANCH;
+  if( to > var[ch].dcFrom )                       /* 8 x 8 bit multiply    */
+  {
+    return var[ch].dcFrom + ( ( (uint16_t)( to - var[ch].dcFrom ) * p ) >> 8 );
+  }
+  return var[ch].dcFrom - ( ( (uint16_t)( var[ch].dcFrom - to ) * p ) >> 8 );
+}
+
+
+/*---------------------------------------- startTransit() -------------------
+ *
+ * from the current dc to the phase dc. One slice per dc of the distance,
+ *  STEPS_MIN at least. ms per slice is ms * 65535 / steps from the table,
+ *  it may be up to 4 over, the loop trims it. No divide, all chans may
+ *  start in one tick.
+*/
+
+static void startTransit( uint8_t ch )
+{
+  uint8_t  to = cfg[ch].dc[var[ch].phase];
+  uint8_t  diff = ( to > var[ch].dcCur ? to - var[ch].dcCur
+                                       : var[ch].dcCur - to );
+  uint8_t  steps = ( diff < STEPS_MIN ? STEPS_MIN : diff );
+  uint16_t progStep = pgm_read_word( &PROGSTEP::tab[steps] );
+  uint32_t ms = cfg[ch].secTrans * 1000UL;
+  uint16_t perStep = 1;           /* zero seconds transit is 1 ms/slice    */
+  int32_t  rem = 0;
+
+  STAT_BRANCH;
+  if( ms != 0 )
+  {
+    perStep = ( ms * ( progStep + 1UL ) ) >> 16;   /* ms / steps, 0 - 4 over */
+    rem = ms - (uint32_t) perStep * steps;
+    while( rem < 0 )
+    {
+      STAT_BRANCH;
+      perStep--;
+      rem += steps;
+    }
+  }
+  var[ch].steps = steps;
+  var[ch].msPerStep = perStep;
+  var[ch].msRem = rem;
+  var[ch].progStep = progStep;
+  var[ch].dcFrom = var[ch].dcCur;
+  var[ch].step = 0;
+  var[ch].prog = 0;
+  var[ch].msErr = 0;
+  var[ch].due = ticks + sliceTicks( ch );
+}
+
+
+/*--------------------------------------------- testChange() -----------------
+ *
+ * evCmd changed. The chan under test is frozen, as it was when the ISR
+ *  skipped it. Its remaining ticks are held and restored when the test ends.
+*/
+
+static void testChange()
+{
+  if( testChan < QTY_CHAN && var[testChan].state != STATE_STEADY )
+  {
+    var[testChan].due = ticks + testLeft;   /* thaw the old test chan        */
+    schedule( testChan );
+  }
+  testCmd = evCmd;
+  testChan = QTY_CHAN;
+
+  if( testCmd >= EVAL_TESTCH1 && testCmd <= EVAL_TESTCH10 )
+  {
+    testChan = testCmd - 1;           /* cmd ch starts 1, ch starts at 0     */
+    if( var[testChan].state != STATE_STEADY )
+    {
+      unschedule( testChan );         /* freeze the new test chan            */
+      testLeft = var[testChan].due - ticks;
+    }
+    testShown = testDC;
+    writePWM( testChan, testDC << TEST_SHIFT );  /* test DC is 1 or 254    */
+  }
+}
+
+
+/*--------------------------------------------- rnd8() -----------------------
+ *
+ * xorshift 16 bit pseudo random. For NX_RAND delays, cheap enough for the ISR
+*/
+
+static uint16_t rndState { 0xACE1 };
+
+static uint8_t rnd8()
+{
+  rndState ^= rndState << 7;
+  rndState ^= rndState >> 9;
+  rndState ^= rndState << 8;
+  return rndState >> 8;
+}
+
+
+void seedChannels( uint16_t seed )      /* zero would stick at zero         */
+{
+  rndState = ( seed == 0 ? 0xACE1 : seed );
+}
+
+
+/* program state, MODE_SEQ. var[] dcFrom, step & msErr are the ramp or
+ *  hold, as a transit. Only the ISR modifies.
+*/
+struct seqVar_t
+{
+  uint8_t   pc;           /* op running or next to start, code[] index       */
+  uint8_t   loops;        /* SEQ_LOOP jumps done                             */
+  uint8_t   to;           /* ramp target dc, a hold's own dc                 */
+  uint8_t   bits;         /* ramp is 2^bits slices                           */
+  uint8_t   slices;       /* 2^bits, 0 if no ramp or hold running            */
+  uint8_t   rem;          /* ms to spread over the slices                    */
+  uint8_t   len;          /* bytes of the op running                         */
+  uint16_t  ms;           /* ms per slice, whole part                        */
+};
+
+static seqVar_t sv[QTY_CHAN];
+
+
+static uint16_t seqSlice( uint8_t ch )  /* ms to next slice, as sliceTicks() */
+{
+  uint8_t  err = var[ch].msErr + sv[ch].rem;
+  uint16_t ms = sv[ch].ms;
+
+  if( err >= sv[ch].slices )
+  {
+    err -= sv[ch].slices;
+    ms++;
+  }
+  var[ch].msErr = err;
+  return ms;
+}
+
+
+/*--------------------------------------------- nextState() ------------------
+ *
+ * set chan state & phase from a MODENEXT[] entry, see MODE.h
+ * Starts the transit or the delay. A STEADY chan needs nothing more.
+*/
+
+static void nextState( uint8_t ch, uint8_t nx )
+{
+  uint8_t phase = nx & 1;
+  STATE_t state = (STATE_t) ( ( nx >> 1 ) & 3 );
+
+  var[ch].phase = phase;
+  var[ch].secCount = 0;
+
+  STAT_BRANCH;
+  if( ( nx & NX_NOW ) != 0 && cfg[ch].secDelay[phase] == 0 )
+  {
+    state = STATE_TRANSIT;              /* no delay, transit in this tick   */
+  }
+  var[ch].state = state;
+
+  STAT_BRANCH;
+  if( state == STATE_TRANSIT )
+  {
+    transitQty++;
+    startTransit( ch );
+  }
+  else if( state == STATE_DELAY )
+  {
+    STAT_BRANCH;
+    if( ( nx & NX_RAND ) != 0 )         /* count starts part way, 8x8 mul   */
+    {
+      var[ch].secCount = ( rnd8() * ( cfg[ch].secDelay[phase] + 1U ) ) >> 8;
+    }
+    var[ch].due = ticks + 1000;
+  }
+  else if( state == STATE_EFFECT )
+  {
+    var[ch].step = 0;                   /* effect starts on the next tick   */
+    var[ch].due = ticks + 1;
+    sv[ch].slices = 0;                  /* a program starts the op at pc    */
+  }
+}
+
+
+/*--------------------------------------------- seqStart() -----------------
+ *
+ * start the op at pc, MODE_SEQ. dc is the chan dc so far. Returns ms to the
+ *  next call, 1 for an op with no time. END, or a WAIT not yet so, makes
+ *  the chan STEADY. A hold is a ramp to the dc it has. See SEQ.h
+*/
+
+static uint16_t seqTimed( uint8_t ch, uint8_t dc, uint8_t to, uint8_t opc,
+                          const uint8_t * t, uint8_t len )  /* ramp or hold */
+{
+  seqVar_t & s = sv[ch];
+  uint16_t ms = t[0] | ( t[1] << 8 );
+
+  var[ch].dcFrom = dc;
+  var[ch].step = 0;
+  var[ch].msErr = 0;
+  s.to = to;
+  s.bits = opc & 0x07;
+  s.slices = 1U << s.bits;
+  s.ms = ms + ( ms == 0 );              /* 1 ms at least, never due now     */
+  s.rem = t[2];
+  s.len = len;
+  return seqSlice( ch );
+}
+
+
+static uint16_t seqStart( uint8_t ch, uint8_t & dc )
+{
+  seqVar_t & s = sv[ch];
+  const uint8_t * op = &code[s.pc];
+  uint8_t opc = ( s.pc <= SEQ_BYTES - 1 - SEQ_OPMAX ? op[0] : SEQ_END );
+
+  STAT_BRANCH;
+  switch( opc & 0xF0 )
+  {
+    case SEQ_RAMP :
+      return seqTimed( ch, dc, op[1], opc, &op[2], SEQ_OPMAX );
+    case SEQ_HOLD :
+      return seqTimed( ch, dc, dc, opc, &op[1], SEQ_OPMAX - 1 );
+    case SEQ_SET :
+      dc = op[1];
+      s.pc += 2;
+      break;
+    case SEQ_WAIT :
+      STAT_BRANCH;
+      if( ( opc & 1 ) != nightSw )
+      {
+        var[ch].state = STATE_STEADY;   /* newPhase() starts it again       */
+        return 0;
+      }
+      s.pc++;
+      break;
+    case SEQ_LOOP :
+      STAT_BRANCH;
+      if( s.loops < (uint8_t)( op[1] - 1 ) )      /* count 0, for ever     */
+      {
+        s.loops += ( op[1] != 0 );
+        s.pc = op[2];
+      }
+      else
+      {
+        s.loops = 0;
+        s.pc += 3;
+      }
+      break;
+    default :                           /* SEQ_END, or not an op            */
+      var[ch].state = STATE_STEADY;
+      return 0;
+  }
+  return 1;
+}
+
+
+/*--------------------------------------------- seqStep() --------------------
+ *
+ * 1 call of a chan's program, MODE_SEQ. Sets the chan dc, returns ms to the
+ *  next call. A slice of a ramp or hold, as a transit slice, else the op
+ *  at pc ends and the next starts. 1 op a call, so a call costs no more
+ *  than a transit slice and a bad program can not hang the ISR.
+*/
+
+static uint16_t seqStep( uint8_t ch, uint8_t & dc )
+{
+  seqVar_t & s = sv[ch];
+
+  dc = var[ch].dcCur;
+  STAT_BRANCH;
+  if( ++var[ch].step < s.slices )
+  {
+    dc = sliceDc( ch, s.to, var[ch].step << ( 8 - s.bits ) );
+    return seqSlice( ch );
+  }
+  STAT_BRANCH;
+  if( s.slices != 0 )                             /* last slice, exact     */
+  {
+    dc = s.to;
+    s.pc += s.len;
+    s.slices = 0;
+  }
+  return seqStart( ch, dc );
+}
+
+
+/*--------------------------------------------- effectStep() -----------------
+ *
+ * 1 step of an effect mode. Sets the chan dc, returns ms to the next step.
+ * Same cost every call, 1 rnd8() and a table read. See EFFECT.h. SEQ runs
+ *  as an effect, its program steps here, see seqStep()
+ *  step     FIRE table index, STROBE flash index, FLICKER toggles
+ *  secCount FLICKER & ARC steps left in the burst, 0 = steady or pause
+*/
+
+static uint16_t effectStep( uint8_t ch, uint8_t & dc )
+{
+  uint8_t  level = cfg[ch].dc[1];
+  uint8_t  rate = cfg[ch].secDelay[0];
+  uint8_t  r;
+  uint16_t ms;
+
+  STAT_BRANCH;
+  switch( cfg[ch].mode )
+  {
+    case MODE_SEQ :                     /* keyframe program, see SEQ.h       */
+      return seqStep( ch, dc );
+    case MODE_FLICKER :                 /* tube, steady then a burst        */
+      r = rnd8();
+      if( var[ch].secCount == 0 )
+      {
+        var[ch].secCount = 2 + ( r & 0x0E );        /* even, ends on level  */
+        dc = level;
+        ms = 64 + ( ( r * ( rate + 1U ) ) >> 2 );
+      }
+      else
+      {
+        var[ch].secCount--;
+        dc = ( var[ch].secCount & 1 ? level >> 2 : level );
+        ms = 15 + ( r & 0x3F );
+      }
+      break;
+    case MODE_FIRE :                    /* glow wave, random flare           */
+      r = rnd8();
+      var[ch].step = ( var[ch].step + 1 + ( r & 3 ) ) & 63;
+      dc = ( level * (uint16_t)( FIRE[var[ch].step] - ( r >> 3 ) ) ) >> 8;
+      ms = 16 + ( rate >> 2 );
+      break;
+    case MODE_ARC :                     /* weld bursts, dark pause           */
+      r = rnd8();
+      if( var[ch].secCount == 0 )
+      {
+        var[ch].secCount = 20 + ( r & 0x3F );
+        dc = 0;
+        ms = 200 + ( ( rnd8() * ( rate + 1U ) ) >> 3 );
+      }
+      else
+      {
+        var[ch].secCount--;
+        dc = ( r & 0x80 ? level : ( level * ( r & 0x7F ) ) >> 7 );
+        ms = 8 + ( r & 0x1F );
+      }
+      break;
+    default :                           /* MODE_STROBE, no rnd8() needed     */
+      var[ch].step = ( var[ch].step + 1 ) & ( QTY_STROBE - 1 );
+      dc = ( var[ch].step & 1 ? 0 : level );
+      ms = ( var[ch].step == QTY_STROBE - 1 ? 100 + rate * 10U
+                                            : STROBE[var[ch].step] );
+      break;
+  }
+  return ms;
+}
+
+
+/*--------------------------------------------- seqReset() -------------------
+ *
+ * a new config. Programs start from the top, Delay0 NV is the program. A
+ *  chan that runs one, or did, goes STEADY for newPhase() to start.
+*/
+
+static void seqReset( const cfg_t * was )
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( was[ch].mode == MODE_SEQ || cfg[ch].mode == MODE_SEQ )
+    {
+      uint8_t prog = cfg[ch].secDelay[0];
+
+      if( var[ch].state == STATE_EFFECT )
+      {
+        unschedule( ch );
+        var[ch].state = STATE_STEADY;
+      }
+      sv[ch].pc = ( prog < QTY_SEQ ? code[prog] : SEQ_NONE );
+      sv[ch].loops = 0;
+      sv[ch].slices = 0;
+    }
+  }
+}
+
+
+/*--------------------------------------------- newPhase() -------------------
+ *
+ * The day/night input has changed, so setup new phase for each channel.
+ * Runs in the ISR at a tick boundary, when startNewPhase() asked for it.
+*/
+
+static void newPhase()
+{
+  dueLen = 0;
+  transitQty = 0;
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )   /* loop all channels */
+  {
+    uint8_t nx = modeNext( cfg[ch].mode, nightSw, var[ch].phase );
+
+    STAT_BRANCH;
+    if( ( nx & NX_KEEP ) == 0 || var[ch].state == STATE_STEADY )
+    {
+      nextState( ch, nx );
+    }
+    else if( var[ch].state == STATE_TRANSIT )  /* NX_KEEP, chan carries on  */
+    {
+      transitQty++;
+    }
+    STAT_BRANCH;
+    if( var[ch].state == STATE_STEADY )
+    {
+      continue;                    /* nothing due                            */
+    }
+    if( ch == testChan )           /* chan under test stays frozen           */
+    {
+      testLeft = var[ch].due - ticks;
+    }
+    else
+    {
+      schedule( ch );
+    }
+  }                /* end ch loop */
+}
+
+
+/*--------------------------------------------- processChannels() ----------
+ *
+ * timer1 Interrupt Service Routine.  1 ms foreground process.
+ * Only chans whose due tick has come are processed. Idle if all STEADY.
+*/
+                                /* !!! This is ISR which runs every 1 ms !!! */
+void processChannels()          /*        keep it light as possible          */
+{
+  halIsrStart();                /* is ISR run time = min 21 us to peak 87 us */
+
+  STAT_BRANCH;
+  if( cfgReq == true )          /* setupChannels() published a new config    */
+  {
+    const cfg_t * was = cfg;
+
+    cfgLive ^= 1;
+    cfg = cfgBuf[cfgLive];
+    code = seqBuf[cfgLive];
+    seqFresh = false;
+    cfgReq = false;
+    cfgSwaps++;
+    seqReset( was );
+  }
+  STAT_BRANCH;
+  if( evCmd != testCmd )
+  {
+    testChange();
+  }
+  STAT_BRANCH;
+  if( evCmd == EVAL_SHUTDOWN )      /* SHUTDOWN is done in eventHandler      */
+  {
+    showTransit( false );           /* time stands still for all chans       */
+    ticksHeld++;
+  }
+  else
+  {
+    STAT_BRANCH;
+    if( testChan < QTY_CHAN && testDC != testShown )
+    {
+      testShown = testDC;
+      writePWM( testChan, testDC << TEST_SHIFT );
+    }
+    ticks++;                        /* before newPhase(), its due ticks are  */
+    STAT_BRANCH;                    /*  counted from this one                */
+    if( phaseReq == true && (int16_t)( ticks - phaseTick ) >= 0 )
+    {                               /* startNewPhase() asked for new phase   */
+      phaseReq = false;
+      newPhase();
+    }
+
+    while( dueLen != 0 && (int16_t)( ticks - var[dueQ[0]].due ) >= 0 )
+    {
+      STAT_BRANCH;
+      uint8_t ch = dueQ[0];                       /* pop the earliest chan   */
+      dueLen--;
+      for( uint8_t i = 0; i < dueLen; i++ )
+      {
+        dueQ[i] = dueQ[i + 1];
+      }
+      processChan( ch );
+      if( var[ch].state != STATE_STEADY )
+      {
+        schedule( ch );
+      }
+    }
+    showTransit( transitQty != 0 );               /* show TRANSIT activity   */
+  }
+  STAT_BRANCH;
+  if( pwmScale != scaleShown )      /* limUpdate() changed the soft limit    */
+  {
+    rescale();
+  }
+  STAT_BRANCH;
+  if( pwmDirty != 0 )
+  {
+    flushPWM();                                   /* 1 write per dirty chan  */
+  }
+  if( pwmHold == false )
+  {
+    halDither();                                  /* 8 bit timer chans       */
+  }
+  halIsrEnd();
+}
+
+
+/*--------------------------------------------- processChan() ---------------
+ *
+ * Process 1 channel, its due tick has come. Called from processChannels()
+ * Sets the next due tick, unless the chan goes STEADY.
+*/
+
+void processChan( uint8_t ch )
+{
+  STAT_TOUCH;
+  STAT_BRANCH;
+  if( var[ch].state == STATE_DELAY )                  /* is state Delay?     */
+  {
+    var[ch].secCount++;                               /* a delay second done */
+
+    STAT_BRANCH;
+    if( var[ch].secCount > cfg[ch].secDelay[var[ch].phase] )
+    {
+      var[ch].state = STATE_TRANSIT;                  /* end state Delay     */
+      var[ch].secCount = 0;
+      transitQty++;
+      startTransit( ch );
+    }
+    else
+    {
+      var[ch].due = ticks + 1000;
+    }
+  }
+  else if( var[ch].state == STATE_EFFECT )            /* is state Effect?    */
+  {
+    uint8_t dc;
+
+    var[ch].due = ticks + effectStep( ch, dc );
+    STAT_BRANCH;
+    if( dc != var[ch].dcCur )
+    {
+      var[ch].dcCur = dc;
+      writePWM( ch, gammaLook( cfg[ch].gamma, dc ) );
+    }
+  }
+  else /* so, state must be TRANSIT. Do 1 slice */
+  {
+    uint8_t to = cfg[ch].dc[var[ch].phase];
+    uint8_t dc = to;                                  /* last slice, exact   */
+
+    var[ch].step++;
+    STAT_BRANCH;
+    if( var[ch].step < var[ch].steps )
+    {
+      var[ch].prog += var[ch].progStep;             /* 16 bit fraction     */
+      dc = sliceDc( ch, to, var[ch].prog >> 8 );
+    }
+    STAT_BRANCH;
+    if( dc != var[ch].dcCur )
+    {
+      var[ch].dcCur = dc;
+      writePWM( ch, gammaLook( cfg[ch].gamma, dc ) );         /* set new dc  */
+    }
+
+    STAT_BRANCH;
+    if( var[ch].step < var[ch].steps )
+    {
+      var[ch].due = ticks + sliceTicks( ch );
+    }
+    else
+    {
+      transitQty--;                                   /* dc transit complete */
+
+      STAT_BRANCH;                                    /* what mode does next */
+      nextState( ch, modeNext( cfg[ch].mode, TRIG_DONEDAY + nightSw,
+                               var[ch].phase ) );
+    }
+  }
+}
+
+
+/*-------------------------------------------- startNewPhase() ---------------
+ *
+ * The day/night input has changed. Ask the ISR to start a new phase on its
+ *  next tick. See newPhase()
+ * startNewPhaseAt() starts it at a given tick instead, so synced nodes all
+ *  start in the same ms. See SYNC.h. phaseReq is cleared first, so the ISR
+ *  can not start on a half written phaseTick.
+ * If a scene is showing, the NV config is reloaded first.
+*/
+
+static void loadConfig();             /* NVs to cfgBuf[], below             */
+
+
+static void requestPhase( uint16_t tick )
+{
+  phaseReq = false;
+  phaseTick = tick;
+  halNightLED( nightSw );
+  phaseReq = true;
+}
+
+
+void startNewPhase()
+{
+  startNewPhaseAt( engineTicks() );
+}
+
+
+void startNewPhaseAt( uint16_t tick )
+{
+  if( sceneCfg == true )
+  {
+    loadConfig();
+  }
+  requestPhase( tick );
+}
+
+
+/*-------------------------------------------- engineTicks() ----------------
+ *
+ * ticks is 16 bit, the ISR may change it between the 2 byte reads. Read it
+ *  till 2 reads agree.
+*/
+
+uint16_t engineTicks()
+{
+  uint16_t t;
+
+  do
+  {
+    t = ticks;
+  } while( t != ticks );
+  return t;
+}
+
+
+/*---------------------------------------- initChannels() -------------------
+ *
+ * set all channels to mid DC, STEADY. Called by setup() before the ISR runs
+*/
+
+void initChannels()
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    var[ch].dcCur = DC_MID;
+    var[ch].state = STATE_STEADY;
+    var[ch].phase = 0;
+
+    pwmNext[ch] = gammaLook( 0, var[ch].dcCur );       /* NVs not read yet */
+    halWritePWM( ch, scalePWM( pwmNext[ch] ) );
+  }
+}
+
+
+/*---------------------------------------- setupChannels() -------------------
+ *
+ * set channel config from channel NVs, publish it to the ISR & start phase.
+ * Config is built in the buffer the ISR is not using. cfgReq is cleared
+ *  first, so the ISR can not swap to that buffer while it is written.
+*/
+
+void setupChannels()
+{
+  loadConfig();
+  requestPhase( engineTicks() );
+}
+
+
+static void nextCode()   /* image for the next buffer, as live unless filled */
+{
+  if( seqFresh == false )               /* the swap clears it               */
+  {
+    memcpy( seqBuf[cfgLive ^ 1], seqBuf[cfgLive], SEQ_BYTES );
+  }
+}
+
+
+static void loadConfig()             /* NVs to cfgBuf[], see setupChannels() */
+{
+  ADRNV NV;  /* lookup NV for chan, phase and datatype  */
+
+  cfgReq = false;
+  sceneCfg = false;
+  nextCode();
+  cfg_t * next = cfgBuf[cfgLive ^ 1];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )      /* loop through channels   */
+  {
+    cfg_t & c = next[ch];
+
+    c.dc[0]       = halReadNV( NV.dc( ch, 0 ) );
+    c.dc[1]       = halReadNV( NV.dc( ch, 1 ) );
+    c.secDelay[0] = halReadNV( NV.dly( ch, 0 ) );
+    c.secDelay[1] = halReadNV( NV.dly( ch, 1 ) );
+    c.secTrans    = halReadNV( NV.tran( ch ) );
+    uint8_t nvMode = halReadNV( NV.mode( ch ) );
+    c.mode        = (MODE_t) ( nvMode & 0x0F );             /* bits 0-3    */
+    c.ease        = (EASE_t) ( ( nvMode >> 4 ) & 0x03 );    /* bits 4-5    */
+    if( c.mode >= QTY_MODE )
+    {
+      halWarn( "!bad mode. Reset ch", ch );
+      c.mode = MODE_DAYNIGHT;
+    }
+    c.gamma       = halReadNV( NV.gamma( ch ) );
+    if( c.gamma >= QTY_GAMMA )
+    {
+      halWarn( "!bad gamma. Reset ch", ch );
+      c.gamma = 0;
+    }
+  }
+  cfgReq = true;                              /* ISR swaps on its next tick  */
+}
+
+
+/*---------------------------------------- startScene() ----------------------
+ *
+ * show a scene. Built like setupChannels(), into the buffer the ISR is not
+ *  using, with every chan in MODE_SCENE. The ISR swaps config and starts
+ *  the phase at tick boundaries, so all chans start in the same tick.
+ * Ease and gamma stay as the chan NVs.
+*/
+
+void startScene( const sceneChan_t * sc )
+{
+  EASE_t  ease[QTY_CHAN];             /* newest NV curves, before cfgReq off */
+  uint8_t gamma[QTY_CHAN];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    ease[ch] = chanCfg( ch ).ease;
+    gamma[ch] = chanCfg( ch ).gamma;
+  }
+  cfgReq = false;
+  nextCode();
+  cfg_t * next = cfgBuf[cfgLive ^ 1];
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    cfg_t & c = next[ch];
+
+    c.mode        = MODE_SCENE;
+    c.ease        = ease[ch];
+    c.gamma       = gamma[ch];
+    c.dc[0]       = sc[ch].dc;
+    c.dc[1]       = sc[ch].dc;
+    c.secDelay[0] = sc[ch].secDelay;
+    c.secDelay[1] = sc[ch].secDelay;
+    c.secTrans    = sc[ch].secTrans;
+  }
+  cfgReq = true;
+  sceneCfg = true;
+  requestPhase( engineTicks() );
+}
+
+
+/*----------------------------- setAllPWM() --------------------------
+ *
+ * set all PWM channel duty cycles to zero or reset to old values
+*/
+
+void setAllPWM( PWM_t flag )
+{
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    if( flag == PWM_OFF )
+    {
+      halWritePWM( ch, 0 );
+    }
+    else
+    {
+      restorePWM( ch );
+    }
+  }
+}
+
+
+/*----------------------------- restorePWM() --------------------------
+ *
+ * set a chan PWM back to its current DC. EG. at end of chan test
+ * Nothing while pwmHold, as flushPWM(). A Power fault or calibration holds
+ *  the PWM, events still run. Power recovery and calibration end restore.
+*/
+
+void restorePWM( uint8_t ch )
+{
+  if( pwmHold == true )
+  {
+    return;
+  }
+  halWritePWM( ch, scalePWM( gammaLook( chanCfg( ch ).gamma, var[ch].dcCur ) ) );
+}
+
+
+/*---------------------------------------- chanCfg() -------------------------
+ *
+ * newest config for a chan, for background code. May be waiting for the ISR
+*/
+
+const cfg_t & chanCfg( uint8_t ch )
+{
+  return cfgBuf[cfgReq == true ? cfgLive ^ 1 : cfgLive][ch];
+}
+
+
+/*---------------------------------------- seqNext() -------------------------
+ *
+ * the program image buffer the ISR is not using, to fill. Then call
+ *  setupChannels(), it is swapped in with the config. See SEQ.h
+*/
+
+uint8_t * seqNext()
+{
+  cfgReq = false;
+  seqFresh = true;
+  return seqBuf[cfgLive ^ 1];
+}
+
+
+uint8_t chanSeqPc( uint8_t ch )
+{
+  return sv[ch].pc;
+}
+
+
+/*---------------------------------------- checkTicks() ----------------------
+ *
+ * Compare ISR ticks against the ms clock. ticksLost should stay near 0.
+ * Called each second by a loop() task. 16 bit ticks wrap in 65 s.
+*/
+
+void checkTicks()
+{
+  static uint32_t msWas { halMillis() };
+  static uint16_t ticksWas { (uint16_t)( ticks + ticksHeld ) };
+
+  uint32_t ms = halMillis();
+  uint16_t t = ticks + ticksHeld;     /* time held in SHUTDOWN is not lost  */
+
+  ticksLost += (int32_t)( ms - msWas ) - (uint16_t)( t - ticksWas );
+  msWas = ms;
+  ticksWas = t;
+}
+
+
+/*-------------------------------CHAN.cpp EoF ------------------------------*/
@@ -0,0 +1,429 @@
+/*file: CHAN.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Channel engine. Types, data and functions for the 1 ms channel process.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The engine has no Arduino or CBUS dependencies, it uses HAL.h only.
+ *  So the same CHAN.cpp builds on the MEGA and on a PC host (see host/).
+ *
+ * Chan count. Build flag CHANS, 10 (the default) to 24, even. Every table,
+ *  the NV map and the EEPROM map follow it. Chans 1-10 are on timer
+ *  comparators, PWM.h. Chans 11 up are bit angle modulated on GPIO ports,
+ *  BAM.h. NB. a new CHANS moves the EEPROM map. NVs & events are moved at
+ *  boot, see CACHE.h, scenes and curves are not.
+*/
+#ifndef CHAN_H__  /* include guard */
+#define CHAN_H__
+
+#include "HAL.h"
+
+
+#ifndef CHANS
+#define CHANS 10                /* build flag, -DCHANS=16. See above          */
+#endif
+
+const uint8_t QTY_CHAN { CHANS };  /* qty of PWM channels for LED chans      */
+const uint8_t QTY_PWMCHAN { 10 };  /* chans on timer comparators, PWM.h      */
+const uint8_t QTY_BAMCHAN { QTY_CHAN - QTY_PWMCHAN }; /* on GPIO, BAM.h      */
+const uint8_t QTY_BAMMAX { 14 };   /* GPIO pins for BAM chans, PIN.h         */
+
+static_assert( QTY_CHAN >= QTY_PWMCHAN && QTY_BAMCHAN <= QTY_BAMMAX
+               && QTY_CHAN % 2 == 0, "CHANS is 10 - 24, even" );
+
+#if CHANS > 16
+typedef uint32_t chanBits_t;    /* bit per chan                               */
+#else
+typedef uint16_t chanBits_t;
+#endif
+
+const uint8_t NV_PER_CHAN { 7 }; /* Trans, Dly0, Dly1, DC0, DC1, Mode, Gamma  */
+                                 /* 6 before Gamma, CACHE.cpp moves them up   */
+const uint8_t QTY_NV { NV_PER_CHAN * QTY_CHAN };  /* qty of Node Variables    */
+
+const uint8_t  PWM_BITS { 12 };   /* PWM resolution, see PWM.h                */
+const uint16_t PWM_TOP  { ( 1U << PWM_BITS ) - 1 };  /* full on PWM value    */
+
+const uint8_t PWM_SCALE1 { 128 };  /* pwmScale Q7, 1.0 = not limited. LIMIT.h */
+
+const uint8_t QTY_GAMMA { 6 };  /* qty of gamma curves, Gamma NV. See GAMMA.h */
+
+
+enum DC_t : uint8_t
+{
+  DC_MIN = 0,               /* Duty Cycle ranges  0                       */
+  DC_MID = 127,             /*                    to                      */
+  DC_MAX = 255              /*                    255                     */
+};
+
+
+enum MODE_t : uint8_t    /* channel mode codes. For global var[] */
+{
+  MODE_DAYNIGHT  = 0,
+  MODE_DUSK      = 1,
+  MODE_DAWN      = 2,
+  MODE_DUSKDAWN  = 3,
+  MODE_NIGHT010  = 4,
+  MODE_DAY010    = 5,
+  MODE_ALWAYS010 = 6,
+  MODE_RANDOM010 = 7,
+  MODE_ONESHOT   = 8,
+  MODE_FLICKER   = 9,    /* effect modes, see EFFECT.h                     */
+  MODE_FIRE      = 10,
+  MODE_ARC       = 11,
+  MODE_STROBE    = 12,
+  MODE_SEQ       = 13,   /* keyframe program, see SEQ.h                    */
+  MODE_SCENE     = 14    /* not an NV mode. Set by startScene(), see below */
+};
+const uint8_t QTY_MODE { 14 };  /* NV modes, 0 - 13 */
+const uint8_t QTY_MODEROW { QTY_MODE + 1 };  /* MODENEXT[] rows, see MODE.h */
+
+
+enum EASE_t : uint8_t    /* transition curve. Mode NV bits 4-5, see EASE.h */
+{
+  EASE_LINEAR = 0,
+  EASE_IN     = 1,
+  EASE_OUT    = 2,
+  EASE_INOUT  = 3
+};
+const uint8_t QTY_EASE { 4 };
+
+
+enum STATE_t : uint8_t  /* channel state codes. For var[] */
+{
+  STATE_STEADY,
+  STATE_TRANSIT,
+  STATE_DELAY,
+  STATE_EFFECT           /* effect or sequence running, EFFECT.h SEQ.h  */
+};
+const uint8_t OTY_STATE { 4 };
+
+
+enum NIGHTSW_t : bool   /* module input codes. for nightSw global var */
+{
+  NIGHTSW_DAY   = 0,
+  NIGHTSW_NIGHT = 1
+};
+const uint8_t QTY_INPUT { 2 };
+
+
+enum EVAL_t : uint8_t  /* EV values on stored events */
+{
+  EVAL_NIGHTSW  = 0,     /* On event = NIGHT, Off event = DAY.                */
+  EVAL_TESTCH1  = 1,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH2  = 2,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH3  = 3,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH4  = 4,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH5  = 5,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH6  = 6,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH7  = 7,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH8  = 8,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH9  = 9,     /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTCH10 = 10,    /* On event DC=254, Off event DC=1                   */
+  EVAL_TESTEND  = 11,    /* On event Test End, Off event NA                   */
+  EVAL_SHUTDOWN = 12,    /* On = All chans DC=0, Off event = normal operation */
+  EVAL_SCENE1   = 13,    /* On event recalls scene 1, Off event NA            */
+  EVAL_SCENE2   = 14,    /* On event recalls scene 2. ACON1/ASON1 data byte   */
+  EVAL_SCENE3   = 15,    /*  1 - 8 picks the scene, for any EVAL_SCENEx       */
+  EVAL_SCENE4   = 16,
+  EVAL_SCENE5   = 17,
+  EVAL_SCENE6   = 18,
+  EVAL_SCENE7   = 19,
+  EVAL_SCENE8   = 20,
+  EVAL_CALIBRATE = 21,   /* On event runs chan current calibration, see CAL.h */
+  EVAL_SYNC     = 22,    /* sync master tick ACON2, start ACOF2, see SYNC.h   */
+  EVAL_SEQ      = 23     /* ACON3 puts 2 program bytes, Off loads, see SEQ.h  */
+};
+const uint8_t QTY_EVAL { 24 };
+
+const uint8_t QTY_SCENE { 8 };   /* scenes in EEPROM, see SCENE.h             */
+
+
+enum PWM_t : uint8_t
+{
+  PWM_OFF = 0,
+  PWM_RESTORE = 1
+};
+
+
+
+/*-------------------------------- class ADRNV ---------------------------------
+ *
+ *  return address of NV  for a channel and param type
+*/
+
+class ADRNV
+{
+  public:
+
+    ADRNV() { };
+    ~ADRNV() { };
+
+    uint8_t tran( uint8_t chan )           /* return transition NV for chan */
+    {
+      return ( NVmap[NV_TRAN][0] + chan );
+    }
+
+    uint8_t dly( uint8_t chan, bool indx ) /* return delay NV for chan & idx */
+    {
+      return ( NVmap[NV_DLY][indx] + chan );
+    }
+
+    uint8_t dc( uint8_t chan, bool indx )   /* return DC NV for chan/index  */
+    {
+      return ( NVmap[NV_DC][indx] + chan );
+    }
+
+    uint8_t mode( uint8_t chan)             /* return mode NV addr for chan */
+    {
+      return ( NVmap[NV_MODE][0] + chan );
+    }
+
+    uint8_t gamma( uint8_t chan )           /* return gamma NV for chan     */
+    {
+      return ( NVmap[NV_GAMMA][0] + chan );
+    }
+
+  private:
+    enum NV_t : uint8_t
+    {
+      NV_TRAN = 0, NV_DLY, NV_DC, NV_MODE, NV_GAMMA, NV_MAPSIZE
+    };
+    static constexpr uint8_t NVmap[NV_MAPSIZE][2]  /* a block per param   */
+    {                                   /* 10 chans: 1, 11 21, 31 41, 51, 61 */
+      { 1, 1 },     /* Transition Secs are same for phase 0 or 1          */
+      { 1 + QTY_CHAN,     1 + 2 * QTY_CHAN },  /* Delay Secs, phase 0 & 1 */
+      { 1 + 3 * QTY_CHAN, 1 + 4 * QTY_CHAN },  /* DutyCylce, phase 0 & 1  */
+      { 1 + 5 * QTY_CHAN, 1 + 5 * QTY_CHAN },  /* Modes, same for 0 or 1  */
+      { 1 + 6 * QTY_CHAN, 1 + 6 * QTY_CHAN }   /* Gamma curve, same       */
+    };
+}; /* end of class ADRNV */
+
+
+
+struct cfg_t   /* channel config. Populated from NVs by setupChannels()      */
+{
+  uint8_t   secTrans;     /* Transition seconds                      0 - 255 */
+
+  uint8_t   secDelay[2];  /* Delay seconds                           0 - 255 */
+
+  MODE_t    mode;         /* chan mode, Mode NV bits 0-3              0 - 13 */
+
+  EASE_t    ease;         /* transition curve, Mode NV bits 4-5        0 - 3 */
+
+  uint8_t   gamma;        /* gamma curve, Gamma NV                     0 - 5 */
+
+  uint8_t   dc[2];        /* DC0 & DC1 phase 0 & phase 1 targets     0 - 255 */
+};
+
+
+struct sceneChan_t   /* one chan of a scene, see SCENE.h                     */
+{
+  uint8_t   dc;           /* target DC                               0 - 255 */
+  uint8_t   secTrans;     /* Transition seconds                      0 - 255 */
+  uint8_t   secDelay;     /* Delay seconds, before transition        0 - 255 */
+};
+
+
+struct var_t   /* channel status/trackers. Only the ISR modifies            */
+{
+  uint8_t   dcCur;        /* current DC value                        0 - 255 */
+
+  uint16_t  due;          /* ticks value when next slice or Dly sec is due */
+
+  uint8_t   secCount;     /* seconds counter. EFFECT burst count     0 - 255 */
+
+  uint8_t   dcFrom;       /* DC at start of transition               0 - 255 */
+
+  uint8_t   step;         /* slices done in transition. EFFECT index 0 - 255 */
+
+  uint16_t  prog;         /* transition progress, 16 bit fraction    0 - 65k */
+
+  uint8_t   msErr;        /* Bresenham error, spreads msRem over steps       */
+
+                          /* Set by startTransit(), secTrans & dc distance   */
+  uint8_t   steps;        /* slices in a transition                 32 - 255 */
+  uint16_t  msPerStep;    /* ms per slice, whole part               1 - 7968 */
+  uint8_t   msRem;        /* ms per slice, remainder to spread      0 - 254  */
+  uint16_t  progStep;     /* progress per slice, 65535 / steps   257 - 2047 */
+
+  STATE_t   state;        /* Stdy, Tran, Dlay, Efct trackers           0 - 3 */
+
+  bool      phase;        /* phase 0 or 1                              0 - 1 */
+};
+
+
+/* Config double buffer...
+ *
+ *  The ISR reads cfgBuf[cfgLive]. setupChannels() writes the other buffer,
+ *   then sets cfgReq. The ISR swaps buffers at the start of its next tick.
+ *  startNewPhase() only sets phaseReq. The ISR starts the phase at a tick.
+ *  So background code never stops the ISR and no 1 ms tick is dropped.
+*/
+
+/* Channel Modes...
+ *
+ *  MODE_DAYNIGHT
+ *  --------
+ *  Input change to NIGHT,
+ *   after secDelay[1], dc transitions from current dc to dc[1].
+ *   Stay steady until,
+ *  Input change to DAY,
+ *   after secDelay[0], dc transitions from current dc to dc[0].
+ *
+ *  DUSKDAWN
+ *  -----------
+ *  Input change to NIGHT,
+ *   after secDelay[1], dc transitions from current dc to dc[1],
+ *   after secDelay[0], dc transitions from current dc to dc[0].
+ *  Stay steady until,
+ *  Input change to DAY... as per nightSw change to 1.
+ *
+ *  NIGHT010
+ *  ---------
+ *   Input change to NIGHT,
+ *    after secDelay[1], transitions from current dc to dc[1],
+ *    after secDelay[0], transitions from dc[1] to dc[0],
+ *    after secDelay[1], transitions from dc[0] to dc[1],
+ *    ... repeats until nightSw change to 0.
+ *   Input change to DAY,
+ *    after secDelay[0], transitions from current dc to dc[0].
+ *
+ *  DAY010
+ *  -------
+ *   Input change to DAY,
+ *    after secDelay[1], transitions from current dc to dc[1],
+ *    after secDelay[0], transitions from dc[1] to dc[0],
+ *    after secDelay[1], transitions from dc[0] to dc[1],
+ *    ... repeats until nightSw change to 0.
+ *   Input change to NIGHT,
+ *    after secDelay[0], transitions from current dc to dc[0].
+ *
+ *  ALWAYS010
+ *  ---------
+ *   From power on, as NIGHT010 while NIGHT. Input changes are ignored,
+ *    it repeats for ever.
+ *
+ *  RANDOM010
+ *  ---------
+ *   As NIGHT010, but each delay is random, 1 to secDelay + 1 seconds.
+ *    EG. house lights that go on and off through the night.
+ *
+ *  ONESHOT
+ *  -------
+ *   Input change to NIGHT,
+ *    after secDelay[1], transitions from current dc to dc[1],
+ *    after secDelay[0], transitions from dc[1] to dc[0], stays steady.
+ *   Input changes while it runs are ignored. Input change to DAY, when
+ *    not running, transitions to dc[0].
+ *
+ *  FLICKER, FIRE, ARC, STROBE
+ *  --------------------------
+ *   Input change to NIGHT,
+ *    after secDelay[1], transitions from current dc to dc[1], then runs
+ *    the effect, STATE_EFFECT, at up to dc[1] until,
+ *   Input change to DAY,
+ *    transitions from the effect dc to dc[0], stays steady.
+ *   secDelay[0] is the effect rate. A test or SHUTDOWN freezes the effect
+ *    like any other chan. See EFFECT.h
+ *
+ *  SEQ
+ *  ---
+ *   Runs keyframe program Delay0 NV from the image in SEQ.h, as
+ *    STATE_EFFECT. A program waiting on NightSw is STEADY, the next input
+ *    change starts it again where it waits. Edges while it runs are ignored.
+ *    A new config starts each program again from the top.
+ *
+ *  SCENE
+ *  -----
+ *   Not an NV mode, it is the row after the NV modes in MODENEXT[].
+ *   startScene() builds a config with every chan in
+ *    MODE_SCENE, dc[1] = scene dc, as a new phase. All chans start in one
+ *    tick. Zero secDelay[1] transits at once, else after the delay. The
+ *    chan transitions to dc[1] and stays steady.
+ *   The next input change reloads the NV config, and the modes run again.
+ *
+ *  The mode rules are rows of MODENEXT[] in MODE.h
+ *
+ *  [0] is day, [1] is night
+ *  dc[0] and dc[1] can be configured as any value you want.
+ *
+ *  Transitions
+ *  -----------
+ *   A transition takes secTrans seconds, from the current dc to the target.
+ *   It is cut into 'steps' slices, one per dc of the distance it has to
+ *    go when it starts, STEPS_MIN at least. Slice lengths are spread Bresenham style
+ *    so the last slice lands on the target at exactly secTrans * 1000 ms.
+ *   Zero secTrans is special, 1 ms per slice.
+ *   Mode NV bits 4-5 select the curve. Mode NV = mode + 16 * ease.
+ *    EG. Dusk (1) with EASE_OUT (2) is NV value 33.
+ *   Each slice is one gamma table lookup, DC to 12 bit PWM. See GAMMA.h
+*/
+
+
+
+/*--------------------------- engine statistics -------------------------------
+ *
+ * Work done in one 1 ms tick. Only counted when CHAN_STATS is defined, which
+ *  the host simulator does. The MEGA build has no counting overhead.
+*/
+
+struct chanStat_t
+{
+  uint8_t   touched;      /* channels processed this tick                    */
+  uint8_t   branches;     /* decisions taken this tick                       */
+};
+
+#ifdef CHAN_STATS
+#define STAT_TOUCH    chanStat.touched++
+#define STAT_BRANCH   chanStat.branches++
+#else
+#define STAT_TOUCH
+#define STAT_BRANCH
+#endif
+
+
+
+/*----------------------------- engine functions ------------------------------
+*/
+
+void processChannels();               /* foreground process 1ms timer1        */
+void processChan( uint8_t );          /* process single chan, from foreground */
+void startNewPhase();                 /* called from loop or setUpChannels    */
+void startNewPhaseAt( uint16_t tick ); /* start at ticks == tick, see SYNC.h  */
+uint16_t engineTicks();               /* ticks, safe read from background     */
+void initChannels();                  /* called by setup(), before the ISR    */
+void setupChannels();                 /* called by setup()                    */
+void seedChannels( uint16_t seed );   /* seed RANDOM010 delays, from setup()  */
+void startScene( const sceneChan_t * sc ); /* all chans to a scene, 1 tick    */
+void setAllPWM( PWM_t );              /* set all PWM DC to 0 or reset         */
+void restorePWM( uint8_t );           /* set chan PWM to its current DC       */
+void checkTicks();                    /* count ticks lost, called from loop() */
+uint8_t * seqNext();                  /* program image to fill, see SEQ.h     */
+uint8_t chanSeqPc( uint8_t ch );      /* program counter, for 'v' & host      */
+
+const cfg_t & chanCfg( uint8_t ch );  /* newest config for chan, background  */
+
+
+/*------------------------------ engine data ---------------------------------*/
+
+extern volatile var_t var[QTY_CHAN];  /* channel status array. ISR modifies   */
+extern cfg_t   cfgBuf[2][QTY_CHAN];   /* channel config double buffer         */
+extern volatile uint8_t cfgLive;      /* cfgBuf[] index the ISR is using      */
+extern volatile NIGHTSW_t nightSw;    /* nightSw state 0 = DAY or 1 = NIGHT   */
+extern EVAL_t  evCmd;                 /* the current event command            */
+extern uint8_t testDC;                /* current duty cycle for test mode     */
+extern volatile bool pwmHold;         /* true = ISR makes no PWM writes       */
+extern volatile uint8_t pwmScale;     /* all PWM writes * pwmScale / 128      */
+extern volatile uint16_t ticks;       /* 1 ms ISR ticks, the engine clock     */
+extern chanStat_t chanStat;           /* work counters, see CHAN_STATS        */
+extern uint16_t cfgSwaps;             /* config buffer swaps done by the ISR  */
+extern int32_t  ticksLost;            /* ms elapsed minus ISR ticks counted   */
+
+
+#endif /* CHAN_H__
+ --------------------------------------- EoF ------------------------------
+*/
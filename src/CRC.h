@@ -0,0 +1,37 @@
+/*file: CRC.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * CRC-8, poly 0x07. Snapshot slots (SNAP.cpp), telemetry frames (TELE.cpp)
+ *  and the NV blob (CACHE.cpp)
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Bit at a time, no table, so no flash or RAM for one. Quick enough for
+ *  the few bytes it is given. A host decoder includes it too. crc is the
+ *  crc8() of the bytes before, to run on over a block in parts.
+*/
+#ifndef CRC_H__  /* include guard */
+#define CRC_H__
+
+#include "HAL.h"
+
+
+inline uint8_t crc8( const uint8_t * buf, uint8_t len, uint8_t crc = 0 )
+{
+  while( len-- != 0 )
+  {
+    crc ^= *buf++;
+    for( uint8_t b = 0; b < 8; b++ )
+    {
+      crc = ( crc & 0x80 ? ( crc << 1 ) ^ 0x07 : crc << 1 );
+    }
+  }
+  return crc;
+}
+
+
+#endif /* CRC_H__
+ --------------------------------------- EoF ------------------------------
+*/
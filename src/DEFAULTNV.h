@@ -12,19 +12,28 @@
 #define DEFAULTNV_H__
 
   
-const uint8_t DEFAULTNV[QTY_NV]
+const uint8_t DEFAULTNV[NV_PER_CHAN][QTY_PWMCHAN]   /* a row per param      */
 {
 /*             ch1  ch2  ch3  ch4  ch5  ch6  ch7  ch8  ch9  ch10
                ---- ---- ---- ---- ---- ---- ---- ---- ---- ---- 
 */
-/* Transit */    6,   6,   1,   3,   3,   3,   0,   1,   6,   6, 
-/*  Delay0 */    0,   0,   4,   0,   0,   0,   2,   3,   0,   0, 
-/*  Delay1 */    0,   0,   4,   0,   0,   0,   1,   4,   0,   0, 
-/*     DC0 */   30,  31,  32,  33,  34,  35,  36,  37, 208, 249, 
-/*     DC1 */  200, 251, 252, 253, 224, 225, 236, 237,  38,  39, 
-/*    Mode */    0,   0,   4,   1,   3,   2,   4,   5,   0,   0
+/* Transit */ {  6,   6,   1,   3,   3,   3,   0,   1,   6,   6 },
+/*  Delay0 */ {  0,   0,   4,   0,   0,   0,   2,   3,   0,   0 },
+/*  Delay1 */ {  0,   0,   4,   0,   0,   0,   1,   4,   0,   0 },
+/*     DC0 */ { 30,  31,  32,  33,  34,  35,  36,  37, 208, 249 },
+/*     DC1 */ {200, 251, 252, 253, 224, 225, 236, 237,  38,  39 },
+/*    Mode */ {  0,   0,   4,   1,   3,   2,   4,   5,   0,   0 },
+/*   Gamma */ {  0,   0,   0,   0,   0,   0,   0,   0,   0,   0 }
 };
 
+
+/* default for NV 1 - QTY_NV. Chans 11 up, see CHANS, repeat ch1 - ch10 */
+
+inline uint8_t defaultNV( uint8_t nv )
+{
+  return DEFAULTNV[( nv - 1 ) / QTY_CHAN][( nv - 1 ) % QTY_CHAN % QTY_PWMCHAN];
+}
+
 /* ch Modes...
  *   ch1/2 = DayNight   Night blue
  *   ch3 = Night010     night blue
@@ -34,6 +43,8 @@ const uint8_t DEFAULTNV[QTY_NV]
  *   ch7 = Night010     white
  *   ch8 = Day010       day white
  *   ch9/10 = DayNight  Day white
+*
+ * Gamma 0 = exponent 2.75 for all chans. See GAMMA.h
 */
   
 
@@ -0,0 +1,39 @@
+/*file: EASE.h     This is include file for CANlights.ino sketch
+ *-----------------------------------------------------------------------------
+ *
+ * Easing curve lookup tables for DC transitions
+ *
+ * table maps transition progress (0 to 63) to DC progress (0 to 255).
+ * EASE_LINEAR has no table, progress is used as is. See CHAN.cpp
+ *
+ */
+#ifndef EASE_H__  /* include guard */
+#define EASE_H__
+
+
+const uint8_t EASE[3][64]   /* [ease -1][progress / 4] */
+{
+  { /* EASE_IN    quadratic, slow start   */
+/* 0*/   0,  0,  0,  1,  1,  2,  2,  3,  4,  5,  6,  8,  9, 11, 13, 14,
+/*16*/  16, 19, 21, 23, 26, 28, 31, 34, 37, 40, 43, 47, 50, 54, 58, 62,
+/*32*/  66, 70, 74, 79, 83, 88, 93, 98,103,108,113,119,124,130,136,142,
+/*48*/ 148,154,161,167,174,180,187,194,201,209,216,224,231,239,247,255
+  },
+  { /* EASE_OUT   quadratic, slow finish  */
+/* 0*/   0,  8, 16, 24, 31, 39, 46, 54, 61, 68, 75, 81, 88, 94,101,107,
+/*16*/ 113,119,125,131,136,142,147,152,157,162,167,172,176,181,185,189,
+/*32*/ 193,197,201,205,208,212,215,218,221,224,227,229,232,234,236,239,
+/*48*/ 241,242,244,246,247,249,250,251,252,253,253,254,254,255,255,255
+  },
+  { /* EASE_INOUT smoothstep, slow both    */
+/* 0*/   0,  0,  1,  2,  3,  5,  6,  9, 11, 14, 17, 21, 24, 28, 32, 36,
+/*16*/  41, 46, 51, 56, 61, 66, 72, 77, 83, 89, 94,100,106,112,118,124,
+/*32*/ 131,137,143,149,155,161,166,172,178,183,189,194,199,204,209,214,
+/*48*/ 219,223,227,231,234,238,241,244,246,249,250,252,253,254,255,255
+  }
+};
+
+
+#endif /*  EASE_H__
+ ------------------------------------ EASE.h EoF----------------------
+*/
@@ -0,0 +1,50 @@
+/*file: EFFECT.h    This is include file for CANlights.ino sketch
+ *-----------------------------------------------------------------------------
+ *
+ * Waveform tables for the effect modes, FLICKER FIRE ARC STROBE
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * An effect step is one rnd8() and one table read, so a chan costs the same
+ *  each time it is due. See effectStep() in CHAN.cpp
+ *
+ * Effect NVs...
+ *  DC1     effect level, the brightest it gets
+ *  Delay1  seconds after NightSw On, then Transition secs fade up to DC1
+ *  Delay0  effect rate, 0 - 255. See below
+ *  DC0     day level, NightSw Off fades to it
+*/
+#ifndef EFFECT_H__  /* include guard */
+#define EFFECT_H__
+
+
+const uint8_t FIRE[64]    /* flame glow, 3 slow sines summed. % of DC1 * 256 */
+{
+/* 0*/ 217,219,218,220,224,224,217,209,206,213,226,235,235,228,220,215,
+/*16*/ 209,196,176,157,147,150,159,166,168,170,176,186,192,189,180,172,
+/*32*/ 175,186,200,210,216,225,237,250,254,245,229,213,205,202,198,190,
+/*48*/ 183,183,190,197,197,185,170,159,156,156,153,150,152,165,186,206
+};
+
+
+const uint8_t QTY_STROBE { 4 };
+
+const uint8_t STROBE[QTY_STROBE]  /* double flash, ms on off on. [3] is rate */
+{
+  30, 70, 30, 0
+};
+
+
+/* Delay0 rate, per effect...
+ *  FLICKER  steady time between bursts, random 64 ms + up to Delay0 * 64 ms
+ *  FIRE     ms per flame step, 16 + Delay0 / 4. Big is a lazy flame
+ *  ARC      pause between welds, random 200 ms + up to Delay0 * 32 ms
+ *  STROBE   off time after the double flash, 100 ms + Delay0 * 10 ms
+*/
+
+
+#endif /*  EFFECT_H__
+ ------------------------------------ EFFECT.h EoF----------------------
+*/
@@ -0,0 +1,253 @@
+/*file: EVENT.cpp
+ *----------------------------------------------------------------------------
+ *
+ * CBUS event and frame handling. See EVENT.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include <string.h>
+
+#include "EVENT.h"
+#include "CACHE.h"
+#include "SCENE.h"
+#include "SYNC.h"
+#include "SEQ.h"
+#include "PROF.h"
+#include "LOG.h"
+
+
+volatile bool swChange { true }; /* set by evEvent(). Reset when actioned     */
+bool    testCh { false };        /* false= no test chan, true= testing chan   */
+bool    debug  { false };        /* false = quiet, true = verbose             */
+uint8_t dgnCode;                 /* next DGN code to send, see PROF.h         */
+uint8_t dgnLeft { 0 };           /* DGN replies left to send                  */
+static uint8_t dgnIndex;         /* RDGN ServiceIndex, echoed in DGN          */
+
+
+/*---------------------------------------- evEvent() ------------------------
+ *
+ * learned event idx, from eventHandler(). data[] is the frame, opc first
+*/
+
+void evEvent( uint8_t idx, const uint8_t * data, uint8_t len )
+{
+  EVAL_t  evVal = (EVAL_t) cacheEV( idx );          /* RAM, see CACHE.h */
+  uint8_t opc = data[0];
+
+  if( evVal == EVAL_SYNC )             /* master frame, first & not logged */
+  {
+    if( ( opc == OPC_ACON2_ || opc == OPC_ACOF2_ ) && len >= 7 )
+    {
+      syncRx( opc == OPC_ACOF2_, ( data[5] << 8 ) | data[6] );
+    }
+    return;
+  }
+  bool timed = profEventMark();                     /* time to PWM write */
+  bool pwm { false };                               /* event changes PWM */
+
+  bool evOn = ( opc == OPC_ASON_ || opc == OPC_ACON_ ||
+                opc == OPC_ASON1_ || opc == OPC_ACON1_ );
+
+  switch( evVal )                    /* logPut() queues, see LOG.h */
+  {
+    case EVAL_NIGHTSW:                 /* evVal is NightSw event */
+      if( nightSw != (NIGHTSW_t) evOn )
+      {
+        nightSw = (NIGHTSW_t) evOn;
+        swChange = true;                      /* flag to cause phase change */
+        pwm = true;
+        logPut( LOG_EVNIGHT, evOn, evOn );
+      }
+      else
+      {
+        logPut( LOG_EVIGNORE, evOn, evVal );
+      }
+      break;
+    case EVAL_SHUTDOWN:                /* evVal is Shutdown event */
+      logPut( LOG_EVSHUT, evOn );
+      if( evCmd == EVAL_SHUTDOWN && evOn == false )
+      {
+         evCmd = EVAL_NIGHTSW;              /* revert to normal operations  */
+         setAllPWM( PWM_RESTORE );
+         pwm = true;
+      }
+      else
+      {
+        if( evCmd != EVAL_SHUTDOWN && evOn == true )
+        {
+          evCmd = EVAL_SHUTDOWN;            /* turn on shutdown             */
+          setAllPWM( PWM_OFF );
+          pwm = true;
+        }
+      }
+      break;
+    case EVAL_TESTEND:                /* evVal is TestEnd event */
+      if( testCh == true )
+      {
+        logPut( LOG_EVTESTEND, evOn, evCmd );
+        restorePWM( evCmd -1 );
+        evCmd = EVAL_NIGHTSW;
+        testCh = false;
+        pwm = true;
+      }
+      else
+      {
+        logPut( LOG_EVIGNORE, evOn, evVal );
+      }
+      break;
+    case EVAL_SCENE1 ... EVAL_SCENE8: /* evVal is Scene event */
+      if( evOn == true )
+      {
+        uint8_t n = evVal - EVAL_SCENE1;           /* scene 0 - 7           */
+
+        if( ( opc == OPC_ASON1_ || opc == OPC_ACON1_ ) && len >= 6 &&
+            data[5] >= 1 && data[5] <= QTY_SCENE )
+        {
+          n = data[5] - 1;                         /* data byte picks scene */
+        }
+        pwm = sceneRecall( n );
+        logPut( pwm ? LOG_EVSCENE : LOG_EVNOSCENE, evOn, n + 1 );
+      }
+      else
+      {
+        logPut( LOG_EVIGNORE, evOn, evVal );
+      }
+      break;
+    case EVAL_CALIBRATE:              /* evVal is Calibrate event */
+      pwm = ( evOn && calibrate() );
+      logPut( pwm ? LOG_EVCAL : LOG_EVIGNORE, evOn, evVal );
+      break;
+    case EVAL_SEQ:                    /* evVal is Sequence event */
+      if( ( opc == OPC_ACON3_ || opc == OPC_ASON3_ ) && len >= 8 )
+      {
+        seqPut( data[5], data[6], data[7] );       /* 2 image bytes         */
+        logPut( LOG_SEQPUT, data[5], data[6], data[7] );
+      }
+      else if( evOn == false )
+      {
+        bool ok = seqLoad();                       /* Off loads the image   */
+
+        setupChannels();
+        pwm = true;
+        logPut( LOG_SEQLOAD, ok );
+      }
+      else
+      {
+        logPut( LOG_EVIGNORE, evOn, evVal );
+      }
+      break;
+    default:                        /* evVal is test chX or invalid */
+      if( evVal > EVAL_TESTCH10 )
+      {
+        logPut( LOG_EVUNKNOWN, evOn, evVal );
+      }
+      else /* therefore its a TestChX eval */
+      {
+        if( evCmd != evVal && testCh == true )
+        {
+          logPut( LOG_EVTESTSW, evCmd );
+          restorePWM( evCmd -1 );
+        }
+        testCh = true;
+        testDC = ( evOn ? (DC_MAX -1) : (DC_MIN +1) );
+        evCmd = evVal;
+        pwm = true;
+        logPut( LOG_EVTEST, evOn, evVal, testDC );
+      }
+  }
+  if( timed == true && pwm == false )
+  {
+    profEventCancel();               /* no write follows, do not time it */
+  }
+}
+
+
+/*--------------------------------- evFrame() ---------------------------------
+ *
+ * every CAN frame, from frameHandler(). NV & event changes, diagnostics poll
+*/
+
+void evFrame( const uint8_t * data, uint8_t len, uint16_t nodeNum )
+{
+  cacheFrame( data, len, nodeNum );                 /* NV & event changes */
+  if( data[0] == OPC_RDGN_ && len >= 5 )            /* diagnostics poll  */
+  {
+    uint16_t nn = ( data[1] << 8 ) | data[2];
+
+    if( nn == nodeNum || nn == 0 )                  /* NN 0 polls all    */
+    {
+      dgnIndex = data[3];
+      dgnCode = data[4];
+      dgnLeft = 1;
+      if( dgnCode == PROFDGN_ALL )
+      {
+        dgnCode = PROFDGN_ISRMIN;
+        dgnLeft = QTY_PROFDGN - 1;
+      }
+    }
+  }
+  if( debug == true )     /* debug is toggled by serial monitor command */
+  {
+    uint8_t rx[LOG_ARGS];
+
+    rx[0] = len;
+    memcpy( &rx[1], data, ( len > 8 ? 8 : len ) );
+    logPutN( LOG_RX, rx, 1 + ( len > 8 ? 8 : len ) );
+  }
+}
+
+
+/*--------------------------------------- evPack() ----------------------------
+ *
+ * an event frame, opc NN EN, into data[]. Returns its len, EV_LEN
+*/
+
+uint8_t evPack( uint8_t * data, uint8_t opc, uint16_t nn, uint16_t en )
+{
+  data[0] = opc;
+  data[1] = nn >> 8;
+  data[2] = nn & 0xFF;
+  data[3] = en >> 8;
+  data[4] = en & 0xFF;
+  return EV_LEN;
+}
+
+
+/*--------------------------------------- evDiag() ----------------------------
+ *
+ * the next DGN reply to an RDGN into data[], see PROF.h. Returns its len, 0
+ *  if none is due. The caller counts it off, dgnCode++ & dgnLeft--, once it
+ *  is sent. Interrupts off, the ISR adds to PROF_ISR & PROF_EVENT.
+ *  DGN = NN, ServiceIndex, DiagCode, value hi, value lo
+*/
+
+uint8_t evDiag( uint8_t * data, uint16_t nn )
+{
+  if( dgnLeft == 0 )
+  {
+    return 0;
+  }
+  uint16_t val { 0 };
+
+  if( dgnCode == PROFDGN_RESET )
+  {
+    profReset();
+  }
+  else
+  {
+    val = profDiag( dgnCode );
+  }
+  data[0] = OPC_DGN_;
+  data[1] = nn >> 8;
+  data[2] = nn & 0xFF;
+  data[3] = dgnIndex;
+  data[4] = dgnCode;
+  data[5] = val >> 8;
+  data[6] = val & 0xFF;
+  return 7;
+}
+
+
+/*-------------------------------EVENT.cpp EoF ------------------------------*/
@@ -0,0 +1,57 @@
+/*file: EVENT.h     This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * CBUS event and frame handling, apart from the CBUS library
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * eventHandler() and frameHandler() in CANlights.ino only unpack the
+ *  CANFrame and call evEvent() and evFrame(). The frames sent are built by
+ *  evPack() and evDiag(). So the handling has no CBUS2515 in it, and
+ *  host/BUSsim.cpp runs the same code on several nodes over a virtual bus.
+ *
+ * Opcodes are as cbusdefs.h, not included here, as CACHE.cpp.
+*/
+#ifndef EVENT_H__  /* include guard */
+#define EVENT_H__
+
+#include "CHAN.h"
+
+
+const uint8_t OPC_ACON_  { 0x90 };   /* long event on, NN EN                 */
+const uint8_t OPC_ACOF_  { 0x91 };   /* long event off                       */
+const uint8_t OPC_ASON_  { 0x98 };   /* short event on, NN is the sender's   */
+const uint8_t OPC_ASOF_  { 0x99 };   /* short event off                      */
+const uint8_t OPC_ACON1_ { 0xB0 };   /* with 1 data byte                     */
+const uint8_t OPC_ACOF1_ { 0xB1 };
+const uint8_t OPC_ASON1_ { 0xB8 };
+const uint8_t OPC_ASOF1_ { 0xB9 };
+const uint8_t OPC_ACON2_ { 0xD0 };   /* with 2 data bytes                    */
+const uint8_t OPC_ACOF2_ { 0xD1 };
+const uint8_t OPC_ACON3_ { 0xF0 };   /* with 3 data bytes                    */
+const uint8_t OPC_ASON3_ { 0xF8 };
+const uint8_t OPC_RDGN_  { 0x87 };   /* diagnostics poll, NN SI code         */
+const uint8_t OPC_DGN_   { 0xC7 };   /* diagnostic reply, NN SI code value   */
+
+const uint8_t EV_LEN     { 5 };      /* opc, NN, EN                          */
+
+
+void    evEvent( uint8_t idx, const uint8_t * data, uint8_t len ); /* learned */
+void    evFrame( const uint8_t * data, uint8_t len, uint16_t nodeNum ); /* all */
+uint8_t evPack( uint8_t * data, uint8_t opc, uint16_t nn, uint16_t en );
+uint8_t evDiag( uint8_t * data, uint16_t nn ); /* next DGN, interrupts off   */
+
+bool    calibrate();                  /* CANlights.ino, host builds own it   */
+
+extern volatile bool swChange;        /* NightSw changed, taskPhase() acts   */
+extern bool    testCh;                /* a chan test is running              */
+extern bool    debug;                 /* log every frame rx, Serial '/'      */
+extern uint8_t dgnCode;               /* next DGN code to send, see PROF.h   */
+extern uint8_t dgnLeft;               /* DGN replies left to send            */
+
+
+#endif /* EVENT_H__
+ --------------------------------------- EoF ------------------------------
+*/
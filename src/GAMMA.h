@@ -0,0 +1,100 @@
+/*file: GAMMA.h     This is include file for CANlights.ino sketch
+ *-----------------------------------------------------------------------------
+ *
+ * Gamma corrected lookup tables, generated by the compiler
+ *
+ * tables remap requested light values (DC 0 - 255) to gamma-corrected PWM
+ *  values (0 - PWM_TOP). EG. with gamma 2.75, DC 127 maps to 602 of 4095,
+ *  15% PWM for 50% light output.
+ * Each chan picks a table with its Gamma NV. 0 is the default, 2.75.
+ * 12 bit output keeps low DCs apart. The old 8 bit table mapped DC 0 - 27
+ *  all to 0, so dusk fades stepped and snapped off.
+ *
+ * Exponents are in eighths, x^(k/8) is done as 3 square roots and k
+ *  multiplies. C++11 constexpr, so it builds with the AVR gcc.
+ */
+#ifndef GAMMA_H__  /* include guard */
+#define GAMMA_H__
+
+#include "CHAN.h"                     /* PWM_TOP and QTY_GAMMA               */
+
+
+constexpr uint8_t GAMMA8TH[QTY_GAMMA] /* exponent * 8, for Gamma NV 0 - 5  */
+{
+  22,                                 /* 0 = 2.75  default, as old GAMMA8   */
+  8,                                  /* 1 = 1.00  linear                   */
+  14,                                 /* 2 = 1.75                           */
+  18,                                 /* 3 = 2.25                           */
+  20,                                 /* 4 = 2.50                           */
+  24                                  /* 5 = 3.00                           */
+};
+
+
+constexpr double gammaSqrt( double x, double g, uint8_t n )  /* Newton      */
+{
+  return ( n == 0 ? g : gammaSqrt( x, 0.5 * ( g + x / g ), n - 1 ) );
+}
+
+constexpr double gammaRoot8( double x )              /* x ^ (1/8)           */
+{
+  return ( x <= 0 ? 0 : gammaSqrt( gammaSqrt( gammaSqrt( x, 1, 24 ), 1, 24 ),
+                                   1, 24 ) );
+}
+
+constexpr double gammaPow( double r, uint8_t k )     /* r ^ k               */
+{
+  return ( k == 0 ? 1 : r * gammaPow( r, k - 1 ) );
+}
+
+constexpr uint16_t gammaPWM( int dc, uint8_t k8 )    /* one table entry     */
+{
+  return (uint16_t) ( gammaPow( gammaRoot8( dc / 255.0 ), k8 ) * PWM_TOP + 0.5 );
+}
+
+
+/* Build table rows from a 0 - 255 integer pack, C++11 style */
+
+template< int... I > struct gammaSeq { };
+
+template< int N, int... I > struct gammaMkSeq : gammaMkSeq< N - 1, N - 1, I... > { };
+
+template< int... I > struct gammaMkSeq< 0, I... >
+{
+  typedef gammaSeq< I... > type;
+};
+
+template< typename S > struct gammaTab;
+
+template< int... I > struct gammaTab< gammaSeq< I... > >
+{
+  static constexpr uint16_t tab[QTY_GAMMA][256] PROGMEM  /* in flash */
+  {
+    { gammaPWM( I, GAMMA8TH[0] )... },
+    { gammaPWM( I, GAMMA8TH[1] )... },
+    { gammaPWM( I, GAMMA8TH[2] )... },
+    { gammaPWM( I, GAMMA8TH[3] )... },
+    { gammaPWM( I, GAMMA8TH[4] )... },
+    { gammaPWM( I, GAMMA8TH[5] )... }
+  };
+};
+
+template< int... I >
+constexpr uint16_t gammaTab< gammaSeq< I... > >::tab[QTY_GAMMA][256];
+
+static_assert( QTY_GAMMA == 6, "GAMMA tab needs a row per GAMMA8TH[]" );
+
+typedef gammaTab< gammaMkSeq< 256 >::type > GAMMA;
+
+static_assert( GAMMA::tab[0][0] == 0 && GAMMA::tab[0][255] == PWM_TOP,
+               "gamma table must span 0 - PWM_TOP" );
+
+
+inline uint16_t gammaLook( uint8_t g, uint8_t dc )   /* 1 table lookup      */
+{
+  return pgm_read_word( &GAMMA::tab[g][dc] );
+}
+
+
+#endif /*  GAMMA_H__
+ ------------------------------------ GAMMA.h EoF----------------------
+*/
@@ -0,0 +1,150 @@
+/*file: HAL.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Hardware Abstraction Layer, MEGA implementation. See HAL.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#ifdef ARDUINO            /* host builds provide their own HAL               */
+
+#include <CBUSconfig.h>
+#include <Streaming.h>
+
+#include "HAL.h"
+#include "PIN.h"
+#include "PWM.h"
+#include "BAM.h"
+#include "CACHE.h"
+#include "PROF.h"
+
+extern CBUSConfig config;             /* CBUSconf object in CANlights.ino    */
+
+
+/* Timer 2 chans are 8 bit. Their low DITHER_BITS are added up each tick and
+ *  the carry bumps the compare value, so the mean over 16 ticks is 12 bit.
+*/
+static uint16_t ditherVal[QTY_PWMCHAN];  /* 12 bit value, 8 bit timer chans */
+static uint8_t  ditherAcc[QTY_PWMCHAN];  /* sum of low bits, carry at 16     */
+static uint16_t ditherMask { 0 };     /* bit per chan with low bits set      */
+
+const uint8_t DITHER_LOW { ( 1U << DITHER_BITS ) - 1 };
+
+
+void halWritePWM( uint8_t ch, uint16_t pwm )
+{
+  if( profEvPending == true )         /* first PWM write after an event      */
+  {
+    uint8_t sreg = SREG;
+    cli();
+    profEventDone();
+    SREG = sreg;
+  }
+  if( ch >= QTY_PWMCHAN )             /* chan 11 up, GPIO, see BAM.h         */
+  {
+    uint8_t sreg = SREG;
+    cli();
+    bamWrite( ch - QTY_PWMCHAN, pwm );
+    SREG = sreg;
+    return;
+  }
+  uint8_t sreg = SREG;                /* called from ISR and background      */
+  cli();
+  if( OCR[ch].wide == true )          /* 16 bit store, timers share 1 TEMP   */
+  {
+    pwmWrite( ch, pwm );              /* direct to OCRnx, see PWM.h          */
+    SREG = sreg;
+    return;
+  }
+  ditherVal[ch] = pwm;
+  if( ( pwm & DITHER_LOW ) == 0 )
+  {
+    ditherMask &= ~( 1U << ch );
+    pwmWrite( ch, pwm >> DITHER_BITS );
+  }
+  else
+  {
+    ditherMask |= ( 1U << ch );       /* halDither() writes it from now on   */
+  }
+  SREG = sreg;
+}
+
+void halDither()
+{
+  uint16_t mask = ditherMask;
+
+  for( uint8_t ch = 0; mask != 0; ch++, mask >>= 1 )
+  {
+    if( mask & 1 )
+    {
+      uint16_t pwm = ditherVal[ch] >> DITHER_BITS;
+
+      ditherAcc[ch] += ditherVal[ch] & DITHER_LOW;
+      if( ditherAcc[ch] > DITHER_LOW )
+      {
+        ditherAcc[ch] -= DITHER_LOW + 1;
+        if( pwm < 0xFF )
+        {
+          pwm++;
+        }
+      }
+      pwmWrite( ch, pwm );
+    }
+  }
+}
+
+uint8_t halReadNV( uint8_t nv )
+{
+  return cacheNV( nv );               /* RAM copy, see CACHE.h               */
+}
+
+uint8_t halReadEE( uint16_t adr )
+{
+  return config.readEEPROM( adr );
+}
+
+void halWriteEE( uint16_t adr, uint8_t val )
+{
+  config.writeEEPROM( adr, val );
+}
+
+void halTransitLED( bool on )
+{
+  digitalWrite( LED_BUILTIN, on );
+}
+
+void halNightLED( bool on )
+{
+  digitalWrite( PINLEDORA, on );
+}
+
+void halIsrStart()
+{
+  PINTP_D31_HIGH;                     /* macro fast pin method. See PIN.h    */
+}
+
+void halIsrEnd()
+{
+  PINTP_D31_LOW;                      /* time from pin high to low is ISR    */
+  profAdd( PROF_ISR, TCNT1 );         /* Timer1 counts up from ISR call      */
+}
+
+void halWarn( const char * msg, uint8_t ch )
+{
+  Serial << endl << msg << ch + 1 << endl;
+}
+
+uint32_t halMillis()
+{
+  return millis();
+}
+
+uint32_t halMicros()
+{
+  return micros();
+}
+
+#endif /* ARDUINO */
+
+/*-------------------------------HAL.cpp EoF ------------------------------*/
@@ -0,0 +1,48 @@
+/*file: HAL.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Hardware Abstraction Layer for the channel engine (CHAN.cpp)
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The channel engine only talks to the hardware through these functions.
+ * HAL.cpp implements them for the MEGA. A host build (see host/) implements
+ *  them to simulate the module on a PC.
+*/
+#ifndef HAL_H__  /* include guard */
+#define HAL_H__
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#define PROGMEM                       /* host has one address space          */
+#define pgm_read_word( p )  ( *(p) )
+#define pgm_read_byte( p )  ( *(p) )
+#define PSTR( s )           ( s )
+#define strcpy_P( d, s )    strcpy( (d), (s) )
+#define snprintf_P          snprintf
+#endif
+
+
+void    halWritePWM( uint8_t ch, uint16_t pwm ); /* set chan PWM, 0 - PWM_TOP */
+void    halDither();                            /* each tick, 8 bit timer chans */
+uint8_t halReadNV( uint8_t nv );                /* read Node Variable 1 - 70  */
+uint8_t halReadEE( uint16_t adr );              /* read EEPROM byte           */
+void    halWriteEE( uint16_t adr, uint8_t val ); /* write EEPROM byte         */
+void    halTransitLED( bool on );               /* LED_BUILTIN, DC transit    */
+void    halNightLED( bool on );                 /* orange LED, Night          */
+void    halIsrStart();                          /* test point high, ISR start */
+void    halIsrEnd();                            /* test point low, ISR end    */
+void    halWarn( const char * msg, uint8_t ch );  /* print warning + chan num */
+uint32_t halMillis();                           /* ms since power on, clock   */
+uint32_t halMicros();                           /* us since power on, PROF.h  */
+
+
+#endif /* HAL_H__
+ --------------------------------------- EoF ------------------------------
+*/
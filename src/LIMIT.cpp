@@ -0,0 +1,182 @@
+/*file: LIMIT.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Soft current limiter. See LIMIT.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "LIMIT.h"
+#include "GAMMA.h"            /* Gamma correction tables                      */
+
+
+static struct fullMA_t                /* chan mA at PWM_TOP                 */
+{
+  uint16_t mA[QTY_CHAN];
+
+  fullMA_t()                          /* LIM_FULLMA till set, any CHANS      */
+  {
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      mA[ch] = LIM_FULLMA;
+    }
+  }
+} full;
+
+static uint8_t  curve[QTY_CHAN][LIM_POINTS]; /* measured, LIM_UNITMA       */
+static chanBits_t curved { 0 };       /* bit per chan, curve[] is set        */
+
+static limStat_t lim { 0, LIM_BUDGETMA, PWM_SCALE1, LIM_TRIM1, 0 };
+static uint32_t  msTrim { 0 };        /* halMillis() at last trim            */
+
+
+void limSetFull( uint8_t ch, uint16_t mA )
+{
+  full.mA[ch] = mA;
+  curved &= ~( (chanBits_t) 1 << ch );
+}
+
+
+void limSetCurve( uint8_t ch, const uint8_t * pts )
+{
+  for( uint8_t p = 0; p < LIM_POINTS; p++ )
+  {
+    curve[ch][p] = pts[p];
+  }
+  full.mA[ch] = pts[LIM_POINTS - 1] * LIM_UNITMA;
+  curved |= ( (chanBits_t) 1 << ch );
+}
+
+
+uint16_t limFull( uint8_t ch )
+{
+  return full.mA[ch];
+}
+
+
+void limGet( limStat_t & s )
+{
+  s = lim;
+}
+
+
+/*------------------------------------------ limPwmMA() --------------------
+ *
+ * model mA of a chan at a raw PWM. LEDs on a constant Volt supply draw in
+ *  proportion to PWM on time, so a chan with no curve is a straight line.
+ *  A curve is straight between points 1024 PWM apart, no divide. PWM_TOP
+ *  counts as the top point.
+*/
+
+uint16_t limPwmMA( uint8_t ch, uint16_t pwm )
+{
+  if( ( curved & ( (chanBits_t) 1 << ch ) ) == 0 )
+  {
+    return ( (uint32_t) full.mA[ch] * pwm ) >> PWM_BITS;
+  }
+  uint8_t  p = pwm >> LIM_PTSHIFT;                  /* point above is p      */
+  uint16_t frac = pwm & ( ( 1U << LIM_PTSHIFT ) - 1 );
+  int16_t  y0 = ( p == 0 ? 0 : curve[ch][p - 1] * LIM_UNITMA );
+  int16_t  y1 = curve[ch][p < LIM_POINTS ? p : LIM_POINTS - 1] * LIM_UNITMA;
+
+  return y0 + ( ( (int32_t) ( y1 - y0 ) * frac ) >> LIM_PTSHIFT );
+}
+
+
+uint16_t limChanMA( uint8_t ch, uint8_t dc )  /* model mA at dc, chan gamma  */
+{
+  return limPwmMA( ch, gammaLook( chanCfg( ch ).gamma, dc ) );
+}
+
+
+/*------------------------------------------ limPlanMA() -------------------
+ *
+ * predicted total mA. A chan in TRANSIT, or in the last second of its DELAY,
+ *  counts the higher of now and its phase dc. An EFFECT counts its level,
+ *  DC1. Earlier DELAY seconds count now, a 010 chan is not held at both
+ *  ends. Saturates at 0xFFFF.
+*/
+
+uint16_t limPlanMA()
+{
+  uint32_t sum { 0 };
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    uint8_t dc = var[ch].dcCur;
+    uint8_t to = dc;
+    uint8_t ph = var[ch].phase;
+    const cfg_t & c = chanCfg( ch );
+
+    switch( var[ch].state )
+    {
+      case STATE_DELAY :
+        if( var[ch].secCount >= c.secDelay[ph] )  /* transit in 1 s or less */
+        {
+          to = c.dc[ph];
+        }
+        break;
+      case STATE_TRANSIT : to = c.dc[ph]; break;
+      case STATE_EFFECT :  to = c.dc[1]; break;
+      default :            break;
+    }
+    sum += limChanMA( ch, ( to > dc ? to : dc ) );
+  }
+  return ( sum > 0xFFFF ? 0xFFFF : sum );
+}
+
+
+/*------------------------------------------ limUpdate() -------------------
+ *
+ * work out pwmScale from the plan. Called each ms, Power task, with the Amp
+ *  reading in mA. Scale down is at once, scale up and trim every LIM_TRIMMS,
+ *  so a fading chan does not rescale every chan each tick.
+ * Trim takes the budget down while the reading is 1/16 over it, and back
+ *  slowly once the reading is 1/8 under.
+ * Returns true when limiting starts or ends, for the log.
+*/
+
+bool limUpdate( uint16_t mA )
+{
+  uint32_t ms = halMillis();
+  bool tick = ( ms - msTrim >= LIM_TRIMMS );
+
+  if( tick == true )
+  {
+    msTrim = ms;
+    if( mA > LIM_BUDGETMA + LIM_BUDGETMA / 16 && lim.trim > LIM_TRIMMIN )
+    {
+      lim.trim -= 2;
+    }
+    else if( mA < LIM_BUDGETMA - LIM_BUDGETMA / 8 && lim.trim < LIM_TRIM1 )
+    {
+      lim.trim++;
+    }
+    lim.budgetMA = ( (uint32_t) LIM_BUDGETMA * lim.trim ) >> 7;
+  }
+  lim.planMA = limPlanMA();
+
+  uint8_t scale { PWM_SCALE1 };
+  if( lim.planMA > lim.budgetMA )
+  {
+    scale = ( (uint32_t) lim.budgetMA << 7 ) / lim.planMA;
+    scale = ( scale == 0 ? 1 : scale );
+  }
+  if( scale < lim.scale || ( tick == true && scale != lim.scale ) )
+  {
+    bool was = ( lim.scale != PWM_SCALE1 );
+
+    lim.scale = scale;
+    pwmScale = scale;                 /* 1 byte, ISR rescales next tick      */
+    if( was != ( scale != PWM_SCALE1 ) )
+    {
+      lim.limits += ( was == false );
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/*-------------------------------LIMIT.cpp EoF ------------------------------*/
@@ -0,0 +1,65 @@
+/*file: LIMIT.h     This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Soft current limiter. Predicts total LED current, scales all PWM to fit
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Each chan draws about limFull( ch ) mA at PWM_TOP, and in proportion to its
+ *  gamma corrected PWM below that. Once calibrated, a chan has a curve of
+ *  LIM_POINTS measured mA instead, see CAL.h
+ * The plan is the sum, with each chan at the higher of its dc now and the dc
+ *  it is heading for. So a DELAY chan counts its next level before its
+ *  transit starts.
+ *
+ * Plan over the budget scales every PWM write by budget / plan, in the ISR.
+ *  DCs and timings are not touched, only the PWM value written, so the
+ *  scene dims evenly and comes back when the plan drops. The filtered Amp
+ *  reading trims the budget down if the chan mA figures are low.
+ *
+ * Power::testAmpAndVolt() still trips at MAXAMPADCREAD, as the last resort.
+ *
+ * limUpdate() is for loop() context. The ISR only reads pwmScale, one byte.
+*/
+#ifndef LIMIT_H__  /* include guard */
+#define LIMIT_H__
+
+#include "CHAN.h"
+
+
+const uint16_t LIM_BUDGETMA { 1800 };  /* plan budget, hard trip is 2046 mA   */
+const uint16_t LIM_FULLMA   { 200 };   /* chan mA at PWM_TOP, till calibrated */
+const uint16_t LIM_TRIMMS   { 100 };   /* ms between Amp trims & scale ups    */
+const uint8_t  LIM_TRIM1    { 128 };   /* trim Q7, 128 = budget as is         */
+const uint8_t  LIM_TRIMMIN  { 64 };    /* trim no lower than half budget      */
+
+const uint8_t  LIM_POINTS   { 4 };     /* curve mA at PWM 1/4, 1/2, 3/4, TOP  */
+const uint8_t  LIM_PTSHIFT  { PWM_BITS - 2 };  /* PWM to curve point         */
+const uint8_t  LIM_UNITMA   { 8 };     /* curve byte units, 255 is 2040 mA    */
+
+
+struct limStat_t
+{
+  uint16_t  planMA;       /* predicted total, before scaling                 */
+  uint16_t  budgetMA;     /* budget after trim                               */
+  uint8_t   scale;        /* pwmScale, PWM_SCALE1 is no limit                */
+  uint8_t   trim;         /* budget trim, LIM_TRIM1 is none                  */
+  uint16_t  limits;       /* times limiting started                          */
+};
+
+
+bool     limUpdate( uint16_t mA );         /* from loop(), true on start/end  */
+uint16_t limChanMA( uint8_t ch, uint8_t dc ); /* model mA, dc at chan gamma   */
+uint16_t limPwmMA( uint8_t ch, uint16_t pwm ); /* model mA at raw PWM         */
+uint16_t limPlanMA();                      /* predicted total mA, unscaled    */
+void     limSetFull( uint8_t ch, uint16_t mA ); /* chan mA at PWM_TOP, linear */
+void     limSetCurve( uint8_t ch, const uint8_t * pts ); /* LIM_POINTS bytes  */
+uint16_t limFull( uint8_t ch );
+void     limGet( limStat_t & s );
+
+
+#endif /* LIMIT_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,192 @@
+/*file: LOG.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Deferred log ring, text and binary formats. See LOG.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * No Serial here. The sketch writes the lines, host/LOGdec.cpp reuses the
+ *  formatter to decode binary captures.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "LOG.h"
+
+
+uint16_t logDropped { 0 };             /* records dropped, ring full         */
+
+static logRec_t ring[LOG_QTY];         /* records, oldest at tail            */
+static uint8_t  head { 0 };            /* next free slot                     */
+static uint8_t  tail { 0 };            /* oldest record                      */
+static uint16_t dropShown { 0 };       /* logDropped as last reported        */
+
+
+static logRec_t * logSlot( LOG_t id )  /* next free slot, NULL if ring full   */
+{
+  if( (uint8_t)( head - tail ) >= LOG_QTY )
+  {
+    logDropped++;
+    return NULL;
+  }
+  logRec_t * r = &ring[head & ( LOG_QTY - 1 )];
+  head++;
+  r->ms = halMillis();
+  r->id = id;
+  return r;
+}
+
+
+/*------------------------------------------ logPut() -----------------------
+ *
+ * queue a record with up to 5 byte args. Never waits.
+*/
+
+void logPut( LOG_t id, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3,
+             uint8_t a4 )
+{
+  logRec_t * r = logSlot( id );
+
+  if( r != NULL )
+  {
+    r->len = 5;
+    r->arg[0] = a0;
+    r->arg[1] = a1;
+    r->arg[2] = a2;
+    r->arg[3] = a3;
+    r->arg[4] = a4;
+  }
+}
+
+
+/*------------------------------------------ logPutN() ----------------------
+ *
+ * queue a record with raw arg bytes, EG. a CAN frame. Cut to LOG_ARGS.
+*/
+
+void logPutN( LOG_t id, const uint8_t * arg, uint8_t len )
+{
+  logRec_t * r = logSlot( id );
+
+  if( r != NULL )
+  {
+    r->len = ( len > LOG_ARGS ? LOG_ARGS : len );
+    memcpy( r->arg, arg, r->len );
+  }
+}
+
+
+/*------------------------------------------ logPop() -----------------------
+ *
+ * take the oldest record. New drops are reported first, as a LOG_DROP.
+*/
+
+bool logPop( logRec_t & rec )
+{
+  if( logDropped != dropShown )
+  {
+    dropShown = logDropped;
+    rec.ms = halMillis();
+    rec.id = LOG_DROP;
+    rec.len = 2;
+    rec.arg[0] = dropShown >> 8;
+    rec.arg[1] = dropShown & 0xFF;
+    return true;
+  }
+  if( head == tail )
+  {
+    return false;
+  }
+  rec = ring[tail & ( LOG_QTY - 1 )];
+  tail++;
+  return true;
+}
+
+
+/*------------------------------------------ logFormat() --------------------
+ *
+ * record as a text line, "[ms] text". Returns line length.
+*/
+
+uint8_t logFormat( const logRec_t & rec, char * buf, uint8_t size )
+{
+  char    fmt[LOGFMT_LEN];                        /* format, from flash    */
+  const char * f = fmt;
+  uint8_t a = 0;                                  /* next arg byte         */
+  int n = snprintf_P( buf, size, PSTR( "[%lu] " ), (unsigned long) rec.ms );
+
+  if( rec.id >= QTY_LOG )
+  {
+    return snprintf_P( buf + n, size - n, PSTR( "? id %u" ), rec.id ) + n;
+  }
+  strcpy_P( fmt, LOGFMT[rec.id] );
+  for( ; *f != '\0' && n < size - 1; f++ )
+  {
+    if( *f != '%' || f[1] == '\0' )
+    {
+      buf[n++] = *f;
+      continue;
+    }
+    uint8_t b  = ( a < rec.len ? rec.arg[a] : 0 );
+    uint8_t b1 = ( a + 1 < rec.len ? rec.arg[a + 1] : 0 );
+
+    switch( *++f )
+    {
+      case 'u' :
+        n += snprintf_P( buf + n, size - n, PSTR( "%u" ), b );
+        a++;
+        break;
+      case 'w' :
+        n += snprintf_P( buf + n, size - n, PSTR( "%u" ),
+                         (unsigned)( ( b << 8 ) | b1 ) );
+        a += 2;
+        break;
+      case 'x' :
+        n += snprintf_P( buf + n, size - n, PSTR( "%02X" ), b );
+        a++;
+        break;
+      case 'o' :
+        buf[n++] = ( b != 0 ? 'N' : 'F' );
+        a++;
+        break;
+      case 'h' :
+        for( ; a < rec.len && n < size - 1; a++ )
+        {
+          n += snprintf_P( buf + n, size - n, PSTR( " %02X" ), rec.arg[a] );
+        }
+        break;
+      default :
+        buf[n++] = *f;
+    }
+  }
+  if( n > size - 1 )
+  {
+    n = size - 1;
+  }
+  buf[n] = '\0';
+  return n;
+}
+
+
+/*------------------------------------------ logEncode() --------------------
+ *
+ * record as binary, LOG_SYNC ms id len args. Returns byte count.
+*/
+
+uint8_t logEncode( const logRec_t & rec, uint8_t * buf )
+{
+  buf[0] = LOG_SYNC;
+  buf[1] = rec.ms & 0xFF;
+  buf[2] = ( rec.ms >> 8 ) & 0xFF;
+  buf[3] = ( rec.ms >> 16 ) & 0xFF;
+  buf[4] = ( rec.ms >> 24 ) & 0xFF;
+  buf[5] = rec.id;
+  buf[6] = rec.len;
+  memcpy( &buf[7], rec.arg, rec.len );
+  return 7 + rec.len;
+}
+
+
+/*-------------------------------LOG.cpp EoF ------------------------------*/
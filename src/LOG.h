@@ -0,0 +1,137 @@
+/*file: LOG.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Deferred log. Fixed size binary records in a RAM ring, formatted later.
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Event, frame and fault paths only call logPut(), a copy of a few bytes.
+ *  loop() drains one record a pass, and only when Serial has room to take
+ *  the line without waiting. So a busy bus is never held up by 115200 baud.
+ * A full ring drops new records and counts them. The count is reported as
+ *  a LOG_DROP record when the ring drains.
+ *
+ * Records go out as text, or in binary mode ('b' command) as...
+ *   0xA5, ms (4 bytes, little end), id, len, arg[len]
+ *  host/LOGdec.cpp decodes a binary capture to the same text.
+ *
+ * NB. logPut() is for loop() context, CBUS handlers included. Not ISRs.
+*/
+#ifndef LOG_H__  /* include guard */
+#define LOG_H__
+
+#include "HAL.h"
+
+
+const uint8_t LOG_QTY  { 16 };    /* records in ring, power of 2            */
+const uint8_t LOG_ARGS { 10 };    /* max arg bytes, a CAN frame and its len */
+const uint8_t LOG_LINE { 56 };    /* max text line, with ms stamp           */
+const uint8_t LOG_BIN  { 7 + LOG_ARGS };  /* max binary record bytes        */
+const uint8_t LOG_SYNC { 0xA5 };  /* binary record start byte               */
+
+static_assert( ( LOG_QTY & ( LOG_QTY - 1 ) ) == 0, "LOG_QTY is power of 2" );
+
+
+enum LOG_t : uint8_t  /* record ids, args are in LOGFMT[] */
+{
+  LOG_DROP      = 0,      /* records dropped, ring was full                */
+  LOG_EVNIGHT   = 1,      /* NightSw event                                 */
+  LOG_EVIGNORE  = 2,      /* event ignored                                 */
+  LOG_EVSHUT    = 3,      /* ShutDown event                                */
+  LOG_EVTESTEND = 4,      /* TestEnd event, ends a chan test               */
+  LOG_EVTEST    = 5,      /* TestChX event                                 */
+  LOG_EVTESTSW  = 6,      /* chan test ended by a new chan test            */
+  LOG_EVUNKNOWN = 7,      /* event value unknown                           */
+  LOG_RX        = 8,      /* CAN frame rx, debug on                        */
+  LOG_TX        = 9,      /* ACON/ACOF sent                                */
+  LOG_TXERR     = 10,     /* send failed, MCP2515 error flags              */
+  LOG_FAULT     = 11,     /* over Amp or under Volt                        */
+  LOG_POWEROK   = 12,     /* fault cleared, PWM restored                   */
+  LOG_LOCALSW   = 13,     /* local NightSw input changed                   */
+  LOG_EVSCENE   = 14,     /* scene recalled                                */
+  LOG_EVNOSCENE = 15,     /* scene recall, but scene is empty              */
+  LOG_LIMIT     = 16,     /* soft current limit started, see LIMIT.h       */
+  LOG_LIMITEND  = 17,     /* soft current limit ended                      */
+  LOG_CALDONE   = 18,     /* chan current calibration stored, see CAL.h    */
+  LOG_CALOPEN   = 19,     /* chan open string, calibration or live check   */
+  LOG_CALSHORT  = 20,     /* chan short at calibration                     */
+  LOG_CALDRIFT  = 21,     /* Amp reading does not fit the chan model       */
+  LOG_EVCAL     = 22,     /* Calibrate event, calibration started          */
+  LOG_SNAP      = 23,     /* warm restart snapshot saved, see SNAP.h       */
+  LOG_CANDOWN   = 24,     /* CBUS.begin() failed, retry from loop()        */
+  LOG_CANUP     = 25,     /* CBUS.begin() done                             */
+  LOG_SYNCSTEP  = 26,     /* sync error too big to slew, see SYNC.h        */
+  LOG_SYNCLATE  = 27,     /* no start frame in time, or it was late        */
+  LOG_SYNCLOST  = 28,     /* no sync frames, free runs                     */
+  LOG_SEQPUT    = 29,     /* program image bytes written, see SEQ.h        */
+  LOG_SEQLOAD   = 30      /* program image loaded, or bad crc              */
+};
+const uint8_t QTY_LOG { 31 };
+
+
+/* Text formats. %u byte, %w 16 bit word (hi, lo), %x hex byte,
+ *  %o ON/OFF byte as N or F, %h rest of args as hex bytes.
+ * In flash, rows of LOGFMT_LEN. logFormat() copies one out with strcpy_P()
+*/
+const uint8_t LOGFMT_LEN { 40 };      /* longest format + '\0'               */
+
+const char LOGFMT[QTY_LOG][LOGFMT_LEN] PROGMEM
+{
+  "! log dropped %w",
+  "> Ev *O%o NightSw=%u",
+  "> Ev *O%o eVal=%u ignore",
+  "> Ev *O%o ShutDown",
+  "> Ev *O%o TestEnd TestCh%u",
+  "> Ev *O%o TestCh%u dc=%u",
+  "> Ev end TestCh%u",
+  "> Ev *O%o eVal=%u unknown!",
+  "> rx len%u%h",
+  "< tx ACO%o n%w e%w",
+  "! tx Error 0x%x",
+  "! OverAmp/UnderVolt Amp=%wmA peak=%wmA",
+  " Power OK",
+  " local NightSw=%u",
+  "> Ev *O%o Scene%u",
+  "> Ev *O%o Scene%u empty!",
+  "! soft limit plan=%wmA scale=%u/128",
+  " soft limit end plan=%wmA",
+  " calibrated, base=%wmA open %u short %u",
+  "! ch%u open string?",
+  "! ch%u short",
+  "! Amp=%wmA, chan model=%wmA",
+  "> Ev *O%o Calibrate",
+  " snapshot seq %u slot %u",
+  "! CAN begin ErrFlg 0x%x, retry",
+  " CAN up, %u tries",
+  "! sync step %w ticks",
+  "! sync start late %u ms, phase now",
+  "! sync lost",
+  "> Ev seq put %u %x %x",
+  "> Ev seq load ok=%u"
+};
+
+
+struct logRec_t
+{
+  uint32_t  ms;           /* halMillis() at logPut()                         */
+  LOG_t     id;           /* record id                                       */
+  uint8_t   len;          /* arg bytes used                                  */
+  uint8_t   arg[LOG_ARGS];
+};
+
+
+void    logPut( LOG_t id, uint8_t a0 = 0, uint8_t a1 = 0, uint8_t a2 = 0,
+                uint8_t a3 = 0, uint8_t a4 = 0 );    /* queue, 0 - 5 args   */
+void    logPutN( LOG_t id, const uint8_t * arg, uint8_t len ); /* raw args   */
+bool    logPop( logRec_t & rec );      /* oldest record, false if empty      */
+uint8_t logFormat( const logRec_t & rec, char * buf, uint8_t size ); /* text */
+uint8_t logEncode( const logRec_t & rec, uint8_t * buf ); /* binary, bytes   */
+
+extern uint16_t logDropped;            /* records dropped, ring full         */
+
+
+#endif /* LOG_H__
+ --------------------------------------- EoF ------------------------------
+*/
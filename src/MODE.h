@@ -0,0 +1,120 @@
+/*file: MODE.h      This is include file for CANlights.ino sketch
+ *-----------------------------------------------------------------------------
+ *
+ * Mode transition table. What a chan does next, for each mode
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Indexed by [mode][trigger][phase], gives the next state & phase. So the
+ *  ISR does one table read, not a switch that grows with every mode.
+ *  A new mode is a new row. See Channel Modes in CHAN.h
+ *
+ * Triggers...
+ *  TRIG_DAY, TRIG_NIGHT         input changed, new phase. See newPhase()
+ *  TRIG_DONEDAY, TRIG_DONENIGHT transit done, input as now. See processChan()
+ *
+ * Entry is NX_xy, x = state (S steady, T transit, D delay, E effect),
+ *  y = phase, plus
+ *  NX_KEEP  new phase only. A chan not STEADY carries on, edge ignored
+ *  NX_RAND  delay is random, 1 to secDelay + 1 seconds
+ *  NX_NOW   zero secDelay skips the delay, transits in this tick
+ *
+ * STEADY after a transit keeps the phase, so it is given per phase.
+*/
+#ifndef MODE_H__  /* include guard */
+#define MODE_H__
+
+
+enum TRIG_t : uint8_t   /* what happened to the chan */
+{
+  TRIG_DAY       = 0,     /* input changed to DAY. nightSw = 0               */
+  TRIG_NIGHT     = 1,     /* input changed to NIGHT. nightSw = 1             */
+  TRIG_DONEDAY   = 2,     /* transit done, input is DAY                      */
+  TRIG_DONENIGHT = 3      /* transit done, input is NIGHT                    */
+};
+const uint8_t QTY_TRIG { 4 };
+
+
+constexpr uint8_t nx( STATE_t s, uint8_t phase )  /* table entry, no flags */
+{
+  return ( s << 1 ) | phase;
+}
+
+const uint8_t NX_S0   { nx( STATE_STEADY,  0 ) };
+const uint8_t NX_S1   { nx( STATE_STEADY,  1 ) };
+const uint8_t NX_T0   { nx( STATE_TRANSIT, 0 ) };
+const uint8_t NX_D0   { nx( STATE_DELAY,   0 ) };
+const uint8_t NX_D1   { nx( STATE_DELAY,   1 ) };
+const uint8_t NX_E1   { nx( STATE_EFFECT,  1 ) };
+
+const uint8_t NX_KEEP { 0x10 };
+const uint8_t NX_RAND { 0x20 };
+const uint8_t NX_NOW  { 0x40 };
+
+
+const uint8_t MODENEXT[QTY_MODEROW][QTY_TRIG][2] PROGMEM  /* [mode][trig][ph] */
+{
+  { /* DAYNIGHT  either edge, to the input's phase                            */
+    { NX_D0, NX_D0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_S0, NX_S1 }
+  },
+  { /* DUSK      NIGHT runs 1 then 0, DAY goes to 0                           */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_D0 }, { NX_S0, NX_D0 }
+  },
+  { /* DAWN      DAY runs 1 then 0, NIGHT goes to 0                           */
+    { NX_D1, NX_D1 }, { NX_T0, NX_T0 }, { NX_S0, NX_D0 }, { NX_S0, NX_D0 }
+  },
+  { /* DUSKDAWN  either edge runs 1 then 0                                    */
+    { NX_D1, NX_D1 }, { NX_D1, NX_D1 }, { NX_S0, NX_D0 }, { NX_S0, NX_D0 }
+  },
+  { /* NIGHT010  1 0 1 0.. while NIGHT, DAY goes to 0                         */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_D1, NX_D0 }
+  },
+  { /* DAY010    1 0 1 0.. while DAY, NIGHT goes to 0                         */
+    { NX_D1, NX_D1 }, { NX_T0, NX_T0 }, { NX_D1, NX_D0 }, { NX_S0, NX_S1 }
+  },
+  { /* ALWAYS010 1 0 1 0.. from power on, input ignored                       */
+    { NX_D1 | NX_KEEP, NX_D1 | NX_KEEP }, { NX_D1 | NX_KEEP, NX_D1 | NX_KEEP },
+    { NX_D1, NX_D0 }, { NX_D1, NX_D0 }
+  },
+  { /* RANDOM010 as NIGHT010, random delays                                   */
+    { NX_T0, NX_T0 }, { NX_D1 | NX_RAND, NX_D1 | NX_RAND },
+    { NX_S0, NX_S1 }, { NX_D1 | NX_RAND, NX_D0 | NX_RAND }
+  },
+  { /* ONESHOT   NIGHT runs 1 then 0 once, edges ignored while it runs        */
+    { NX_T0 | NX_KEEP, NX_T0 | NX_KEEP }, { NX_D1 | NX_KEEP, NX_D1 | NX_KEEP },
+    { NX_S0, NX_D0 }, { NX_S0, NX_D0 }
+  },
+  { /* FLICKER   NIGHT fades up, flickers. DAY goes to 0                     */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_S0, NX_E1 }
+  },
+  { /* FIRE      as FLICKER                                                   */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_S0, NX_E1 }
+  },
+  { /* ARC       as FLICKER                                                   */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_S0, NX_E1 }
+  },
+  { /* STROBE    as FLICKER                                                   */
+    { NX_T0, NX_T0 }, { NX_D1, NX_D1 }, { NX_S0, NX_S1 }, { NX_S0, NX_E1 }
+  },
+  { /* SEQ       runs the program, edges only start it if STEADY, waiting   */
+    { NX_E1 | NX_KEEP, NX_E1 | NX_KEEP }, { NX_E1 | NX_KEEP, NX_E1 | NX_KEEP },
+    { NX_E1, NX_E1 }, { NX_E1, NX_E1 }
+  },
+  { /* SCENE     set by startScene(), to the scene dc and stay                */
+    { NX_D1 | NX_NOW, NX_D1 | NX_NOW }, { NX_D1 | NX_NOW, NX_D1 | NX_NOW },
+    { NX_S0, NX_S1 }, { NX_S0, NX_S1 }
+  }
+};
+
+
+inline uint8_t modeNext( MODE_t mode, uint8_t trig, uint8_t phase )
+{
+  return pgm_read_byte( &MODENEXT[mode][trig][phase] );
+}
+
+
+#endif /*  MODE_H__
+ ------------------------------------ MODE.h EoF----------------------
+*/
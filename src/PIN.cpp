@@ -8,6 +8,7 @@
  * Author: Dave Harris. Andover, UK. © Dave Harris 2021
 */
 #include "PIN.h"
+#include "PWM.h"
 
 
 /*------------------------------ setupPins() ----------------------------------
@@ -51,10 +52,15 @@ void setupPins()
   PINTP_D31_HIGH;
   PINTP_D31_LOW;                       /* macro fast pin method. See PIN.h    */
 
-  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
-  {                                    /*   loop all PWM channels             */
+  for( uint8_t ch = 0; ch < QTY_PWMCHAN; ch++ )
+  {                                    /*   loop all timer PWM channels       */
     pinMode( PWMPIN[ch], OUTPUT );
-    analogWrite( PWMPIN[ch], 0 );
+    pwmConnect( ch );                  /* DC 0, PWM on. No analogWrite()     */
+  }
+  for( uint8_t i = 0; i < QTY_BAMCHAN; i++ )
+  {                                    /*   chans 11 up, BAM.h drives them   */
+    pinMode( BAMPIN[i].pin, OUTPUT );
+    digitalWrite( BAMPIN[i].pin, LOW );
   }
 }
 
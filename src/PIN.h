@@ -13,10 +13,14 @@
 #ifndef PIN_H__  /* include guard */
 #define PIN_H__
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else                                /* host build, see host/                */
+#include <stdint.h>
+const uint8_t A0 { 54 }, A12 { 66 }, A14 { 68 };  /* MEGA analog pin nums  */
+#endif
 
-
-const uint8_t QTY_CHAN { 10 };       /* qty of PWM channels for LED chans    */
+#include "CHAN.h"                    /* QTY_CHAN qty of PWM chans for LEDs   */
 
 
 /* Define the pins used
@@ -50,15 +54,56 @@ const uint8_t QTY_CHAN { 10 };       /* qty of PWM channels for LED chans    */
  *  44  5C    Free.  Assigned to PWM7.
  *  45  5B    Free.  Assigned to PWM8.
  *  46  5A    Free.  Assigned to PWM9.
+ *
+ *  CHANS over 10 takes timer 1 from TimerOne for BAM, see BAM.h. It still
+ *   gives the 1 ms tick.
 *  
 *  
- * Array of PWM pins
+ * Array of PWM pins. PWM.h maps them to timer compare registers and the
+ *  compiler checks them against this table.
+*/
+constexpr uint8_t PWMPIN[QTY_PWMCHAN] { 3, 5, 6, 7, 8, 9, 10, 44, 45, 46 };
+
+
+/* BAM chans 11 up, see CHANS in CHAN.h and BAM.h. Bits of 3 whole ports
+ *  that nothing else uses. The BAM ISR writes these ports, so nothing else
+ *  may write them after setupPins(). Their other bits keep their values.
+ *  Port  bits        pins
+ *   A    PA0 - PA5   22 - 27       PA6, PA7 are PINCBUS, PINCAN pull ups
+ *   L    PL0 - PL2   49, 48, 47    PL3 - PL5 are PWM9 - PWM7, timer 5
+ *        PL6, PL7    43, 42
+ *   K    PK0 - PK2   A8 - A10      PK4, PK6 are PINNIGHTSW, PINBLUE
 */
-const uint8_t PWMPIN[QTY_CHAN] { 3, 5, 6, 7, 8, 9, 10, 44, 45, 46 };
+enum BAMPORT_t : uint8_t
+{
+  BAMPORT_A = 0,
+  BAMPORT_L = 1,
+  BAMPORT_K = 2
+};
+const uint8_t QTY_BAMPORT { 3 };
+
+struct bamPin_t
+{
+  uint8_t   pin;          /* Arduino pin number                              */
+  uint8_t   port;         /* BAMPORT_t                                       */
+  uint8_t   bit;          /* port bit 0 - 7                                  */
+};
+
+constexpr bamPin_t BAMPIN[QTY_BAMMAX]       /* chan 11 first                 */
+{
+  { 22, BAMPORT_A, 0 }, { 23, BAMPORT_A, 1 }, { 24, BAMPORT_A, 2 },
+  { 25, BAMPORT_A, 3 }, { 26, BAMPORT_A, 4 }, { 27, BAMPORT_A, 5 },
+  { 49, BAMPORT_L, 0 }, { 48, BAMPORT_L, 1 }, { 47, BAMPORT_L, 2 },
+  { 43, BAMPORT_L, 6 }, { 42, BAMPORT_L, 7 },
+  { 62, BAMPORT_K, 0 }, { 63, BAMPORT_K, 1 }, { 64, BAMPORT_K, 2 }
+};
 
 /* Alarm & status outputs */
 
-const uint8_t PINAWDSIG { 37 };      /* AudioWarningDevice signal            */
+const uint8_t PINAWDSIG { 37 };      /* AudioWarningDevice signal, PC0       */
+                                  /* macros, 1 instruction, safe in ISR   */
+#define PINAWD_TOGGLE   PINC = B00000001
+#define PINAWD_LOW      PORTC = PORTC & B11111110
 const uint8_t PINLEDRED { 36 };      /* Red LED.    Error/Alarm              */
 const uint8_t PINLEDGRN { 35 };      /* Green LED.  CBUS SLiM                */
 const uint8_t PINLEDYEL { 34 };      /* Yellow LED. CBUS FLiM                */
@@ -0,0 +1,146 @@
+/*file: PROF.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Always on latency profiler. See PROF.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "PROF.h"
+
+
+static profStat_t prof[QTY_PROF];
+
+volatile bool profEvPending { false };
+static uint32_t evStart;              /* halMicros() at profEventMark()      */
+
+
+/*------------------------------------------ profAdd() ---------------------
+ *
+ * add 1 value. Cheap enough for the ISR, no divide. Bucket is the top set
+ *  bit, found 8 bits at a time first.
+*/
+
+void profAdd( PROF_t p, uint32_t val )
+{
+  profStat_t & s = prof[p];
+  uint8_t b { 0 };
+
+  if( s.n == 0 || val < s.min )
+  {
+    s.min = val;
+  }
+  if( val > s.max )
+  {
+    s.max = val;
+  }
+  if( s.sum > 0x7FFFFFFFUL - val )    /* keep the mean, lose old weight     */
+  {
+    s.sum >>= 1;
+    s.n >>= 1;
+  }
+  s.sum += val;
+  s.n++;
+
+  for( uint32_t v = val >> 8; v != 0 && b < 24; v >>= 8 )
+  {
+    b += 8;
+  }
+  for( uint8_t v = val >> b; v > 1; v >>= 1 )
+  {
+    b++;
+  }
+  b = ( b < PROF_BUCKETS ? b : PROF_BUCKETS - 1 );
+  if( s.hist[b] == 0xFFFF )           /* halve all, keeps the shape         */
+  {
+    for( uint8_t i = 0; i < PROF_BUCKETS; i++ )
+    {
+      s.hist[i] >>= 1;
+    }
+  }
+  s.hist[b]++;
+}
+
+
+void profGet( PROF_t p, profStat_t & s )
+{
+  s = prof[p];
+}
+
+
+void profReset()
+{
+  for( uint8_t p = 0; p < QTY_PROF; p++ )
+  {
+    prof[p] = profStat_t { };
+  }
+  profEvPending = false;
+}
+
+
+/*------------------------------------------ profEventMark() ---------------
+ *
+ * a learned event is being handled. The oldest event waiting is timed.
+ *  True if this event is the one timed. If it makes no PWM change, call
+ *  profEventCancel(), or the next unrelated write is taken as its latency.
+*/
+
+bool profEventMark()
+{
+  if( profEvPending == false )
+  {
+    evStart = halMicros();
+    profEvPending = true;
+    return true;
+  }
+  return false;
+}
+
+
+void profEventCancel()                /* 1 byte, safe with the ISR           */
+{
+  profEvPending = false;
+}
+
+
+void profEventDone()                  /* interrupts off, or in the ISR       */
+{
+  if( profEvPending == true )
+  {
+    profEvPending = false;
+    profAdd( PROF_EVENT, halMicros() - evStart );
+  }
+}
+
+
+/*------------------------------------------ profDiag() --------------------
+ *
+ * value for a DGN diagnostic code. ISR in 0.1 us, others in us. Call with
+ *  interrupts off, as profGet().
+*/
+
+uint16_t profDiag( uint8_t code )
+{
+  if( code < PROFDGN_ISRMIN || code >= QTY_PROFDGN )
+  {
+    return 0;
+  }
+  const profStat_t & s = prof[( code - 1 ) / 3];
+  uint32_t val;
+
+  switch( ( code - 1 ) % 3 )
+  {
+    case 0 :  val = s.min; break;
+    case 1 :  val = ( s.n == 0 ? 0 : s.sum / s.n ); break;
+    default : val = s.max; break;
+  }
+  if( code <= PROFDGN_ISRMAX )
+  {
+    val = val * 10 / PROF_ISRDIV;
+  }
+  return ( val > 0xFFFF ? 0xFFFF : val );
+}
+
+
+/*-------------------------------PROF.cpp EoF ------------------------------*/
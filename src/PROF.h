@@ -0,0 +1,85 @@
+/*file: PROF.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Always on latency profiler. ISR run, loop() pass and event to PWM times
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * Each profile keeps min, max, mean and a log2 bucket histogram, so a rare
+ *  slow pass is seen without a scope on PINTP_D30 / D31.
+ *
+ *  PROF_ISR    processChannels() run, in Timer1 counts of 1/16 us.
+ *              Timer1 is at BOTTOM when its ISR is called, so TCNT1 at
+ *              halIsrEnd() is the ISR time, entry latency included.
+ *  PROF_LOOP   loop() pass, us. micros()
+ *  PROF_EVENT  eventHandler() to the next PWM write, us. Includes any Delay
+ *              NV secs, so it is the time a learned event takes to be seen.
+ *              Events that change no PWM, EG. NightSw as it is, are not timed.
+ *
+ * Serial Monitor 'P' prints and resets them. CBUS RDGN polls them, the reply
+ *  is a DGN per diagnostic code. See PROFDGN_t
+ *
+ * NB. PROF_ISR and PROF_EVENT are added in the ISR. Copy or reset them in
+ *  loop() with interrupts off.
+*/
+#ifndef PROF_H__  /* include guard */
+#define PROF_H__
+
+#include "HAL.h"
+
+
+enum PROF_t : uint8_t
+{
+  PROF_ISR   = 0,
+  PROF_LOOP  = 1,
+  PROF_EVENT = 2
+};
+const uint8_t QTY_PROF { 3 };
+
+const uint8_t PROF_BUCKETS { 16 };   /* hist[b] counts 2^b to 2^(b+1) - 1   */
+const uint8_t PROF_ISRDIV  { 16 };   /* PROF_ISR counts per us              */
+
+
+struct profStat_t
+{
+  uint32_t  min;
+  uint32_t  max;
+  uint32_t  sum;          /* sum & n are halved together, mean is kept       */
+  uint32_t  n;
+  uint16_t  hist[PROF_BUCKETS];  /* [0] is 0 & 1. All halved at 0xFFFF      */
+};
+
+
+enum PROFDGN_t : uint8_t  /* CBUS diagnostic codes, RDGN / DGN. Values 16 bit */
+{
+  PROFDGN_ALL      = 0,   /* RDGN only, reply with codes 1 - 9              */
+  PROFDGN_ISRMIN   = 1,   /* ISR, 0.1 us                                    */
+  PROFDGN_ISRMEAN  = 2,
+  PROFDGN_ISRMAX   = 3,
+  PROFDGN_LOOPMIN  = 4,   /* loop, us                                       */
+  PROFDGN_LOOPMEAN = 5,
+  PROFDGN_LOOPMAX  = 6,
+  PROFDGN_EVMIN    = 7,   /* event to PWM, us. 0xFFFF is 65 ms or more      */
+  PROFDGN_EVMEAN   = 8,
+  PROFDGN_EVMAX    = 9,
+  PROFDGN_RESET    = 0xFF /* RDGN only, reset all, reply with code 0xFF     */
+};
+const uint8_t QTY_PROFDGN { 10 };
+
+
+void     profAdd( PROF_t p, uint32_t val );   /* 1 measurement              */
+void     profGet( PROF_t p, profStat_t & s );  /* copy, see NB              */
+void     profReset();                         /* all profiles, see NB       */
+bool     profEventMark();                     /* eventHandler() start       */
+void     profEventCancel();                   /* event made no PWM change   */
+void     profEventDone();                     /* PWM write, from halWritePWM */
+uint16_t profDiag( uint8_t code );            /* DGN value, saturates       */
+
+extern volatile bool profEvPending;           /* event waits for PWM write  */
+
+
+#endif /* PROF_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,192 @@
+/*file: PWM.h       This is include file for CANlights.ino sketch
+ *------------------------------------------------------------------------------
+ *
+ * Direct PWM output. Maps PWMPIN[] to timer compare registers (OCRnx).
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK.    © Dave Harris 2021
+ *
+ * analogWrite() looks up the pin timer and comparator in flash tables and
+ *  branches on every call. Here the lookup is done by the compiler, so a
+ *  DC change is one store to the compare register.
+ *
+ * NB. analogWrite(), or digitalWrite(), on a PWM pin turns its PWM off.
+ *  Only use pwmWrite() on PWMPIN[] after pwmConnect(). Chans 1 - 10 only,
+ *  chans 11 up are BAM.h
+ *
+ * Resolution. pwmConnect() sets 16 bit timers 3, 4, 5 to phase correct PWM
+ *  with TOP = ICRn = PWM_TOP, clk/1. 12 bit at 1953 Hz.
+ *  8 bit timer 2 chans (pins 9, 10) get the top 8 bits, the low 4 bits are
+ *  dithered over 16 ticks by halDither(). See HAL.cpp
+*/
+#ifndef PWM_H__  /* include guard */
+#define PWM_H__
+
+#include "PIN.h"
+
+
+/* MEGA 2560 PWM pins and timer comparators. As the table in PIN.h
+ *  Register addresses are data space addresses, from the ATmega2560 datasheet
+*/
+
+struct pwmPin_t
+{
+  uint8_t   pin;          /* Arduino pin number                              */
+  uint8_t   timer;        /* timer 0 - 5                                     */
+  uint8_t   comp;         /* comparator 0=A 1=B 2=C                          */
+};
+
+constexpr pwmPin_t PWMTAB[]
+{
+  {  2, 3, 1 }, {  3, 3, 2 }, {  4, 0, 1 }, {  5, 3, 0 }, {  6, 4, 0 },
+  {  7, 4, 1 }, {  8, 4, 2 }, {  9, 2, 1 }, { 10, 2, 0 }, { 11, 1, 0 },
+  { 12, 1, 1 }, { 13, 0, 0 }, { 44, 5, 2 }, { 45, 5, 1 }, { 46, 5, 0 }
+};
+const uint8_t QTY_PWMTAB { sizeof( PWMTAB ) / sizeof( PWMTAB[0] ) };
+const uint8_t PWM_NONE { 0xFF };
+
+
+constexpr uint8_t pwmIdx( uint8_t pin, uint8_t i = 0 )   /* PWMTAB[] index  */
+{
+  return ( i >= QTY_PWMTAB ? PWM_NONE
+         : ( PWMTAB[i].pin == pin ? i : pwmIdx( pin, i + 1 ) ) );
+}
+
+constexpr uint8_t pwmTimer( uint8_t pin )
+{
+  return ( pwmIdx( pin ) == PWM_NONE ? PWM_NONE : PWMTAB[pwmIdx( pin )].timer );
+}
+
+constexpr uint8_t pwmComp( uint8_t pin )
+{
+  return ( pwmIdx( pin ) == PWM_NONE ? PWM_NONE : PWMTAB[pwmIdx( pin )].comp );
+}
+
+constexpr bool pwmWide( uint8_t pin )         /* 16 bit timer, 1 3 4 5      */
+{
+  return ( pwmTimer( pin ) != 0 && pwmTimer( pin ) != 2 );
+}
+
+constexpr uint16_t ocrAdr( uint8_t pin )      /* OCRnx register address     */
+{
+  return ( pwmTimer( pin ) == 0 ? 0x47 + pwmComp( pin )      /* OCR0A 0x47  */
+         : pwmTimer( pin ) == 1 ? 0x88 + 2 * pwmComp( pin )  /* OCR1A 0x88  */
+         : pwmTimer( pin ) == 2 ? 0xB3 + pwmComp( pin )      /* OCR2A 0xB3  */
+         : pwmTimer( pin ) == 3 ? 0x98 + 2 * pwmComp( pin )  /* OCR3A 0x98  */
+         : pwmTimer( pin ) == 4 ? 0xA8 + 2 * pwmComp( pin )  /* OCR4A 0xA8  */
+         :                       0x128 + 2 * pwmComp( pin ) ); /* OCR5A 0x128 */
+}
+
+constexpr uint16_t tccrAdr( uint8_t pin )     /* TCCRnA register address    */
+{
+  return ( pwmTimer( pin ) == 0 ? 0x44 : pwmTimer( pin ) == 1 ? 0x80
+         : pwmTimer( pin ) == 2 ? 0xB0 : pwmTimer( pin ) == 3 ? 0x90
+         : pwmTimer( pin ) == 4 ? 0xA0 : 0x120 );
+}
+
+constexpr uint8_t comMask( uint8_t pin )      /* COMnx1 bit in TCCRnA       */
+{
+  return ( 0x80 >> ( 2 * pwmComp( pin ) ) );
+}
+
+
+/* Checks of PWMPIN[] against the table, done by the compiler...
+ *  every chan pin has a comparator,
+ *  no chan on timer 0 (millis) or timer 1 (TimerOne 1 ms ISR),
+ *  no two chans share a comparator.
+*/
+
+constexpr bool pwmPinsOK( uint8_t ch = 0 )
+{
+  return ( ch >= QTY_PWMCHAN ? true
+         : pwmIdx( PWMPIN[ch] ) != PWM_NONE
+           && pwmTimer( PWMPIN[ch] ) != 0 && pwmTimer( PWMPIN[ch] ) != 1
+           && pwmPinsOK( ch + 1 ) );
+}
+
+constexpr bool pwmUnique( uint8_t a = 0, uint8_t b = 1 )
+{
+  return ( a >= QTY_PWMCHAN ? true
+         : b >= QTY_PWMCHAN ? pwmUnique( a + 1, a + 2 )
+         : ocrAdr( PWMPIN[a] ) != ocrAdr( PWMPIN[b] ) && pwmUnique( a, b + 1 ) );
+}
+
+static_assert( pwmPinsOK(), "PWMPIN[] pin is not a free timer PWM pin" );
+static_assert( pwmUnique(), "PWMPIN[] pins share a timer comparator" );
+
+
+static_assert( PWM_BITS > 8 && PWM_BITS <= 16, "PWM_BITS is 9 - 16" );
+
+const uint8_t DITHER_BITS { PWM_BITS - 8 };   /* bits faked on 8 bit timers */
+
+
+struct ocr_t             /* compare register for a chan                      */
+{
+  uint16_t  adr;          /* OCRnx address                                   */
+  bool      wide;         /* 16 bit register                                 */
+  uint16_t  tccr;         /* TCCRnA address                                  */
+  uint8_t   com;          /* COMnx1 bit mask                                 */
+};
+
+static_assert( QTY_PWMCHAN == 10, "OCR[] needs an entry per timer chan" );
+
+constexpr ocr_t OCR[QTY_PWMCHAN]
+{
+  { ocrAdr( PWMPIN[0] ), pwmWide( PWMPIN[0] ),
+    tccrAdr( PWMPIN[0] ), comMask( PWMPIN[0] ) },
+  { ocrAdr( PWMPIN[1] ), pwmWide( PWMPIN[1] ),
+    tccrAdr( PWMPIN[1] ), comMask( PWMPIN[1] ) },
+  { ocrAdr( PWMPIN[2] ), pwmWide( PWMPIN[2] ),
+    tccrAdr( PWMPIN[2] ), comMask( PWMPIN[2] ) },
+  { ocrAdr( PWMPIN[3] ), pwmWide( PWMPIN[3] ),
+    tccrAdr( PWMPIN[3] ), comMask( PWMPIN[3] ) },
+  { ocrAdr( PWMPIN[4] ), pwmWide( PWMPIN[4] ),
+    tccrAdr( PWMPIN[4] ), comMask( PWMPIN[4] ) },
+  { ocrAdr( PWMPIN[5] ), pwmWide( PWMPIN[5] ),
+    tccrAdr( PWMPIN[5] ), comMask( PWMPIN[5] ) },
+  { ocrAdr( PWMPIN[6] ), pwmWide( PWMPIN[6] ),
+    tccrAdr( PWMPIN[6] ), comMask( PWMPIN[6] ) },
+  { ocrAdr( PWMPIN[7] ), pwmWide( PWMPIN[7] ),
+    tccrAdr( PWMPIN[7] ), comMask( PWMPIN[7] ) },
+  { ocrAdr( PWMPIN[8] ), pwmWide( PWMPIN[8] ),
+    tccrAdr( PWMPIN[8] ), comMask( PWMPIN[8] ) },
+  { ocrAdr( PWMPIN[9] ), pwmWide( PWMPIN[9] ),
+    tccrAdr( PWMPIN[9] ), comMask( PWMPIN[9] ) }
+};
+
+
+#ifdef ARDUINO
+
+inline void pwmWrite( uint8_t ch, uint16_t pwm ) /* compare value, OCR scale */
+{
+  if( OCR[ch].wide == true )           /* 16 bit write, high byte first      */
+  {
+    *(volatile uint16_t *) OCR[ch].adr = pwm;
+  }
+  else
+  {
+    *(volatile uint8_t *) OCR[ch].adr = pwm;
+  }
+}
+
+inline void pwmConnect( uint8_t ch )     /* connect chan pin to comparator   */
+{
+  volatile uint8_t * tccr = (volatile uint8_t *) OCR[ch].tccr;
+
+  if( OCR[ch].wide == true )             /* mode 10, phase correct, TOP=ICRn */
+  {
+    tccr[0] = ( tccr[0] & 0xFC ) | 0x02;   /* TCCRnA WGMn1:0 = 10            */
+    tccr[1] = 0x10 | 0x01;                 /* TCCRnB WGMn3:2 = 10, clk/1     */
+    *(volatile uint16_t *)( OCR[ch].tccr + 6 ) = PWM_TOP;       /* ICRn     */
+  }
+  pwmWrite( ch, 0 );
+  tccr[0] |= OCR[ch].com;
+}
+
+#endif /* ARDUINO */
+
+
+#endif /* PWM_H__
+ ------------------------ PWM.h EoF---------------------------------
+*/
@@ -0,0 +1,88 @@
+/*file: SCENE.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Scene table in EEPROM. See SCENE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "SCENE.h"
+
+
+static uint16_t sceneStart { 0 };     /* EEPROM address of scene 0           */
+
+
+void sceneBegin( uint16_t eeStart )
+{
+  sceneStart = eeStart;
+}
+
+
+/*------------------------------------------ sceneLoad() --------------------
+ *
+ * read scene n, 0 - 7, from EEPROM. False if n is empty or out of range
+*/
+
+bool sceneLoad( uint8_t n, sceneChan_t * sc )
+{
+  uint16_t adr = sceneStart + n * SCENE_BYTES;
+
+  if( n >= QTY_SCENE || halReadEE( adr ) != SCENE_VALID )
+  {
+    return false;
+  }
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    adr += 3;
+    sc[ch].dc       = halReadEE( adr - 2 );
+    sc[ch].secTrans = halReadEE( adr - 1 );
+    sc[ch].secDelay = halReadEE( adr );
+  }
+  return true;
+}
+
+
+/*------------------------------------------ sceneSave() --------------------
+ *
+ * write scene n, 0 - 7, to EEPROM. Valid byte last, so a part write is empty
+*/
+
+void sceneSave( uint8_t n, const sceneChan_t * sc )
+{
+  uint16_t adr = sceneStart + n * SCENE_BYTES;
+
+  if( n >= QTY_SCENE )
+  {
+    return;
+  }
+  halWriteEE( adr, 0xFF );
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    halWriteEE( adr + 1 + 3 * ch, sc[ch].dc );
+    halWriteEE( adr + 2 + 3 * ch, sc[ch].secTrans );
+    halWriteEE( adr + 3 + 3 * ch, sc[ch].secDelay );
+  }
+  halWriteEE( adr, SCENE_VALID );
+}
+
+
+/*------------------------------------------ sceneRecall() ------------------
+ *
+ * show scene n, 0 - 7. All chans start in one tick. See startScene()
+*/
+
+bool sceneRecall( uint8_t n )
+{
+  sceneChan_t sc[QTY_CHAN];
+
+  if( sceneLoad( n, sc ) == false )
+  {
+    return false;
+  }
+  startScene( sc );
+  return true;
+}
+
+
+/*-------------------------------SCENE.cpp EoF ------------------------------*/
@@ -0,0 +1,37 @@
+/*file: SCENE.h     This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Scene table. Presets of DC, transition & delay for all chans, in EEPROM
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * One learned event (EVAL_SCENE1 - 8), or a short event with a data byte,
+ *  recalls a whole scene. 1 CAN frame, not 1 TestCh frame per chan, and
+ *  all chans start in the same 1 ms tick. See startScene() in CHAN.cpp
+ *
+ * EEPROM map, after the event table...
+ *  scene n at start + n * SCENE_BYTES. SCENE_VALID, then per chan dc,
+ *  secTrans, secDelay. Erased EEPROM (0xFF) is an empty scene.
+ * Serial Monitor 'S' + 1-8 saves the current chan DCs as a scene.
+*/
+#ifndef SCENE_H__  /* include guard */
+#define SCENE_H__
+
+#include "CHAN.h"                     /* sceneChan_t, QTY_SCENE              */
+
+
+const uint8_t SCENE_VALID { 0x5C };   /* first byte of a stored scene        */
+const uint8_t SCENE_BYTES { 1 + 3 * QTY_CHAN };  /* EEPROM bytes per scene   */
+
+
+void sceneBegin( uint16_t eeStart );  /* EEPROM address of scene 0. setupEEPROM */
+bool sceneLoad( uint8_t n, sceneChan_t * sc );        /* false if empty       */
+void sceneSave( uint8_t n, const sceneChan_t * sc );
+bool sceneRecall( uint8_t n );        /* load & startScene(), false if empty  */
+
+
+#endif /* SCENE_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,142 @@
+/*file: SENSE.cpp
+ *----------------------------------------------------------------------------
+ *
+ * ADC sampler for the Power sense inputs. See SENSE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#ifdef ARDUINO            /* MEGA only, no host build                        */
+
+#include "SENSE.h"
+#include "PIN.h"
+
+
+const uint8_t SENSEMUX[QTY_SENSE]    /* ADC channel 0 - 15 for each input    */
+{
+  PINSENSE - A0,
+  PINBLUE - A0
+};
+
+static volatile uint16_t ring[QTY_SENSE][SENSE_RING]; /* latest samples      */
+static volatile uint8_t  head[QTY_SENSE];   /* next ring slot                */
+static volatile uint16_t lo[QTY_SENSE];     /* min since senseStats()        */
+static volatile uint16_t hi[QTY_SENSE];     /* peak since senseStats()       */
+static volatile uint16_t iir[QTY_SENSE];    /* filtered * 2^SENSE_IIRSHIFT   */
+static volatile bool     seeded[QTY_SENSE]; /* iir has its first sample      */
+
+static uint8_t inFlight[2];  /* input of running conversion, and next one     */
+
+
+static void senseMux( uint8_t in )   /* select input for a conversion start  */
+{
+  uint8_t mux = SENSEMUX[in];
+
+  ADMUX = _BV( REFS1 ) | ( mux & 0x07 );               /* INTERNAL1V1 ref    */
+  ADCSRB = ( mux & 0x08 ? _BV( MUX5 ) : 0 );           /* free run, ADTS = 0 */
+}
+
+
+/*------------------------------------------ senseBegin() --------------------
+ *
+ * start ADC free running, alternating the inputs. Called by setup()
+*/
+
+void senseBegin()
+{
+  for( uint8_t in = 0; in < QTY_SENSE; in++ )
+  {
+    lo[in] = 0x3FF;
+    hi[in] = 0;
+    seeded[in] = false;
+  }
+  inFlight[0] = SENSE_AMP;
+  inFlight[1] = SENSE_VOLT;
+
+  senseMux( SENSE_AMP );
+  ADCSRA = _BV( ADEN ) | _BV( ADSC ) | _BV( ADATE ) | _BV( ADIE )
+         | _BV( ADPS2 ) | _BV( ADPS1 ) | _BV( ADPS0 );      /* clk/128       */
+  senseMux( SENSE_VOLT );           /* latched by the 2nd conversion        */
+}
+
+
+/*------------------------------------------ ADC_vect ISR --------------------
+ *
+ * A conversion is done. In free run the next has already started, so the
+ *  mux set here is for the one after. Swapping inFlight[] keeps track.
+*/
+
+ISR( ADC_vect )
+{
+  uint16_t s = ADC;
+  uint8_t in = inFlight[0];           /* this sample is from input 'in'     */
+
+  inFlight[0] = inFlight[1];
+  inFlight[1] = in;
+  senseMux( in );                     /* conversion after next, same input  */
+
+  ring[in][head[in]] = s;
+  head[in] = ( head[in] + 1 ) & ( SENSE_RING - 1 );
+
+  if( s < lo[in] )
+  {
+    lo[in] = s;
+  }
+  if( s > hi[in] )
+  {
+    hi[in] = s;
+  }
+  if( seeded[in] == false )           /* start filter at first sample       */
+  {
+    seeded[in] = true;
+    iir[in] = s << SENSE_IIRSHIFT;
+  }
+  iir[in] += s - ( iir[in] >> SENSE_IIRSHIFT );
+}
+
+
+/*------------------------------------------ senseFilt() ---------------------
+ *
+ * IIR filtered value of an input, in ADC units
+*/
+
+uint16_t senseFilt( SENSE_t in )
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t f = iir[in];
+  SREG = sreg;
+
+  return ( f >> SENSE_IIRSHIFT );
+}
+
+
+/*------------------------------------------ senseStats() --------------------
+ *
+ * copy input stats, then restart the min and peak window
+*/
+
+void senseStats( SENSE_t in, senseStat_t & st )
+{
+  uint16_t sum { 0 };
+
+  uint8_t sreg = SREG;
+  cli();
+  for( uint8_t i = 0; i < SENSE_RING; i++ )
+  {
+    sum += ring[in][i];
+  }
+  st.filt = iir[in] >> SENSE_IIRSHIFT;
+  st.min  = lo[in];
+  st.peak = hi[in];
+  lo[in] = 0x3FF;
+  hi[in] = 0;
+  SREG = sreg;
+
+  st.avg = sum / SENSE_RING;
+}
+
+#endif /* ARDUINO */
+
+/*-------------------------------SENSE.cpp EoF ------------------------------*/
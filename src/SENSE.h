@@ -0,0 +1,54 @@
+/*file: SENSE.h     This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * ADC sampler for the Power sense inputs, PINSENSE (Amps) & PINBLUE (12 V)
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * The ADC free runs, clk/128, 9.6 k samples/s, alternating the 2 inputs.
+ *  Its ISR stores each sample in a ring, tracks min and peak and runs an
+ *  IIR filter. So loop() never waits on the ADC, and a single noisy sample
+ *  can not trip a fault.
+ *
+ * NB. analogRead() stops the free run. Do not use it after senseBegin().
+*/
+#ifndef SENSE_H__  /* include guard */
+#define SENSE_H__
+
+#include <Arduino.h>
+
+
+enum SENSE_t : uint8_t  /* sampled inputs */
+{
+  SENSE_AMP  = 0,             /* PINSENSE, volts on 0R05 sense resistor  */
+  SENSE_VOLT = 1              /* PINBLUE,  Vf on the 12 V blue LED       */
+};
+const uint8_t QTY_SENSE { 2 };
+
+
+const uint8_t SENSE_IIRSHIFT { 3 };  /* IIR, filt += ( s - filt ) / 2^n  0-6 */
+const uint8_t SENSE_RING { 8 };      /* samples kept per input, power of 2  */
+
+static_assert( SENSE_IIRSHIFT <= 6, "IIR sum must fit 16 bit" );
+static_assert( ( SENSE_RING & ( SENSE_RING - 1 ) ) == 0, "ring is power 2" );
+
+
+struct senseStat_t  /* ADC units, 0 - 1023 */
+{
+  uint16_t  filt;         /* IIR filtered value                              */
+  uint16_t  min;          /* lowest sample since last senseStats()           */
+  uint16_t  avg;          /* mean of the last SENSE_RING samples             */
+  uint16_t  peak;         /* highest sample since last senseStats()          */
+};
+
+
+void     senseBegin();                    /* start free run. After setupPins */
+uint16_t senseFilt( SENSE_t in );         /* IIR filtered value, ADC units   */
+void     senseStats( SENSE_t in, senseStat_t & st ); /* copy, restart min/peak */
+
+
+#endif /* SENSE_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,158 @@
+/*file: SEQ.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Keyframe program image in EEPROM. See SEQ.h, the interpreter is in CHAN.cpp
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include <string.h>
+
+#include "SEQ.h"
+#include "CRC.h"
+
+
+static uint16_t seqEE { 0 };          /* EEPROM address of the image         */
+
+
+/*------------------------------------------ seqBegin() --------------------
+ *
+ * the image to the chans, called from setupEEPROM() before setupChannels()
+*/
+
+void seqBegin( uint16_t eeStart )
+{
+  seqEE = eeStart;
+  seqLoad();
+}
+
+
+/*------------------------------------------ seqPut() ----------------------
+ *
+ * 2 image bytes to EEPROM at adr, an even offset. Only bytes that differ
+ *  are written. The chans run the old image till seqLoad(). False if adr
+ *  is out of range.
+*/
+
+bool seqPut( uint8_t adr, uint8_t b0, uint8_t b1 )
+{
+  if( adr > SEQ_BYTES - 2 )
+  {
+    return false;
+  }
+  if( halReadEE( seqEE + adr ) != b0 )
+  {
+    halWriteEE( seqEE + adr, b0 );
+  }
+  if( halReadEE( seqEE + adr + 1 ) != b1 )
+  {
+    halWriteEE( seqEE + adr + 1, b1 );
+  }
+  return true;
+}
+
+
+/*------------------------------------------ seqValid() --------------------
+ *
+ * the crc only says the image came whole, not that host/SEQc.cpp made it.
+ *  Walks the code op by op from QTY_SEQ. Each start pc and loop body must
+ *  be an op, ops past SEQ_LAST are END. A ramp or hold must have at most
+ *  SEQ_SLICEBITS, rem under its slices and a slice of SEQ_MSMAX or less,
+ *  the due queue compares 16 bit signed.
+*/
+
+static const uint8_t SEQ_LAST { SEQ_BYTES - 1 - SEQ_OPMAX }; /* last op pc */
+
+static void seqMark( uint8_t * bits, uint8_t pc )   /* bit per pc          */
+{
+  if( pc <= SEQ_LAST )
+  {
+    bits[pc >> 3] |= 1 << ( pc & 7 );
+  }
+}
+
+
+static bool seqValid( const uint8_t * img )
+{
+  uint8_t opAt[SEQ_BYTES / 8] {};     /* an op starts at pc                  */
+  uint8_t jumpTo[SEQ_BYTES / 8] {};   /* a program or loop body starts       */
+
+  for( uint8_t i = 0; i < QTY_SEQ; i++ )
+  {
+    seqMark( jumpTo, img[i] );
+  }
+  for( uint8_t pc = QTY_SEQ; pc <= SEQ_LAST; )
+  {
+    const uint8_t * op = &img[pc];
+    const uint8_t * t { NULL };       /* ms lo, ms hi, rem                   */
+    uint8_t len { 1 };
+
+    seqMark( opAt, pc );
+    switch( op[0] & 0xF0 )
+    {
+      case SEQ_RAMP :
+        t = &op[2];
+        len = SEQ_OPMAX;
+        break;
+      case SEQ_HOLD :
+        t = &op[1];
+        len = SEQ_OPMAX - 1;
+        break;
+      case SEQ_SET :
+        len = 2;
+        break;
+      case SEQ_LOOP :
+        seqMark( jumpTo, op[2] );
+        len = 3;
+        break;
+    }
+    if( t != NULL )
+    {
+      uint8_t bits = op[0] & 0x07;
+
+      if( bits > SEQ_SLICEBITS || t[2] >= ( 1U << bits )
+          || ( t[0] | ( t[1] << 8 ) ) > SEQ_MSMAX )
+      {
+        return false;
+      }
+    }
+    pc += len;
+  }
+  for( uint8_t i = 0; i < SEQ_BYTES / 8; i++ )
+  {
+    if( ( jumpTo[i] & ~opAt[i] ) != 0 )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/*------------------------------------------ seqLoad() ---------------------
+ *
+ * EEPROM image to the buffer the ISR is not using. A bad crc, EEPROM never
+ *  written, or code seqValid() refuses, loads as no programs. Call
+ *  setupChannels() after, to swap it in. False if it did not load.
+*/
+
+bool seqLoad()
+{
+  uint8_t * img = seqNext();
+
+  for( uint8_t i = 0; i < SEQ_BYTES; i++ )
+  {
+    img[i] = halReadEE( seqEE + i );
+  }
+  if( crc8( img, SEQ_BYTES - 1 ) == img[SEQ_BYTES - 1] && seqValid( img ) )
+  {
+    return true;
+  }
+  memset( img, SEQ_END, SEQ_BYTES );
+  memset( img, SEQ_NONE, QTY_SEQ );
+  return false;
+}
+
+
+/*-------------------------------SEQ.cpp EoF ------------------------------*/
@@ -0,0 +1,77 @@
+/*file: SEQ.h       This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Keyframe sequence programs. Bytecode, stored in EEPROM, loaded over CBUS
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * A chan in MODE_SEQ runs program Delay0 NV, 0 - 7, in place of the DC0/DC1
+ *  phases. EG. a street lamp that strikes, dims, then warms up to full, or
+ *  rooms of a building lit one by one. Gamma & the ease bits still apply.
+ *  host/SEQc.cpp compiles the source, checks each program's timing on the
+ *  engine and gives the image and the CBUS frames to load it.
+ *
+ * Source, a keyframe a line, '#' comment...
+ *  seq N            program N starts, 0 - 7
+ *  ramp DC T        to DC over T, linear or the chan ease. T is ms, or s
+ *                   with a '.', EG. 2.5s, to 2097 s. ramp DC 0 is a jump
+ *  hold T           stay, T as ramp
+ *  wait night|day   until NightSw is so, goes on if it is
+ *  loop N ... next  body N times, 0 is for ever. Not nested
+ *  end              stop at this dc. A program ends so anyway
+ *
+ * Bytecode. Op is the high nibble, the low nibble is its arg
+ *  SEQ_END                           stop, chan STEADY
+ *  SEQ_RAMP | n, dc, ms lo, ms hi, rem   2^n slices of ms, rem spread over
+ *                                    them Bresenham style, as a transit
+ *  SEQ_HOLD | n, ms lo, ms hi, rem   as a ramp to the dc it has
+ *  SEQ_SET, dc                       jump to dc
+ *  SEQ_WAIT | NightSw                chan STEADY till newPhase() if not so
+ *  SEQ_LOOP, count, pc of body       count 0 is for ever
+ *
+ * The interpreter runs in processChan() as STATE_EFFECT, see seqStep() in
+ *  CHAN.cpp. Each call does 1 slice of a ramp or hold, or ends one and
+ *  starts the next op. So a call costs no more than a transit slice, and a
+ *  bad program can not hang the ISR. SET, WAIT & LOOP take 1 ms each.
+ *
+ * Image, SEQ_BYTES, in EEPROM after the sync byte and in RAM, CHAN.cpp...
+ *  [0 - 7]   program start pc, SEQ_NONE if none
+ *  [8 - 126] code, an op starts by 122
+ *  [127]     crc8 of [0 - 126]. A bad image loads as no programs, as does
+ *            code SEQc would not make. EG. a slice over SEQ_MSMAX.
+ *
+ * Loading over CBUS. Teach an event EV1 = EVAL_SEQ. ACON3/ASON3 of it puts
+ *  2 image bytes, data[5] offset, data[6] & [7]. Its Off event checks the
+ *  crc and loads the image, the chans restart. See host/SEQc.cpp -u
+*/
+#ifndef SEQ_H__  /* include guard */
+#define SEQ_H__
+
+#include "CHAN.h"
+
+
+const uint8_t SEQ_BYTES { 128 };      /* image in EEPROM & RAM               */
+const uint8_t QTY_SEQ   { 8 };        /* programs, start table at [0]        */
+const uint8_t SEQ_NONE  { 0xFF };     /* start table, no program             */
+const uint8_t SEQ_OPMAX { 5 };        /* longest op, SEQ_RAMP                */
+const uint8_t SEQ_SLICEBITS { 6 };    /* 2^6 ramp slices, max                */
+const uint16_t SEQ_MSMAX { 32767 };   /* a slice, the due queue              */
+
+const uint8_t SEQ_END   { 0x00 };
+const uint8_t SEQ_RAMP  { 0x10 };
+const uint8_t SEQ_SET   { 0x20 };
+const uint8_t SEQ_HOLD  { 0x30 };
+const uint8_t SEQ_WAIT  { 0x40 };
+const uint8_t SEQ_LOOP  { 0x50 };
+
+
+void seqBegin( uint16_t eeStart );    /* load image, from setupEEPROM()      */
+bool seqPut( uint8_t adr, uint8_t b0, uint8_t b1 ); /* 2 bytes to EEPROM    */
+bool seqLoad();                       /* EEPROM image to chans, crc checked  */
+
+
+#endif /* SEQ_H__
+ --------------------------------------- EoF ------------------------------
+*/
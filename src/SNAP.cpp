@@ -0,0 +1,189 @@
+/*file: SNAP.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Warm restart snapshot. See SNAP.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "SNAP.h"
+#include "LOG.h"              /* deferred log ring                            */
+#include "CRC.h"              /* crc8()                                       */
+
+
+static uint16_t snapStart { 0 };      /* EEPROM address of slot 0            */
+static uint8_t  newest { SNAP_SLOTS }; /* slot, SNAP_SLOTS = none good       */
+static uint8_t  seq { 0 };            /* seq of newest                       */
+
+static uint16_t savedKey { 0 };       /* snapKey() at last save              */
+static uint16_t lastKey { 0 };        /* snapKey() at last check             */
+static uint32_t msCheck { 0 };
+static uint32_t msChange { 0 };       /* halMillis() when lastKey changed    */
+
+
+static uint16_t slotAdr( uint8_t slot )
+{
+  return snapStart + slot * SNAP_BYTES;
+}
+
+
+static bool readSlot( uint8_t slot, uint8_t * buf )  /* false if not good    */
+{
+  for( uint8_t i = 0; i < SNAP_BYTES; i++ )
+  {
+    buf[i] = halReadEE( slotAdr( slot ) + i );
+  }
+  return ( buf[1] <= NIGHTSW_NIGHT                  /* erased is 0xFF        */
+           && crc8( buf, SNAP_BYTES - 1 ) == buf[SNAP_BYTES - 1] );
+}
+
+
+/*------------------------------------------ snapKey() ---------------------
+ *
+ * what a save would change. NightSw, and dc & phase of the steady chans. A
+ *  moving chan counts as moving, so a 010 chan does not wear the EEPROM.
+*/
+
+static uint16_t snapKey()
+{
+  uint8_t a = nightSw, b = nightSw;    /* Fletcher 16                         */
+
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    bool steady = ( var[ch].state == STATE_STEADY );
+
+    a += ( steady ? var[ch].dcCur : 0xFF );
+    b += a;
+    a += ( steady ? var[ch].phase : 0xFF );
+    b += a;
+  }
+  return ( b << 8 ) | a;
+}
+
+
+/*------------------------------------------ snapBegin() -------------------
+ *
+ * find the newest good slot. Seq is 8 bit, so newest is by difference.
+ *  Called from setupEEPROM()
+*/
+
+void snapBegin( uint16_t eeStart )
+{
+  uint8_t buf[SNAP_BYTES];
+
+  snapStart = eeStart;
+  newest = SNAP_SLOTS;
+  for( uint8_t slot = 0; slot < SNAP_SLOTS; slot++ )
+  {
+    if( readSlot( slot, buf ) == true
+        && ( newest == SNAP_SLOTS || (int8_t)( buf[0] - seq ) > 0 ) )
+    {
+      newest = slot;
+      seq = buf[0];
+    }
+  }
+}
+
+
+uint8_t snapSeq()
+{
+  return seq;
+}
+
+
+/*------------------------------------------ snapRestore() -----------------
+ *
+ * newest snapshot to var[] and nightSw. Chans are STEADY at the saved dc &
+ *  phase, setupChannels() then starts the phase. Call after initChannels(),
+ *  before the ISR runs. setAllPWM( PWM_RESTORE ) writes the PWM.
+*/
+
+bool snapRestore()
+{
+  uint8_t buf[SNAP_BYTES];
+
+  if( newest == SNAP_SLOTS || readSlot( newest, buf ) == false )
+  {
+    return false;
+  }
+  nightSw = (NIGHTSW_t) buf[1];
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    uint8_t ps = buf[2 + QTY_CHAN + ch / 2] >> ( ch % 2 ? 4 : 0 );
+
+    var[ch].dcCur = buf[2 + ch];
+    var[ch].phase = ps & 1;           /* saved state is for the record only  */
+    var[ch].state = STATE_STEADY;
+  }
+  savedKey = snapKey();               /* settled back here, no save          */
+  lastKey = savedKey;
+  return true;
+}
+
+
+/*------------------------------------------ snapSave() --------------------
+ *
+ * write the next slot. CRC last, a part write leaves the slot before as
+ *  newest. Blocks for SNAP_BYTES EEPROM writes.
+*/
+
+void snapSave()
+{
+  uint8_t buf[SNAP_BYTES] { };
+  uint8_t slot = ( newest >= SNAP_SLOTS - 1 ? 0 : newest + 1 );
+
+  buf[0] = ( newest == SNAP_SLOTS ? 0 : seq + 1 );
+  buf[1] = nightSw;
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    uint8_t ps = ( var[ch].state << 1 ) | var[ch].phase;
+
+    buf[2 + ch] = var[ch].dcCur;
+    buf[2 + QTY_CHAN + ch / 2] |= ps << ( ch % 2 ? 4 : 0 );
+  }
+  buf[SNAP_BYTES - 1] = crc8( buf, SNAP_BYTES - 1 );
+
+  halWriteEE( slotAdr( slot ) + SNAP_BYTES - 1, ~buf[SNAP_BYTES - 1] );
+  for( uint8_t i = 0; i < SNAP_BYTES; i++ )
+  {
+    halWriteEE( slotAdr( slot ) + i, buf[i] );
+  }
+  newest = slot;
+  seq = buf[0];
+  savedKey = snapKey();
+  logPut( LOG_SNAP, seq, slot );
+}
+
+
+/*------------------------------------------ snapCheck() -------------------
+ *
+ * each SNAP_CHECKMS, save once snapKey() has held a new value for
+ *  SNAP_SETTLEMS. Called from loop(), not in a Power fault.
+*/
+
+void snapCheck()
+{
+  uint32_t ms = halMillis();
+
+  if( ms - msCheck < SNAP_CHECKMS )
+  {
+    return;
+  }
+  msCheck = ms;
+
+  uint16_t key = snapKey();
+
+  if( key != lastKey )
+  {
+    lastKey = key;
+    msChange = ms;
+  }
+  else if( key != savedKey && ms - msChange >= SNAP_SETTLEMS )
+  {
+    snapSave();
+  }
+}
+
+
+/*-------------------------------SNAP.cpp EoF ------------------------------*/
@@ -0,0 +1,50 @@
+/*file: SNAP.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Warm restart. Chan dc, phase & state and NightSw, in wear levelled EEPROM
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * A snapshot is saved when Power first sees the 12 V rail drop, and when the
+ *  steady chans and NightSw have settled for SNAP_SETTLEMS after a change.
+ *  So a rail that drops too fast to save still has the last settled scene.
+ * At power on, setup() puts every chan straight to its saved dc, before CAN
+ *  starts. The chan then runs its mode from there with the saved phase and
+ *  NightSw, a steady chan stays where it was. A chan that was moving starts
+ *  its phase again from the saved dc, as transit progress is not kept.
+ *
+ * EEPROM map, after the calibration curves...
+ *  SNAP_SLOTS slots of SNAP_BYTES, written in turn. Each is seq, NightSw,
+ *  dc per chan, state << 1 | phase per chan in nibbles, then a CRC-8 of
+ *  them all. The newest good slot is used, a part write fails its CRC.
+ *  A save is SNAP_BYTES writes, about 60 ms on the MEGA.
+*/
+#ifndef SNAP_H__  /* include guard */
+#define SNAP_H__
+
+#include "CHAN.h"
+
+
+const uint8_t  SNAP_SLOTS    { 8 };      /* slots, each takes 1/8 of the wear */
+const uint8_t  SNAP_BYTES    { 2 + QTY_CHAN + QTY_CHAN / 2 + 1 };
+const uint16_t SNAP_SETTLEMS { 10000 };  /* ms unchanged before a save        */
+const uint16_t SNAP_CHECKMS  { 1000 };   /* ms between settle checks          */
+const uint16_t SNAP_BOOTMS   { 2000 };   /* no rail drop save before, 12 V    */
+                                         /*  may come up after the MEGA       */
+
+static_assert( QTY_CHAN % 2 == 0, "SNAP packs 2 chans per state byte" );
+
+
+void    snapBegin( uint16_t eeStart );  /* EEPROM adr, find newest slot       */
+bool    snapRestore();                  /* newest to var[] & nightSw, false   */
+                                        /*  if none. Before setupChannels()   */
+void    snapSave();                     /* write next slot now, ~60 ms        */
+void    snapCheck();                    /* settle save, from loop()           */
+uint8_t snapSeq();                      /* seq of newest slot                 */
+
+
+#endif /* SNAP_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,294 @@
+/*file: SYNC.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Multi-node sync. See SYNC.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "SYNC.h"
+#include "LOG.h"              /* deferred log ring                            */
+
+
+static uint16_t syncEE { 0 };         /* EEPROM address of master byte       */
+static SYNCST_t st { SYNCST_NONE };
+static uint16_t offset { 0 };         /* net tick - engine ticks             */
+static uint16_t rxTicks;              /* engine ticks at last sync frame     */
+static uint32_t msRx;                 /* halMillis() at last sync frame      */
+static int32_t  trim { 0 };           /* slip rate, integral of error        */
+static int16_t  err { 0 };            /* last error to master, ticks         */
+static bool     waiting { false };    /* NightSw changed, for a start frame  */
+static uint32_t msWait;               /* halMillis() waiting started         */
+static bool     early { false };      /* start frame came before NightSw     */
+static uint16_t earlyTick;            /* its start tick, net                 */
+static uint32_t msEarly;              /* halMillis() it came                 */
+static uint32_t msTx;                 /* halMillis() of last sync frame      */
+static bool     txSync { false };     /* sync frame to send                  */
+static bool     txStart { false };    /* start frame to send                 */
+static uint16_t txTick;               /* start tick to send                  */
+
+static int32_t  rateNext;             /* slip rate for the ISR               */
+static volatile bool rateReq { false }; /* rateNext waiting for the ISR      */
+static int32_t  rate { 0 };           /* ISR copy, SYNC_ONE = 1 tick a tick  */
+static int32_t  slip { 0 };           /* ISR, slip due at +/- SYNC_ONE       */
+
+
+/*------------------------------------------ setRate() ---------------------
+ *
+ * publish a slip rate to the ISR. rateReq is cleared first, so the ISR can
+ *  not take a half written rateNext.
+*/
+
+static void setRate( int32_t r )
+{
+  r = ( r > SYNC_MAXRATE ? SYNC_MAXRATE : r < -SYNC_MAXRATE ? -SYNC_MAXRATE : r );
+  rateReq = false;
+  rateNext = r;
+  rateReq = true;
+}
+
+
+/*------------------------------------------ syncBegin() -------------------
+ *
+ * master or not, from EEPROM. Called from setupEEPROM()
+*/
+
+void syncBegin( uint16_t eeStart )
+{
+  syncEE = eeStart;
+  st = ( halReadEE( syncEE ) == SYNC_MASTER ? SYNCST_MASTER : SYNCST_NONE );
+}
+
+
+void syncSetMaster( bool on )
+{
+  halWriteEE( syncEE, ( on ? SYNC_MASTER : 0xFF ) );
+  st = ( on ? SYNCST_MASTER : SYNCST_NONE );
+  offset = 0;
+  trim = 0;
+  setRate( 0 );
+  msTx = halMillis() - SYNC_PERIODMS;   /* a master sends at once            */
+}
+
+
+/*------------------------------------------ syncTicks() -------------------
+ *
+ * from the 1 ms ISR, engine ticks to run this ms. 1, or 2 or 0 to slip.
+*/
+
+uint8_t syncTicks()
+{
+  if( rateReq == true )
+  {
+    rate = rateNext;
+    rateReq = false;
+  }
+  slip += rate;
+  if( slip >= SYNC_ONE )
+  {
+    slip -= SYNC_ONE;
+    return 2;
+  }
+  if( slip <= -SYNC_ONE )
+  {
+    slip += SYNC_ONE;
+    return 0;
+  }
+  return 1;
+}
+
+
+/*------------------------------------------ startAt() ---------------------
+ *
+ * start the phase at a net tick from the master. Too late, or too far ahead
+ *  to be real, starts it now and is logged.
+*/
+
+static void startAt( uint16_t tick )
+{
+  uint16_t now = engineTicks();
+  int16_t  lead = tick - (uint16_t)( now + offset );
+
+  if( lead >= 0 && lead <= (int16_t) SYNC_WAITMS )
+  {
+    startNewPhaseAt( now + lead );
+  }
+  else
+  {
+    uint16_t late = ( lead < 0 ? -lead : lead );
+    logPut( LOG_SYNCLATE, late > 0xFF ? 0xFF : late );
+    startNewPhase();
+  }
+}
+
+
+/*------------------------------------------ syncRx() ----------------------
+ *
+ * EVAL_SYNC frame from the master. ACON2 is its ticks, ACOF2 a start tick.
+ *  The error is the master tick less ours, + is behind. The first frame,
+ *  or a big error, steps the offset. Else a PI loop sets the slip rate,
+ *  in SYNC_ONE units a tick. See SYNC.h
+*/
+
+void syncRx( bool start, uint16_t tick )
+{
+  if( st == SYNCST_MASTER )
+  {
+    return;                           /* 2 masters, this one keeps its own   */
+  }
+  if( start == true )
+  {
+    if( st == SYNCST_LOCKED && waiting == true )
+    {
+      waiting = false;
+      startAt( tick );
+    }
+    else if( st == SYNCST_LOCKED )    /* our NightSw event is still to come  */
+    {
+      early = true;
+      earlyTick = tick;
+      msEarly = halMillis();
+    }
+    return;
+  }
+  uint16_t now = engineTicks();
+
+  err = tick - (uint16_t)( now + offset );
+  if( st != SYNCST_LOCKED || err > (int16_t) SYNC_STEPMS
+      || err < -(int16_t) SYNC_STEPMS )
+  {
+    if( st == SYNCST_LOCKED )
+    {
+      uint16_t size = ( err < 0 ? -err : err );
+      logPut( LOG_SYNCSTEP, size >> 8, size & 0xFF );
+    }
+    offset += err;
+    err = 0;
+    st = SYNCST_LOCKED;
+  }
+  else
+  {
+    uint16_t p = now - rxTicks;       /* ticks since the last frame          */
+    int32_t  e = ( (int32_t) err << 24 ) / ( p == 0 ? 1 : p );
+
+    trim += e / SYNC_KI;
+    trim = ( trim > SYNC_MAXRATE ? SYNC_MAXRATE
+             : trim < -SYNC_MAXRATE ? -SYNC_MAXRATE : trim );
+    setRate( trim + e / SYNC_KP );
+  }
+  rxTicks = now;
+  msRx = halMillis();
+}
+
+
+/*------------------------------------------ syncPhase() -------------------
+ *
+ * NightSw changed. The master starts SYNC_LEADMS ahead and sends that tick.
+ *  A locked node waits for it, or takes it if it came first, within
+ *  SYNC_WAITMS. Else the phase starts now.
+*/
+
+void syncPhase()
+{
+  if( st == SYNCST_MASTER )
+  {
+    uint16_t at = engineTicks() + SYNC_LEADMS;
+
+    startNewPhaseAt( at );
+    txTick = at;
+    txStart = true;
+  }
+  else if( st == SYNCST_LOCKED && early == true
+           && halMillis() - msEarly < SYNC_WAITMS )
+  {
+    early = false;
+    startAt( earlyTick );
+  }
+  else if( st == SYNCST_LOCKED )
+  {
+    early = false;
+    waiting = true;
+    msWait = halMillis();
+  }
+  else
+  {
+    startNewPhase();
+  }
+}
+
+
+/*------------------------------------------ syncRun() ---------------------
+ *
+ * each loop() pass. Master sync frame due, start frame wait over, lost.
+*/
+
+void syncRun()
+{
+  uint32_t ms = halMillis();
+
+  if( st == SYNCST_MASTER && ms - msTx >= SYNC_PERIODMS )
+  {
+    msTx = ms;
+    txSync = true;
+  }
+  if( waiting == true && ms - msWait >= SYNC_WAITMS )
+  {
+    waiting = false;
+    logPut( LOG_SYNCLATE, 0 );
+    startNewPhase();                  /* no start frame, go on our own       */
+  }
+  if( st == SYNCST_LOCKED && ms - msRx >= SYNC_LOSTN * (uint32_t) SYNC_PERIODMS )
+  {
+    st = SYNCST_NONE;                 /* free runs, trim kept                */
+    setRate( trim );
+    logPut( LOG_SYNCLOST );
+  }
+}
+
+
+/*------------------------------------------ syncTx() ----------------------
+ *
+ * frame for the master to send, start first. A sync frame takes the ticks
+ *  now, as near the send as can be.
+*/
+
+bool syncTx( bool & start, uint16_t & tick )
+{
+  if( txStart == true )
+  {
+    txStart = false;
+    start = true;
+    tick = txTick;
+    return true;
+  }
+  if( txSync == true )
+  {
+    txSync = false;
+    start = false;
+    tick = engineTicks();
+    return true;
+  }
+  return false;
+}
+
+
+SYNCST_t syncState()
+{
+  return st;
+}
+
+
+int16_t syncPPM()
+{
+  return trim * 1000L / ( SYNC_ONE / 1000 );  /* 1 / 2^24 is 0.06 ppm      */
+}
+
+
+int16_t syncErr()
+{
+  return err;
+}
+
+
+/*-------------------------------SYNC.cpp EoF ------------------------------*/
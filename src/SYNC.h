@@ -0,0 +1,76 @@
+/*file: SYNC.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Multi-node sync. A shared tick, so phases on all nodes start and run as one
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * One node is the sync master, Serial Monitor 'M', kept in EEPROM. It sends
+ *  ACON2 NN EN_SYNC, data its engine ticks, each SYNC_PERIODMS. The other
+ *  nodes teach that event with EV1 = EVAL_SYNC. The CBUS fast clock, FCLK,
+ *  is in minutes, too coarse for this.
+ *
+ * Tick. A node locks on the first sync frame, its net tick is its engine
+ *  ticks plus an offset. Each sync frame after that gives the error to the
+ *  master. A PI loop sets a slip rate, the ISR then runs the engine 2 ticks
+ *  in 1 ms, or none, now and then, see syncTicks(). So the engine runs at
+ *  the master's rate, crystal ppm trimmed out, and in phase to about the
+ *  frame jitter. An error over SYNC_STEPMS steps the offset, it is logged.
+ *  No frame for SYNC_LOSTN periods is lost, the trim is kept.
+ *
+ * Phase start. On a NightSw change the master picks a start tick
+ *  SYNC_LEADMS ahead, sends it as ACOF2 NN EN_SYNC, and starts its own phase
+ *  at that tick. A locked node waits for that frame, up to SYNC_WAITMS, and
+ *  starts at the same tick. A start frame that beats the node's own NightSw
+ *  event is kept for SYNC_WAITMS. So all start in the same ms, however the
+ *  NightSw event reached each one. The master must see the NightSw event
+ *  too, else the others start on their own after SYNC_WAITMS.
+ *
+ * EEPROM map, after the snapshot slots...
+ *  SYNC_MASTER if this node is the master, else not.
+*/
+#ifndef SYNC_H__  /* include guard */
+#define SYNC_H__
+
+#include "CHAN.h"
+
+
+const uint8_t  SYNC_MASTER   { 0x5C };     /* EEPROM byte, node is master    */
+const uint16_t SYNC_PERIODMS { 1000 };     /* ms between master sync frames  */
+const uint16_t SYNC_LEADMS   { 100 };      /* start tick ahead of NightSw    */
+const uint16_t SYNC_WAITMS   { 300 };      /* wait for a start frame, max    */
+const uint16_t SYNC_STEPMS   { 20 };       /* error over this is a step      */
+const uint8_t  SYNC_LOSTN    { 4 };        /* periods with no frame, lost    */
+const uint8_t  SYNC_KP       { 4 };        /* phase error / KP each period   */
+const uint8_t  SYNC_KI       { 64 };       /* rate trim + error / KI         */
+const int32_t  SYNC_ONE      { 1L << 24 }; /* 1 tick, slip rate units        */
+const int32_t  SYNC_MAXRATE  { SYNC_ONE / 64 };  /* 1.5 %, max slip rate     */
+
+
+enum SYNCST_t : uint8_t  /* sync state */
+{
+  SYNCST_NONE   = 0,      /* no sync frames, free runs                       */
+  SYNCST_LOCKED = 1,      /* trims to the master                             */
+  SYNCST_MASTER = 2       /* sends sync frames                               */
+};
+const uint8_t QTY_SYNCST { 3 };
+
+
+void     syncBegin( uint16_t eeStart );    /* EEPROM adr, master or not     */
+void     syncSetMaster( bool on );         /* stored in EEPROM              */
+uint8_t  syncTicks();                      /* ISR, engine ticks to run 0-2  */
+void     syncRx( bool start, uint16_t tick ); /* EVAL_SYNC frame, background */
+void     syncPhase();                      /* NightSw changed, not startNew */
+                                           /*  Phase() direct               */
+void     syncRun();                        /* timers, each loop() pass      */
+bool     syncTx( bool & start, uint16_t & tick ); /* frame to send, master  */
+SYNCST_t syncState();
+int16_t  syncPPM();                        /* rate trim, ppm faster         */
+int16_t  syncErr();                        /* last error to master, ticks   */
+
+
+#endif /* SYNC_H__
+ --------------------------------------- EoF ------------------------------
+*/
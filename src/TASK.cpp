@@ -0,0 +1,158 @@
+/*file: TASK.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Cooperative task scheduler for loop(). See TASK.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "TASK.h"
+
+
+struct task_t
+{
+  taskFn_t    fn;
+  uint32_t    dueUs;          /* halMicros() of next release, timed tasks    */
+  taskStat_t  st;
+};
+
+static task_t  task[TASK_MAX];         /* by priority, then order added      */
+static uint8_t qty { 0 };
+
+
+static uint16_t sat16( uint32_t v )
+{
+  return ( v > 0xFFFF ? 0xFFFF : v );
+}
+
+
+/*------------------------------------------ taskAdd() ---------------------
+ *
+ * insert by priority, after any of the same priority. Due at once.
+*/
+
+bool taskAdd( const char * name, taskFn_t fn, uint16_t periodMs,
+              uint16_t deadlineUs, uint8_t prio )
+{
+  if( qty >= TASK_MAX )
+  {
+    return false;
+  }
+  uint8_t i = qty++;
+
+  while( i > 0 && task[i - 1].st.prio > prio )
+  {
+    task[i] = task[i - 1];
+    i--;
+  }
+  task[i] = task_t { };
+  task[i].fn = fn;
+  task[i].dueUs = halMicros();
+  task[i].st.name = name;
+  task[i].st.periodMs = periodMs;
+  task[i].st.deadlineUs = deadlineUs;
+  task[i].st.prio = prio;
+  return true;
+}
+
+
+/*------------------------------------------ run() -------------------------
+ *
+ * run 1 task and account it against the time it was due
+*/
+
+static void run( task_t & t, uint32_t dueUs )
+{
+  taskStat_t & s = t.st;
+  uint32_t start = halMicros();
+
+  t.fn();
+
+  uint32_t end = halMicros();
+  uint32_t us = end - start;
+
+  if( s.sumUs > 0x7FFFFFFFUL - us )   /* keep the mean, lose old weight     */
+  {
+    s.sumUs >>= 1;
+    s.runs >>= 1;
+  }
+  s.sumUs += us;
+  s.runs++;
+  s.maxUs = ( us > s.maxUs ? sat16( us ) : s.maxUs );
+  s.lateUs = ( start - dueUs > s.lateUs ? sat16( start - dueUs ) : s.lateUs );
+  if( end - dueUs > s.deadlineUs && s.misses != 0xFFFF )
+  {
+    s.misses++;
+  }
+}
+
+
+/*------------------------------------------ taskRun() ---------------------
+ *
+ * 1 pass. All TASK_EVERY tasks, then the first due timed task. The table is
+ *  in priority order, so the first due is the one to run.
+*/
+
+void taskRun()
+{
+  uint32_t pass = halMicros();
+
+  for( uint8_t i = 0; i < qty; i++ )
+  {
+    if( task[i].st.periodMs == TASK_EVERY )
+    {
+      run( task[i], pass );
+    }
+  }
+
+  uint32_t now = halMicros();
+
+  for( uint8_t i = 0; i < qty; i++ )
+  {
+    task_t & t = task[i];
+
+    if( t.st.periodMs != TASK_EVERY && (int32_t)( now - t.dueUs ) >= 0 )
+    {
+      uint32_t periodUs = t.st.periodMs * 1000UL;
+
+      run( t, t.dueUs );
+      t.dueUs += periodUs;
+      if( (int32_t)( now - t.dueUs ) >= 0 )  /* a period late, drop them    */
+      {
+        t.dueUs = now + periodUs;
+      }
+      return;
+    }
+  }
+}
+
+
+uint8_t taskQty()
+{
+  return qty;
+}
+
+
+void taskGet( uint8_t t, taskStat_t & s )
+{
+  s = task[t].st;
+}
+
+
+void taskReset()
+{
+  for( uint8_t i = 0; i < qty; i++ )
+  {
+    taskStat_t & s = task[i].st;
+
+    s.runs = 0;
+    s.sumUs = 0;
+    s.maxUs = 0;
+    s.lateUs = 0;
+    s.misses = 0;
+  }
+}
+
+
+/*-------------------------------TASK.cpp EoF ------------------------------*/
@@ -0,0 +1,60 @@
+/*file: TASK.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Cooperative task scheduler for loop(), with run time & deadline accounting
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * setup() adds tasks, each with a period, a deadline and a priority, 0 is
+ *  first. loop() calls taskRun() for each pass...
+ *   - every TASK_EVERY task runs, in priority order. CBUS is one of these.
+ *   - then the due timed task of highest priority runs, only one. So a slow
+ *     housekeeping task only holds CBUS up by its own run.
+ * A timed task is due each period. If it runs a period or more late, the
+ *  missed releases are dropped, it does not run in a burst to catch up.
+ *
+ * Each task keeps runs, mean and worst run time, worst latency and deadline
+ *  misses. A miss is a run that ends more than deadlineUs after it was due.
+ *  A TASK_EVERY task is due at the start of the pass. Serial Monitor 'L'
+ *  prints and resets them.
+ * The clock is halMicros(), so a host build can check it, see host/TASKchk
+*/
+#ifndef TASK_H__  /* include guard */
+#define TASK_H__
+
+#include "HAL.h"
+
+
+const uint8_t  TASK_MAX   { 8 };      /* tasks in the table                  */
+const uint16_t TASK_EVERY { 0 };      /* periodMs, run each taskRun() pass   */
+
+typedef void ( * taskFn_t )();
+
+
+struct taskStat_t
+{
+  const char * name;
+  uint16_t  periodMs;     /* TASK_EVERY or ms between releases               */
+  uint16_t  deadlineUs;   /* due to end of run                               */
+  uint8_t   prio;         /* 0 runs first                                    */
+  uint32_t  runs;         /* runs & sumUs are halved together, mean is kept  */
+  uint32_t  sumUs;
+  uint16_t  maxUs;        /* worst run time, saturates at 0xFFFF             */
+  uint16_t  lateUs;       /* worst due to start, saturates                   */
+  uint16_t  misses;       /* runs over deadlineUs, saturates                 */
+};
+
+
+bool    taskAdd( const char * name, taskFn_t fn, uint16_t periodMs,
+                 uint16_t deadlineUs, uint8_t prio );  /* false if full     */
+void    taskRun();                          /* 1 pass, from loop()          */
+uint8_t taskQty();
+void    taskGet( uint8_t t, taskStat_t & s );  /* t in priority order       */
+void    taskReset();                        /* stats only, tasks stay       */
+
+
+#endif /* TASK_H__
+ --------------------------------------- EoF ------------------------------
+*/
@@ -0,0 +1,159 @@
+/*file: TELE.cpp
+ *----------------------------------------------------------------------------
+ *
+ * Binary telemetry. See TELE.h
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+*/
+#include "TELE.h"
+#include "CRC.h"
+
+
+static uint8_t   rate { 0 };          /* TELE_PERIODMS[] index, 0 is off     */
+static uint32_t  msDue;               /* halMillis() of the next record      */
+static teleRec_t sent;                /* last record sent, deltas are from   */
+static uint8_t   seq { 0 };
+static uint8_t   sinceKey { TELE_KEYN }; /* records since a key, a key first */
+
+
+void teleRate( uint8_t r )
+{
+  rate = ( r < QTY_TELERATE ? r : 0 );
+  msDue = halMillis();
+  sinceKey = TELE_KEYN;               /* a new stream starts with a key     */
+}
+
+
+uint8_t teleRateNow()
+{
+  return rate;
+}
+
+
+/*------------------------------------------ teleDue() ---------------------
+ *
+ * a record is due. Keeps to the rate, a late run does not make a burst.
+*/
+
+bool teleDue()
+{
+  uint32_t ms = halMillis();
+
+  if( rate == 0 || (int32_t) ( ms - msDue ) < 0 )
+  {
+    return false;
+  }
+  msDue += TELE_PERIODMS[rate];
+  if( (int32_t) ( ms - msDue ) >= 0 )
+  {
+    msDue = ms + TELE_PERIODMS[rate]; /* more than a period late            */
+  }
+  return true;
+}
+
+
+/*------------------------------------------ teleSample() ------------------
+ *
+ * live chans, background. Each field is a byte, read once, so no cli() is
+ *  needed. The ISR may step a chan between two chans, as 'v' may.
+*/
+
+void teleSample( teleRec_t & rec, uint16_t mA )
+{
+  rec.ms = halMillis();
+  rec.mA = mA;
+  for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+  {
+    rec.dc[ch] = var[ch].dcCur;
+    rec.sp[ch] = var[ch].state | var[ch].phase << 2;
+  }
+}
+
+
+static uint8_t packSp( const uint8_t * sp, const uint8_t * pick, uint8_t n,
+                       uint8_t * buf )           /* 2 a byte, low first      */
+{
+  for( uint8_t i = 0; i < n; i++ )
+  {
+    uint8_t v = ( pick ? sp[pick[i]] : sp[i] ) & 0x0F;
+
+    buf[i / 2] = ( i & 1 ? buf[i / 2] | v << 4 : v );
+  }
+  return ( n + 1 ) / 2;
+}
+
+
+/*------------------------------------------ teleEncode() ------------------
+ *
+ * rec as a frame in buf, TELE_MAX bytes. A delta from the last sent, or a
+ *  key. Returns the frame bytes. The caller must send it, rec is now sent.
+*/
+
+uint8_t teleEncode( const teleRec_t & rec, uint8_t * buf )
+{
+  int16_t  dmA = rec.mA - sent.mA;
+  uint32_t dms = rec.ms - sent.ms;
+  uint8_t  n { 4 };                   /* sync, len, type, seq                */
+
+  if( sinceKey >= TELE_KEYN || dms > 0xFFFF || dmA < -128 || dmA > 127 )
+  {
+    buf[2] = TELE_KEY;
+    for( uint8_t i = 0; i < 4; i++ )
+    {
+      buf[n++] = rec.ms >> ( 8 * i );
+    }
+    buf[n++] = rec.mA & 0xFF;
+    buf[n++] = rec.mA >> 8;
+    buf[n++] = QTY_CHAN;
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      buf[n++] = rec.dc[ch];
+    }
+    n += packSp( rec.sp, NULL, QTY_CHAN, &buf[n] );
+    sinceKey = 0;
+  }
+  else
+  {
+    uint8_t * dcMask = &buf[n + 3];
+    uint8_t * spMask = dcMask + TELE_MASK;
+    uint8_t   spPick[QTY_CHAN];
+    uint8_t   spQty { 0 };
+
+    buf[2] = TELE_DELTA;
+    buf[n++] = dms & 0xFF;
+    buf[n++] = dms >> 8;
+    buf[n++] = (int8_t) dmA;
+    n += 2 * TELE_MASK;
+    for( uint8_t i = 0; i < TELE_MASK; i++ )
+    {
+      dcMask[i] = 0;
+      spMask[i] = 0;
+    }
+    for( uint8_t ch = 0; ch < QTY_CHAN; ch++ )
+    {
+      if( rec.dc[ch] != sent.dc[ch] )
+      {
+        dcMask[ch / 8] |= 1U << ( ch % 8 );
+        buf[n++] = rec.dc[ch] - sent.dc[ch];      /* mod 256                 */
+      }
+      if( rec.sp[ch] != sent.sp[ch] )
+      {
+        spMask[ch / 8] |= 1U << ( ch % 8 );
+        spPick[spQty++] = ch;
+      }
+    }
+    n += packSp( rec.sp, spPick, spQty, &buf[n] );
+    sinceKey++;
+  }
+  buf[0] = TELE_SYNC;
+  buf[1] = n - 2;
+  buf[3] = seq++;
+  buf[n] = crc8( &buf[1], n - 1 );
+  sent = rec;
+  return n + 1;
+}
+
+
+/*-------------------------------TELE.cpp EoF ------------------------------*/
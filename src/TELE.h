@@ -0,0 +1,69 @@
+/*file: TELE.h      This is include file for CANlights.ino sketch
+ *----------------------------------------------------------------------------
+ *
+ * Binary telemetry. Live chan dc, state & phase and filtered mA, up to 100 Hz
+ *
+ *  CANlights control module for 10 channels
+ *
+ * Author: Dave Harris. Andover, UK. © Dave Harris 2021
+ *
+ * 'v' formats every field of every chan as text, far too slow to watch a
+ *  fade. Serial Monitor 'R' plus 1 - 9 streams records at TELE_PERIODMS[],
+ *  1 Hz to 100 Hz, R0 stops. host/TELEdec.cpp turns a capture into CSV.
+ *
+ * The Log task sends them, only when Serial has room for a whole frame, so
+ *  it never waits. var[] is read a byte a field, the ISR is not stopped. A
+ *  record not sent is not lost, the next is a delta from the last sent.
+ *
+ * Frame...  TELE_SYNC, len, type, seq, body[len - 2], crc8 of len to body
+ *  TELE_KEY   body = ms (4, little end), mA (2), QTY_CHAN, dc[QTY_CHAN],
+ *             sp[QTY_CHAN] packed 2 a byte, low nibble first
+ *  TELE_DELTA body = ms since last (2), mA change (signed 1), dc mask, sp
+ *             mask (TELE_MASK bytes each, bit per chan), then dc change (mod
+ *             256) of each dc bit set, then sp of each sp bit set, packed
+ *  sp = state | phase << 2. A key is sent first, each TELE_KEYN records and
+ *   when a change does not fit a delta. seq counts each record, a decoder
+ *   that sees a gap or a bad crc waits for the next key.
+ *  An idle delta is 12 bytes with 10 chans, 100 Hz is 10 % of 115200 baud.
+ *  Text log lines and binary log records can be in between, see LOG.h
+*/
+#ifndef TELE_H__  /* include guard */
+#define TELE_H__
+
+#include "CHAN.h"
+
+
+const uint8_t TELE_SYNC  { 0x5A };    /* frame start, LOG_SYNC is 0xA5       */
+const uint8_t TELE_KEY   { 'K' };     /* whole record                        */
+const uint8_t TELE_DELTA { 'D' };     /* changes from the last sent          */
+const uint8_t TELE_KEYN  { 50 };      /* a key at least each n records       */
+const uint8_t TELE_MASK  { ( QTY_CHAN + 7 ) / 8 };  /* bytes, bit per chan   */
+const uint8_t TELE_SPB   { ( QTY_CHAN + 1 ) / 2 };  /* packed sp bytes       */
+const uint8_t TELE_MAX   { 12 + 2 * TELE_MASK + QTY_CHAN + TELE_SPB };
+
+static_assert( TELE_MAX < 64, "a frame must fit the Serial tx buffer" );
+
+const uint8_t  QTY_TELERATE { 10 };
+const uint16_t TELE_PERIODMS[QTY_TELERATE]    /* 'R' 0 - 9, 0 is off        */
+  { 0, 1000, 500, 200, 100, 50, 40, 25, 20, 10 };
+
+
+struct teleRec_t
+{
+  uint32_t  ms;           /* halMillis() when sampled                        */
+  uint16_t  mA;           /* filtered Amp reading, see Power::getmA()        */
+  uint8_t   dc[QTY_CHAN]; /* var[].dcCur                                     */
+  uint8_t   sp[QTY_CHAN]; /* var[].state | var[].phase << 2                  */
+};
+
+
+void    teleRate( uint8_t r );         /* 0 off, 1 - 9 TELE_PERIODMS[r]     */
+uint8_t teleRateNow();
+bool    teleDue();                     /* a record is due, from the Log task */
+void    teleSample( teleRec_t & rec, uint16_t mA );    /* live chans         */
+uint8_t teleEncode( const teleRec_t & rec, uint8_t * buf ); /* frame, bytes */
+
+
+#endif /* TELE_H__
+ --------------------------------------- EoF ------------------------------
+*/